@@ -112,8 +112,15 @@ typedef struct raft_entry
     /** data length */
     unsigned int data_len;
 
-    /** data */
-    char data[];
+    /** data, allocated along with the entry by raft_entry_new(). Users may
+     * point it to external memory and release it using free_func. */
+    char *data;
+
+    /** set if data points into a buffer shared with other entries. The
+     * payload memory accounted to this entry is then shared_size rather
+     * than data_len, so the buffer is only charged once. */
+    unsigned char data_shared;
+    unsigned int shared_size;
 } raft_entry_t;
 
 /** Message sent from client to server.
@@ -1903,6 +1903,7 @@ void *raft_get_log(raft_server_t *me)
 raft_entry_t *raft_entry_new(unsigned int data_len)
 {
     raft_entry_t *ety = raft_calloc(1, sizeof(raft_entry_t) + data_len);
+    ety->data = (char *) (ety + 1);
     ety->data_len = data_len;
     ety->refs = 1;
 
@@ -50,7 +50,9 @@ if __name__ == '__main__':
                 for (i = 0; i < len; i++) {
                     int sz = sizeof(raft_entry_t) + src[i]->data_len;
                     t[i] = malloc(sz);
-                    memcpy(t[i], src[i], sz);
+                    memcpy(t[i], src[i], sizeof(raft_entry_t));
+                    t[i]->data = (char *)(t[i] + 1);
+                    memcpy(t[i]->data, src[i]->data, src[i]->data_len);
                 }
                 return t;
             }
@@ -15,6 +15,15 @@ static const CommandSpec clientCommands[] = {
     {NULL,      0},
 };
 
+/* Subcommand spec tables of commands with CMD_SPEC_SUBCOMMAND */
+static const struct {
+    const char *name;
+    const CommandSpec *subcommands;
+} subcommandTables[] = {
+    {"client", clientCommands},
+    {NULL,     NULL          },
+};
+
 static const CommandSpec commands[] = {
   /* Core Redis Commands */
     {"time",                        CMD_SPEC_DONT_INTERCEPT | CMD_SPEC_RANDOM    },
@@ -92,6 +101,9 @@ static const CommandSpec commands[] = {
     {"raft.shardgroup",             CMD_SPEC_DONT_INTERCEPT                      },
     {"raft.node",                   CMD_SPEC_DONT_INTERCEPT                      },
     {"raft.ae",                     CMD_SPEC_DONT_INTERCEPT                      },
+    {"raft.aebin",                  CMD_SPEC_DONT_INTERCEPT                      },
+    {"raft.aeack",                  CMD_SPEC_DONT_INTERCEPT                      },
+    {"raft.readindex",              CMD_SPEC_DONT_INTERCEPT                      },
     {"raft.requestvote",            CMD_SPEC_DONT_INTERCEPT                      },
     {"raft.snapshot",               CMD_SPEC_DONT_INTERCEPT                      },
     {"raft.debug",                  CMD_SPEC_DONT_INTERCEPT                      },
@@ -101,16 +113,18 @@ static const CommandSpec commands[] = {
     {"raft._sort_reply",            CMD_SPEC_DONT_INTERCEPT                      },
     {"raft._reject_random_command", CMD_SPEC_DONT_INTERCEPT                      },
     {"raft.import",                 CMD_SPEC_DONT_INTERCEPT                      },
+    {"raft.latency",                CMD_SPEC_DONT_INTERCEPT                      },
+    {"raft.nodestats",              CMD_SPEC_DONT_INTERCEPT                      },
     {"raft.scan",                   CMD_SPEC_READONLY                            },
     {"client",                      CMD_SPEC_SUBCOMMAND | CMD_SPEC_DONT_INTERCEPT},
     {NULL,                          0                                            }
 };
 
 /* Look up the specified command in the command spec table and return the
- * CommandSpec associated with it. If create is true, a new entry will
- * be created if one does not exist. Otherwise, NULL is returned.
+ * CommandSpec associated with it. A new entry will be created if one does not
+ * exist.
  */
-static CommandSpec *getOrCreateCommandSpec(CommandSpecTable *cmd_spec_table, const RedisModuleString *cmd, bool create)
+static CommandSpec *getOrCreateCommandSpec(CommandSpecTable *cmd_spec_table, const RedisModuleString *cmd)
 {
     size_t cmd_len;
     const char *cmd_str = RedisModule_StringPtrLen(cmd, &cmd_len);
@@ -127,10 +141,9 @@ static CommandSpec *getOrCreateCommandSpec(CommandSpecTable *cmd_spec_table, con
     lcmd[cmd_len] = '\0';
 
     CommandSpec *cs = CommandSpecTableGetC(cmd_spec_table, lcmd, cmd_len, NULL);
-    if (!cs && create) {
-        cs = RedisModule_Alloc(sizeof(CommandSpec));
+    if (!cs) {
+        cs = RedisModule_Calloc(1, sizeof(CommandSpec));
         cs->name = RedisModule_Strdup(lcmd);
-        cs->flags = 0;
 
         int ret = CommandSpecTableSetC(cmd_spec_table, lcmd, cmd_len, cs);
         RedisModule_Assert(ret == REDISMODULE_OK);
@@ -143,6 +156,196 @@ static CommandSpec *getOrCreateCommandSpec(CommandSpecTable *cmd_spec_table, con
     return cs;
 }
 
+/* Lookups are done through a perfect hash of the table, built with the
+ * "hash and displace" method: a key is hashed to a bucket, and the seed of
+ * the bucket is used to hash it again to a slot. Seeds are chosen when the
+ * table is built, so that no two keys share a slot. A lookup is a single
+ * probe and a case-insensitive compare, so command names are not copied and
+ * lowercased.
+ */
+#define CMD_SPEC_MAX_SEED 4096
+
+/* Case-insensitive FNV-1a. Non-letters may be mapped to other characters,
+ * which is fine as keys are compared after the lookup. */
+static uint32_t hashCommandName(const char *name, size_t len, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) name[i] | 0x20;
+        h *= 16777619u;
+    }
+
+    /* Mix high bits into the low bits used for the table index */
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 13;
+
+    return h;
+}
+
+static const CommandSpec *getSubcommandTable(const CommandSpec *cs)
+{
+    if (!(cs->flags & CMD_SPEC_SUBCOMMAND)) {
+        return NULL;
+    }
+
+    for (int i = 0; subcommandTables[i].name; i++) {
+        if (!strcmp(subcommandTables[i].name, cs->name)) {
+            return subcommandTables[i].subcommands;
+        }
+    }
+
+    return NULL;
+}
+
+static int compareBucketSize(const void *a, const void *b)
+{
+    const uint32_t *x = a, *y = b;
+    return (int) y[1] - (int) x[1];
+}
+
+/* Try to find a seed for each bucket. Returns false if a bucket cannot be
+ * placed, so a larger table should be used. */
+static bool placeBuckets(CommandSpecTable *t, CommandSpec **specs, uint32_t *bucket_of, size_t count)
+{
+    uint32_t num_buckets = t->buckets_mask + 1;
+    uint32_t (*order)[2] = RedisModule_Calloc(num_buckets, sizeof(*order));
+    uint32_t *slots = RedisModule_Alloc(sizeof(uint32_t) * (count + 1));
+    bool ret = true;
+
+    for (uint32_t b = 0; b < num_buckets; b++) {
+        order[b][0] = b;
+    }
+    for (size_t i = 0; i < count; i++) {
+        order[bucket_of[i]][1]++;
+    }
+
+    /* Place larger buckets first, while the table is still empty */
+    qsort(order, num_buckets, sizeof(*order), compareBucketSize);
+
+    for (uint32_t b = 0; b < num_buckets && order[b][1] > 0; b++) {
+        uint32_t bucket = order[b][0];
+        uint32_t seed;
+
+        for (seed = 1; seed < CMD_SPEC_MAX_SEED; seed++) {
+            size_t n = 0;
+            bool ok = true;
+
+            for (size_t i = 0; i < count && ok; i++) {
+                if (bucket_of[i] != bucket) {
+                    continue;
+                }
+
+                uint32_t slot = hashCommandName(specs[i]->name, strlen(specs[i]->name), seed) & t->slots_mask;
+                if (t->slots[slot]) {
+                    ok = false;
+                }
+                for (size_t j = 0; j < n && ok; j++) {
+                    if (slots[j] == slot) {
+                        ok = false;
+                    }
+                }
+                slots[n++] = slot;
+            }
+
+            if (ok) {
+                break;
+            }
+        }
+
+        if (seed == CMD_SPEC_MAX_SEED) {
+            ret = false;
+            break;
+        }
+
+        t->seeds[bucket] = seed;
+        for (size_t i = 0; i < count; i++) {
+            if (bucket_of[i] == bucket) {
+                uint32_t slot = hashCommandName(specs[i]->name, strlen(specs[i]->name), seed) & t->slots_mask;
+                t->slots[slot] = specs[i];
+                t->subcommands[slot] = getSubcommandTable(specs[i]);
+            }
+        }
+    }
+
+    RedisModule_Free(slots);
+    RedisModule_Free(order);
+    return ret;
+}
+
+/* Build the lookup index of the table for count specs, replacing the previous
+ * one. Spec names must be unique and lowercase.
+ */
+void CommandSpecTableBuildIndex(CommandSpecTable *t, CommandSpec **specs, size_t count)
+{
+    uint32_t *bucket_of = RedisModule_Calloc(count + 1, sizeof(*bucket_of));
+
+    /* About 4 keys per bucket, table at most half full */
+    uint32_t num_buckets = 1, num_slots = 2;
+    while (num_buckets * 4 < count) {
+        num_buckets *= 2;
+    }
+    while (num_slots < count * 2) {
+        num_slots *= 2;
+    }
+
+    while (true) {
+        RedisModule_Free(t->slots);
+        RedisModule_Free(t->subcommands);
+        RedisModule_Free(t->seeds);
+        t->slots = RedisModule_Calloc(num_slots, sizeof(*t->slots));
+        t->subcommands = RedisModule_Calloc(num_slots, sizeof(*t->subcommands));
+        t->seeds = RedisModule_Calloc(num_buckets, sizeof(*t->seeds));
+        t->slots_mask = num_slots - 1;
+        t->buckets_mask = num_buckets - 1;
+
+        for (size_t i = 0; i < count; i++) {
+            bucket_of[i] = hashCommandName(specs[i]->name, strlen(specs[i]->name), 0) & t->buckets_mask;
+        }
+
+        if (placeBuckets(t, specs, bucket_of, count)) {
+            break;
+        }
+        num_slots *= 2;
+    }
+
+    RedisModule_Free(bucket_of);
+}
+
+static void buildCommandSpecIndex(CommandSpecTable *t)
+{
+    size_t count = RedisModule_DictSize(t->table);
+    CommandSpec **specs = RedisModule_Calloc(count + 1, sizeof(*specs));
+
+    RedisModuleDictIter *it = RedisModule_DictIteratorStartC(t->table, "^", NULL, 0);
+    CommandSpec *cs;
+    size_t n = 0;
+    while (RedisModule_DictNextC(it, NULL, (void **) &cs) != NULL) {
+        specs[n++] = cs;
+    }
+    RedisModule_DictIteratorStop(it);
+
+    CommandSpecTableBuildIndex(t, specs, count);
+    RedisModule_Free(specs);
+}
+
+/* Returns the CommandSpec of the command, and its subcommand specs if any. */
+static const CommandSpec *lookupCommandSpec(CommandSpecTable *t, const char *name, size_t len,
+                                            const CommandSpec **subcommands)
+{
+    uint32_t seed = t->seeds[hashCommandName(name, len, 0) & t->buckets_mask];
+    uint32_t slot = hashCommandName(name, len, seed) & t->slots_mask;
+    const CommandSpec *cs = t->slots[slot];
+
+    if (!cs || strlen(cs->name) != len || strncasecmp(cs->name, name, len) != 0) {
+        return NULL;
+    }
+
+    *subcommands = t->subcommands[slot];
+    return cs;
+}
+
 /* Use COMMAND to fetch all Redis commands and update the CommandSpec. */
 static void populateCommandSpecFromRedis(RedisModuleCtx *ctx, CommandSpecTable *cmd_spec_table)
 {
@@ -217,7 +420,7 @@ static void populateCommandSpecFromRedis(RedisModuleCtx *ctx, CommandSpecTable *
         RedisModule_Assert(RedisModule_CallReplyType(name) == REDISMODULE_REPLY_STRING);
 
         RedisModuleString *name_str = RedisModule_CreateStringFromCallReply(name);
-        CommandSpec *cs = getOrCreateCommandSpec(cmd_spec_table, name_str, true);
+        CommandSpec *cs = getOrCreateCommandSpec(cmd_spec_table, name_str);
         RedisModule_Assert(cs != NULL);
         RedisModule_FreeString(NULL, name_str);
 
@@ -252,7 +455,7 @@ static void updateIgnoredCommands(CommandSpecTable *cmd_spec_table, const char *
     RedisModule_Free(tmp);
 }
 
-static void buildCommandSpecTable(RedisModuleCtx *ctx, CommandSpecTable *cmd_spec_table, const CommandSpec *command_list, const char *ignored_commands, bool from_redis)
+static void buildCommandSpecTable(RedisModuleCtx *ctx, CommandSpecTable *cmd_spec_table, const CommandSpec *command_list, const char *ignored_commands)
 {
     RedisModule_Assert(CommandSpecTableSize(cmd_spec_table) == 0);
 
@@ -272,9 +475,9 @@ static void buildCommandSpecTable(RedisModuleCtx *ctx, CommandSpecTable *cmd_spe
     if (ignored_commands) {
         updateIgnoredCommands(cmd_spec_table, ignored_commands);
     }
-    if (from_redis) {
-        populateCommandSpecFromRedis(ctx, cmd_spec_table);
-    }
+    populateCommandSpecFromRedis(ctx, cmd_spec_table);
+
+    buildCommandSpecIndex(cmd_spec_table);
 }
 
 static void initCommandSpecTableInternals(CommandSpecTable *cmd_spec_table)
@@ -291,58 +494,40 @@ void CommandSpecTableRebuild(RedisModuleCtx *ctx, CommandSpecTable *cmd_spec_tab
     RedisModule_Assert(cmd_spec_table->table);
 
     initCommandSpecTableInternals(cmd_spec_table);
-    buildCommandSpecTable(ctx, cmd_spec_table, commands, ignored_commands, true);
+    buildCommandSpecTable(ctx, cmd_spec_table, commands, ignored_commands);
 }
 
 /* Init the command spec table to contain raft and redis commands spec */
 void CommandSpecTableInit(RedisModuleCtx *ctx, CommandSpecTable **cmd_spec_table)
 {
-    *cmd_spec_table = RedisModule_Calloc(1, sizeof(cmd_spec_table));
+    *cmd_spec_table = RedisModule_Calloc(1, sizeof(**cmd_spec_table));
     initCommandSpecTableInternals(*cmd_spec_table);
-    buildCommandSpecTable(ctx, *cmd_spec_table, commands, NULL, true);
-}
-
-void SubCommandsSpecTableInit(RedisModuleCtx *ctx, RedisModuleDict **subcommandspec_dict)
-{
-    *subcommandspec_dict = RedisModule_CreateDict(ctx);
-
-    /* can duplicate for other command containers, for now just the client command container */
-    CommandSpecTable *clientSubCommandTable = RedisModule_Calloc(1, sizeof(CommandSpecTable));
-
-    initCommandSpecTableInternals(clientSubCommandTable);
-    buildCommandSpecTable(ctx, clientSubCommandTable, clientCommands, NULL, false);
-    RedisModule_DictSetC(*subcommandspec_dict, "client", strlen("client"), clientSubCommandTable);
-}
-
-void FreeSubCommandSpecTables(RedisRaftCtx *rr, RedisModuleDict *tables)
-{
-    CommandSpecTable *subCommand;
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(tables, "^", NULL, 0);
-    while (RedisModule_DictNextC(iter, NULL, (void **) &subCommand) != NULL) {
-        CommandSpecTableClear(subCommand);
-        RedisModule_Free(subCommand);
-    }
-    RedisModule_DictIteratorStop(iter);
-    RedisModule_FreeDict(rr->ctx, tables);
+    buildCommandSpecTable(ctx, *cmd_spec_table, commands, NULL);
 }
 
 /* Clear the command spec table */
 void CommandSpecTableClear(CommandSpecTable *cmd_spec_table)
 {
-    if (!cmd_spec_table->table) {
-        return;
-    }
+    if (cmd_spec_table->table) {
+        RedisModuleDictIter *it = RedisModule_DictIteratorStartC(cmd_spec_table->table, "^", NULL, 0);
+        CommandSpec *cs;
+        while (RedisModule_DictNextC(it, NULL, (void **) &cs) != NULL) {
+            RedisModule_Free(cs->name);
+            RedisModule_Free(cs);
+        }
+        RedisModule_DictIteratorStop(it);
 
-    RedisModuleDictIter *it = RedisModule_DictIteratorStartC(cmd_spec_table->table, "^", NULL, 0);
-    CommandSpec *cs;
-    while (RedisModule_DictNextC(it, NULL, (void **) &cs) != NULL) {
-        RedisModule_Free(cs->name);
-        RedisModule_Free(cs);
+        RedisModule_FreeDict(NULL, cmd_spec_table->table);
+        cmd_spec_table->table = NULL;
     }
-    RedisModule_DictIteratorStop(it);
 
-    RedisModule_FreeDict(NULL, cmd_spec_table->table);
-    cmd_spec_table->table = NULL;
+    RedisModule_Free(cmd_spec_table->slots);
+    RedisModule_Free(cmd_spec_table->subcommands);
+    RedisModule_Free(cmd_spec_table->seeds);
+    cmd_spec_table->slots = NULL;
+    cmd_spec_table->subcommands = NULL;
+    cmd_spec_table->seeds = NULL;
+    cmd_spec_table->slots_mask = cmd_spec_table->buckets_mask = 0;
 }
 
 /* Return the command spec table size */
@@ -372,12 +557,15 @@ RRStatus CommandSpecTableSetC(CommandSpecTable *cmd_spec_table, void *key, size_
     return ret == REDISMODULE_OK ? RR_OK : RR_ERROR;
 }
 
-/* Look up the specified command in the command spec table and return the
- * CommandSpec associated with it, or NULL.
+/* Look up the specified command (and optionally, a subcommand) in the command
+ * spec table and return its flags, or -1 if the command is not in the table.
  */
-int CommandSpecTableGetFlags(CommandSpecTable *cmd_spec_table, RedisModuleDict *sub_command_tables, const RedisModuleString *cmd, const RedisModuleString *subcmd)
+int CommandSpecTableGetFlags(CommandSpecTable *cmd_spec_table, const RedisModuleString *cmd, const RedisModuleString *subcmd)
 {
-    CommandSpec *cs = getOrCreateCommandSpec(cmd_spec_table, cmd, false);
+    size_t cmd_len;
+    const char *cmd_str = RedisModule_StringPtrLen(cmd, &cmd_len);
+    const CommandSpec *subcommands;
+    const CommandSpec *cs = lookupCommandSpec(cmd_spec_table, cmd_str, cmd_len, &subcommands);
 
     if (!cs) {
         return -1;
@@ -392,24 +580,29 @@ int CommandSpecTableGetFlags(CommandSpecTable *cmd_spec_table, RedisModuleDict *
     /* flags are now for subcommand, so mask it out of flags */
     flags &= ~CMD_SPEC_SUBCOMMAND; /* flags is now the default set of flags for all subcommands */
 
-    CommandSpecTable *sub_cmd_spec_table = RedisModule_DictGetC(sub_command_tables, cs->name, strlen(cs->name), NULL);
-    if (sub_cmd_spec_table == NULL) {
+    if (!subcommands) {
         return flags; /* no table, return default set of flags for subcommand */
     }
 
-    CommandSpec *sub_cs = getOrCreateCommandSpec(sub_cmd_spec_table, subcmd, false);
-    if (sub_cs == NULL) {
-        return flags; /* command not specified in table, return default set of flags */
+    /* Subcommand tables are short, a linear scan is enough */
+    size_t subcmd_len;
+    const char *subcmd_str = RedisModule_StringPtrLen(subcmd, &subcmd_len);
+
+    for (const CommandSpec *sub_cs = subcommands; sub_cs->name; sub_cs++) {
+        if (strlen(sub_cs->name) == subcmd_len &&
+            !strncasecmp(sub_cs->name, subcmd_str, subcmd_len)) {
+            return sub_cs->flags; /* command is in table, return its flags */
+        }
     }
 
-    return sub_cs->flags; /* command is in table, return its flags */
+    return flags; /* command not specified in table, return default set of flags */
 }
 
 /* For a given RaftRedisCommandArray, return a flags value that represents
  * the aggregate flags of all commands. If a command is not listed in the
  * command spec table, use default_flags.
  */
-unsigned int CommandSpecTableGetAggregateFlags(CommandSpecTable *cmd_spec_table, RedisModuleDict *sub_command_tables, RaftRedisCommandArray *array, unsigned int default_flags)
+unsigned int CommandSpecTableGetAggregateFlags(CommandSpecTable *cmd_spec_table, RaftRedisCommandArray *array, unsigned int default_flags)
 {
     unsigned int flags = 0;
     for (int i = 0; i < array->len; i++) {
@@ -418,7 +611,7 @@ unsigned int CommandSpecTableGetAggregateFlags(CommandSpecTable *cmd_spec_table,
         if (array->commands[i]->argc > 1) {
             subcmd = array->commands[i]->argv[1];
         }
-        int flag = CommandSpecTableGetFlags(cmd_spec_table, sub_command_tables, cmd, subcmd);
+        int flag = CommandSpecTableGetFlags(cmd_spec_table, cmd, subcmd);
         if (flag != -1) {
             flags |= flag;
         } else {
@@ -428,3 +621,127 @@ unsigned int CommandSpecTableGetAggregateFlags(CommandSpecTable *cmd_spec_table,
 
     return flags;
 }
+
+/* Commands are checked (e.g. ACL, OOM) before they are appended to the log.
+ * A dry run RedisModule_Call() costs about as much as executing a small
+ * command, so CommandCheckCached() tries to decide without it, using:
+ *
+ * - The arity of each command, fetched once with COMMAND INFO.
+ * - RedisModule_ACLCheckCommandPermissions() for the current user. The user
+ *   is looked up on each call, as ACL users may be changed or deleted without
+ *   the command filter seeing it (e.g. ACL LOAD or module ACL changes).
+ * - The used memory ratio, which is cheap to get. Close to the limit, the
+ *   dry run decides if the command is rejected.
+ */
+
+/* Used memory ratio from which the dry run is used to check for OOM */
+#define CMD_CHECK_OOM_RATIO 0.9
+
+/* Longest command name to look up in the arity cache */
+#define CMD_CHECK_MAX_NAME_LEN 64
+
+/* Returns the arity of the command, or 0 if it is unknown or has subcommands
+ * (which have their own arity). Only commands that exist are cached, keyed by
+ * their lowercase name, so clients can't grow the cache with arbitrary names.
+ */
+static long long getCommandArity(RedisRaftCtx *rr, RedisModuleString *cmd)
+{
+    char name[CMD_CHECK_MAX_NAME_LEN];
+    size_t len;
+    const char *str = RedisModule_StringPtrLen(cmd, &len);
+
+    if (len == 0 || len > sizeof(name)) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        name[i] = (char) tolower((unsigned char) str[i]);
+    }
+
+    int nokey;
+    void *val = RedisModule_DictGetC(rr->cmd_check_arity, name, len, &nokey);
+
+    if (!nokey) {
+        return (long long) (intptr_t) val;
+    }
+
+    long long arity = 0;
+
+    enterRedisModuleCall();
+    RedisModuleCallReply *reply = RedisModule_Call(rr->ctx, "COMMAND", "cb", "INFO", name, len);
+    exitRedisModuleCall();
+
+    RedisModuleCallReply *info = NULL;
+    if (reply && RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_ARRAY &&
+        RedisModule_CallReplyLength(reply) == 1) {
+        info = RedisModule_CallReplyArrayElement(reply, 0);
+    }
+
+    /* Element #2 is arity, element #10 is subcommands */
+    if (info && RedisModule_CallReplyType(info) == REDISMODULE_REPLY_ARRAY &&
+        RedisModule_CallReplyLength(info) >= 10) {
+        RedisModuleCallReply *subcommands = RedisModule_CallReplyArrayElement(info, 9);
+
+        if (RedisModule_CallReplyLength(subcommands) == 0) {
+            arity = RedisModule_CallReplyInteger(RedisModule_CallReplyArrayElement(info, 1));
+        }
+
+        RedisModule_DictSetC(rr->cmd_check_arity, name, len, (void *) (intptr_t) arity);
+    }
+
+    if (reply) {
+        RedisModule_FreeCallReply(reply);
+    }
+
+    return arity;
+}
+
+/* Check if the command can be executed by the client, without a dry run.
+ * Returns true if it can, or false if the dry run should decide.
+ */
+bool CommandCheckCached(RedisRaftCtx *rr, RedisModuleCtx *ctx, RaftRedisCommand *cmd, bool check_oom)
+{
+    if (check_oom && RedisModule_GetUsedMemoryRatio() >= CMD_CHECK_OOM_RATIO) {
+        return false;
+    }
+
+    long long arity = getCommandArity(rr, cmd->argv[0]);
+    if (arity == 0 ||
+        (arity > 0 && cmd->argc != arity) ||
+        (arity < 0 && cmd->argc < -arity)) {
+        return false;
+    }
+
+    RedisModuleString *name = RedisModule_GetCurrentUserName(ctx);
+    if (!name) {
+        return false;
+    }
+
+    RedisModuleUser *user = RedisModule_GetModuleUserFromUserName(name);
+    RedisModule_FreeString(NULL, name);
+    if (!user) {
+        return false;
+    }
+
+    bool ok = RedisModule_ACLCheckCommandPermissions(user, cmd->argv, cmd->argc) == REDISMODULE_OK;
+    RedisModule_FreeModuleUser(user);
+
+    return ok;
+}
+
+/* Drop cached command arities, e.g. when modules are loaded or unloaded */
+void CommandCheckCacheReset(RedisRaftCtx *rr)
+{
+    if (rr->cmd_check_arity) {
+        RedisModule_FreeDict(NULL, rr->cmd_check_arity);
+    }
+    rr->cmd_check_arity = RedisModule_CreateDict(NULL);
+}
+
+void CommandCheckCacheFree(RedisRaftCtx *rr)
+{
+    if (rr->cmd_check_arity) {
+        RedisModule_FreeDict(NULL, rr->cmd_check_arity);
+        rr->cmd_check_arity = NULL;
+    }
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright Redis Ltd. 2020 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+#include "redisraft.h"
+
+#include <string.h>
+
+/* A small LZ77 compressor, using the LZF format:
+ *
+ * 000LLLLL <L+1 literal bytes>               Literal run of 1 to 32 bytes
+ * LLLOOOOO OOOOOOOO                          Back reference of L+2 bytes
+ * 111OOOOO LLLLLLLL OOOOOOOO                 Back reference of L+9 bytes
+ *
+ * The offset O is the distance to the referenced data minus one, so back
+ * references can reach 8192 bytes back and copy up to 264 bytes.
+ *
+ * It is fast rather than tight, which suits log entries: these are written and
+ * replicated on the main thread, while text payloads (e.g. JSON) compress well
+ * with repeated keys and values alone.
+ */
+
+#define COMPRESS_HASH_BITS 13
+#define COMPRESS_MAX_LIT   32
+#define COMPRESS_MAX_OFF   (1 << 13)
+#define COMPRESS_MAX_REF   ((1 << 8) + (1 << 3))
+
+static inline uint32_t hash3(const uint8_t *p)
+{
+    uint32_t v = ((uint32_t) p[0] << 16) | ((uint32_t) p[1] << 8) | p[2];
+    return (v * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
+
+/* Append literals to out at *pos. Returns false if there is no room. */
+static bool emitLiterals(const uint8_t *lit, size_t count, uint8_t *out, size_t *pos, size_t out_len)
+{
+    while (count > 0) {
+        size_t n = count < COMPRESS_MAX_LIT ? count : COMPRESS_MAX_LIT;
+
+        if (*pos + 1 + n > out_len) {
+            return false;
+        }
+
+        out[(*pos)++] = (uint8_t) (n - 1);
+        memcpy(out + *pos, lit, n);
+        *pos += n;
+        lit += n;
+        count -= n;
+    }
+
+    return true;
+}
+
+/* Compress in_len bytes into out. Returns the compressed size, or 0 if it
+ * does not fit into out_len bytes.
+ */
+size_t CompressData(const void *in_data, size_t in_len, void *out_data, size_t out_len)
+{
+    const uint8_t *in = in_data;
+    uint8_t *out = out_data;
+    uint32_t htab[1 << COMPRESS_HASH_BITS] = {0}; /* Positions + 1, 0 for none */
+    size_t i = 0, lit = 0, pos = 0;
+
+    if (in_len == 0 || in_len >= UINT32_MAX) {
+        return 0;
+    }
+
+    while (i + 2 < in_len) {
+        uint32_t h = hash3(in + i);
+        size_t ref = htab[h];
+        htab[h] = (uint32_t) (i + 1);
+
+        if (!ref || i - (ref - 1) > COMPRESS_MAX_OFF ||
+            memcmp(in + ref - 1, in + i, 3) != 0) {
+            i++;
+            continue;
+        }
+        ref--;
+
+        size_t max = in_len - i < COMPRESS_MAX_REF ? in_len - i : COMPRESS_MAX_REF;
+        size_t len = 3;
+        while (len < max && in[ref + len] == in[i + len]) {
+            len++;
+        }
+
+        if (!emitLiterals(in + lit, i - lit, out, &pos, out_len)) {
+            return 0;
+        }
+
+        size_t off = i - ref - 1;
+        size_t l = len - 2;
+        if (pos + 3 > out_len) {
+            return 0;
+        }
+        if (l < 7) {
+            out[pos++] = (uint8_t) ((l << 5) | (off >> 8));
+        } else {
+            out[pos++] = (uint8_t) ((7 << 5) | (off >> 8));
+            out[pos++] = (uint8_t) (l - 7);
+        }
+        out[pos++] = (uint8_t) (off & 0xff);
+
+        /* Index the positions covered by the reference */
+        for (size_t j = i + 1; j < i + len && j + 2 < in_len; j++) {
+            htab[hash3(in + j)] = (uint32_t) (j + 1);
+        }
+
+        i += len;
+        lit = i;
+    }
+
+    if (!emitLiterals(in + lit, in_len - lit, out, &pos, out_len)) {
+        return 0;
+    }
+
+    return pos;
+}
+
+/* Returns the largest size in_len bytes created by CompressData() may
+ * decompress into. A three byte back reference expands the most.
+ */
+size_t DecompressMaxSize(size_t in_len)
+{
+    return in_len * ((COMPRESS_MAX_REF + 2) / 3);
+}
+
+/* Decompress in_len bytes created by CompressData() into out. Returns the
+ * decompressed size, or 0 if the input is corrupt or does not fit into out.
+ */
+size_t DecompressData(const void *in_data, size_t in_len, void *out_data, size_t out_len)
+{
+    const uint8_t *in = in_data, *in_end = in + in_len;
+    uint8_t *out = out_data, *op = out, *out_end = out + out_len;
+
+    while (in < in_end) {
+        size_t ctrl = *in++;
+
+        if (ctrl < COMPRESS_MAX_LIT) {
+            size_t n = ctrl + 1;
+
+            if ((size_t) (in_end - in) < n || (size_t) (out_end - op) < n) {
+                return 0;
+            }
+            memcpy(op, in, n);
+            op += n;
+            in += n;
+            continue;
+        }
+
+        size_t len = ctrl >> 5;
+        if (len == 7) {
+            if (in == in_end) {
+                return 0;
+            }
+            len += *in++;
+        }
+        len += 2;
+
+        if (in == in_end) {
+            return 0;
+        }
+        size_t off = ((ctrl & 0x1f) << 8) + *in++ + 1;
+
+        if ((size_t) (op - out) < off || (size_t) (out_end - op) < len) {
+            return 0;
+        }
+
+        /* Source and destination may overlap, copy byte by byte */
+        const uint8_t *ref = op - off;
+        for (size_t i = 0; i < len; i++) {
+            op[i] = ref[i];
+        }
+        op += len;
+    }
+
+    return op - out;
+}
@@ -73,10 +73,21 @@ static const char *conf_proxy_response_timeout = "proxy-response-timeout";
 static const char *conf_reconnect_interval = "reconnect-interval";
 static const char *conf_log_filename = "log-filename";
 static const char *conf_log_max_cache_size = "log-max-cache-size";
+static const char *conf_log_max_cache_pinned_size = "log-max-cache-pinned-size";
 static const char *conf_log_max_file_size = "log-max-file-size";
+static const char *conf_log_max_file_size_percentage = "log-max-file-size-percentage";
+static const char *conf_log_segment_size = "log-segment-size";
 static const char *conf_log_fsync = "log-fsync";
+static const char *conf_log_fsync_delay = "log-fsync-delay";
+static const char *conf_log_fsync_pending_bytes = "log-fsync-pending-bytes";
+static const char *conf_log_fsync_follower_async = "log-fsync-follower-async";
+static const char *conf_write_batch_max_requests = "write-batch-max-requests";
+static const char *conf_log_compression_threshold = "log-compression-threshold";
 static const char *conf_follower_proxy = "follower-proxy";
 static const char *conf_quorum_reads = "quorum-reads";
+static const char *conf_lease_reads = "lease-reads";
+static const char *conf_follower_reads = "follower-reads";
+static const char *conf_lease_clock_drift = "lease-clock-drift";
 static const char *conf_loglevel = "loglevel";
 static const char *conf_trace = "trace";
 static const char *conf_sharding = "sharding";
@@ -464,10 +475,16 @@ static int getBool(const char *name, void *privdata)
 
     if (strcasecmp(name, conf_log_fsync) == 0) {
         return c->log_fsync;
+    } else if (strcasecmp(name, conf_log_fsync_follower_async) == 0) {
+        return c->log_fsync_follower_async;
     } else if (strcasecmp(name, conf_follower_proxy) == 0) {
         return c->follower_proxy;
     } else if (strcasecmp(name, conf_quorum_reads) == 0) {
         return c->quorum_reads;
+    } else if (strcasecmp(name, conf_lease_reads) == 0) {
+        return c->lease_reads;
+    } else if (strcasecmp(name, conf_follower_reads) == 0) {
+        return c->follower_reads;
     } else if (strcasecmp(name, conf_sharding) == 0) {
         return c->sharding;
     } else if (strcasecmp(name, conf_external_sharding) == 0) {
@@ -528,10 +545,16 @@ static int setBool(const char *name, int val, void *pr, RedisModuleString **err)
 
     if (strcasecmp(name, conf_log_fsync) == 0) {
         c->log_fsync = val;
+    } else if (strcasecmp(name, conf_log_fsync_follower_async) == 0) {
+        c->log_fsync_follower_async = val;
     } else if (strcasecmp(name, conf_follower_proxy) == 0) {
         c->follower_proxy = val;
     } else if (strcasecmp(name, conf_quorum_reads) == 0) {
         c->quorum_reads = val;
+    } else if (strcasecmp(name, conf_lease_reads) == 0) {
+        c->lease_reads = val;
+    } else if (strcasecmp(name, conf_follower_reads) == 0) {
+        c->follower_reads = val;
     } else if (strcasecmp(name, conf_sharding) == 0) {
         c->sharding = val;
     } else if (strcasecmp(name, conf_external_sharding) == 0) {
@@ -576,6 +599,8 @@ static long long getNumeric(const char *name, void *privdata)
         return c->request_timeout;
     } else if (strcasecmp(name, conf_election_timeout) == 0) {
         return c->election_timeout;
+    } else if (strcasecmp(name, conf_lease_clock_drift) == 0) {
+        return c->lease_clock_drift;
     } else if (strcasecmp(name, conf_connection_timeout) == 0) {
         return c->connection_timeout;
     } else if (strcasecmp(name, conf_join_timeout) == 0) {
@@ -588,8 +613,22 @@ static long long getNumeric(const char *name, void *privdata)
         return c->reconnect_interval;
     } else if (strcasecmp(name, conf_log_max_file_size) == 0) {
         return (long long) c->log_max_file_size;
+    } else if (strcasecmp(name, conf_log_max_file_size_percentage) == 0) {
+        return c->log_max_file_size_percentage;
+    } else if (strcasecmp(name, conf_log_segment_size) == 0) {
+        return (long long) c->log_segment_size;
     } else if (strcasecmp(name, conf_log_max_cache_size) == 0) {
         return (long long) c->log_max_cache_size;
+    } else if (strcasecmp(name, conf_log_max_cache_pinned_size) == 0) {
+        return (long long) c->log_max_cache_pinned_size;
+    } else if (strcasecmp(name, conf_log_fsync_delay) == 0) {
+        return c->log_fsync_delay;
+    } else if (strcasecmp(name, conf_log_fsync_pending_bytes) == 0) {
+        return c->log_fsync_pending_bytes;
+    } else if (strcasecmp(name, conf_write_batch_max_requests) == 0) {
+        return c->write_batch_max_requests;
+    } else if (strcasecmp(name, conf_log_compression_threshold) == 0) {
+        return (long long) c->log_compression_threshold;
     } else if (strcasecmp(name, conf_shardgroup_update_interval) == 0) {
         return c->shardgroup_update_interval;
     } else if (strcasecmp(name, conf_append_req_max_count) == 0) {
@@ -652,6 +691,11 @@ static int setNumeric(const char *name, long long val, void *priv,
             }
         }
         c->election_timeout = timeout;
+
+        /* Leases were acquired based on the previous timeout */
+        rr->lease_epoch = RedisModule_MonotonicMicroseconds();
+    } else if (strcasecmp(name, conf_lease_clock_drift) == 0) {
+        c->lease_clock_drift = (int) val;
     } else if (strcasecmp(name, conf_connection_timeout) == 0) {
         c->connection_timeout = (int) val;
     } else if (strcasecmp(name, conf_join_timeout) == 0) {
@@ -664,8 +708,22 @@ static int setNumeric(const char *name, long long val, void *priv,
         c->reconnect_interval = (int) val;
     } else if (strcasecmp(name, conf_log_max_cache_size) == 0) {
         c->log_max_cache_size = val;
+    } else if (strcasecmp(name, conf_log_max_cache_pinned_size) == 0) {
+        c->log_max_cache_pinned_size = val;
     } else if (strcasecmp(name, conf_log_max_file_size) == 0) {
         c->log_max_file_size = val;
+    } else if (strcasecmp(name, conf_log_max_file_size_percentage) == 0) {
+        c->log_max_file_size_percentage = val;
+    } else if (strcasecmp(name, conf_log_segment_size) == 0) {
+        c->log_segment_size = val;
+    } else if (strcasecmp(name, conf_log_fsync_delay) == 0) {
+        c->log_fsync_delay = val;
+    } else if (strcasecmp(name, conf_log_fsync_pending_bytes) == 0) {
+        c->log_fsync_pending_bytes = val;
+    } else if (strcasecmp(name, conf_write_batch_max_requests) == 0) {
+        c->write_batch_max_requests = val;
+    } else if (strcasecmp(name, conf_log_compression_threshold) == 0) {
+        c->log_compression_threshold = val;
     } else if (strcasecmp(name, conf_shardgroup_update_interval) == 0) {
         c->shardgroup_update_interval = (int) val;
     } else if (strcasecmp(name, conf_append_req_max_count) == 0) {
@@ -785,6 +843,7 @@ RRStatus ConfigInit(RedisModuleCtx *ctx, RedisRaftConfig *c)
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_periodic_interval,          100,              REDISMODULE_CONFIG_DEFAULT,   1, INT_MAX,   getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_request_timeout,            200,              REDISMODULE_CONFIG_DEFAULT,   1, INT_MAX,   getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_election_timeout,           1000,             REDISMODULE_CONFIG_DEFAULT,   1, INT_MAX,   getNumeric, setNumeric, NULL, c);
+    ret |= RedisModule_RegisterNumericConfig(ctx, conf_lease_clock_drift,          10,               REDISMODULE_CONFIG_DEFAULT,   0, 99,        getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_connection_timeout,         3000,             REDISMODULE_CONFIG_DEFAULT,   1, INT_MAX,   getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_join_timeout,               120000,           REDISMODULE_CONFIG_DEFAULT,   1, INT_MAX,   getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_response_timeout,           1000,             REDISMODULE_CONFIG_DEFAULT,   1, INT_MAX,   getNumeric, setNumeric, NULL, c);
@@ -796,15 +855,25 @@ RRStatus ConfigInit(RedisModuleCtx *ctx, RedisRaftConfig *c)
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_snapshot_req_max_count,     32,               REDISMODULE_CONFIG_DEFAULT,   1, INT_MAX,   getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_snapshot_req_max_size,      65536,            REDISMODULE_CONFIG_MEMORY,    1, INT_MAX,   getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_log_max_cache_size,         64000000,         REDISMODULE_CONFIG_MEMORY,    0, LLONG_MAX, getNumeric, setNumeric, NULL, c);
+    ret |= RedisModule_RegisterNumericConfig(ctx, conf_log_max_cache_pinned_size,  256000000,        REDISMODULE_CONFIG_MEMORY,    0, LLONG_MAX, getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_log_max_file_size,          128000000,        REDISMODULE_CONFIG_MEMORY,    0, LLONG_MAX, getNumeric, setNumeric, NULL, c);
+    ret |= RedisModule_RegisterNumericConfig(ctx, conf_log_max_file_size_percentage, 0,              REDISMODULE_CONFIG_DEFAULT,   0, INT_MAX,   getNumeric, setNumeric, NULL, c);
+    ret |= RedisModule_RegisterNumericConfig(ctx, conf_log_segment_size,           16000000,         REDISMODULE_CONFIG_MEMORY,    0, LLONG_MAX, getNumeric, setNumeric, NULL, c);
+    ret |= RedisModule_RegisterNumericConfig(ctx, conf_log_fsync_delay,            0,                REDISMODULE_CONFIG_DEFAULT,   0, 1000000,   getNumeric, setNumeric, NULL, c);
+    ret |= RedisModule_RegisterNumericConfig(ctx, conf_log_fsync_pending_bytes,    1048576,          REDISMODULE_CONFIG_MEMORY,    1, LLONG_MAX, getNumeric, setNumeric, NULL, c);
+    ret |= RedisModule_RegisterNumericConfig(ctx, conf_write_batch_max_requests,   0,                REDISMODULE_CONFIG_DEFAULT,   0, INT_MAX,   getNumeric, setNumeric, NULL, c);
+    ret |= RedisModule_RegisterNumericConfig(ctx, conf_log_compression_threshold,  0,                REDISMODULE_CONFIG_MEMORY,    0, LLONG_MAX, getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_scan_size,                  1000,             REDISMODULE_CONFIG_DEFAULT,   1, LLONG_MAX, getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_log_delay_apply,            0,                REDISMODULE_CONFIG_HIDDEN,    0, LLONG_MAX, getNumeric, setNumeric, NULL, c);
     ret |= RedisModule_RegisterNumericConfig(ctx, conf_snapshot_delay,             0,                REDISMODULE_CONFIG_HIDDEN,    0, LLONG_MAX, getNumeric, setNumeric, NULL, c);
 
                                                   /* name */                   /* default-value */   /* flags */
     ret |= RedisModule_RegisterBoolConfig(ctx,    conf_log_fsync,                  true,             REDISMODULE_CONFIG_DEFAULT,                 getBool,    setBool,    NULL, c);
+    ret |= RedisModule_RegisterBoolConfig(ctx,    conf_log_fsync_follower_async,   true,             REDISMODULE_CONFIG_DEFAULT,                 getBool,    setBool,    NULL, c);
     ret |= RedisModule_RegisterBoolConfig(ctx,    conf_follower_proxy,             false,            REDISMODULE_CONFIG_DEFAULT,                 getBool,    setBool,    NULL, c);
     ret |= RedisModule_RegisterBoolConfig(ctx,    conf_quorum_reads,               true,             REDISMODULE_CONFIG_DEFAULT,                 getBool,    setBool,    NULL, c);
+    ret |= RedisModule_RegisterBoolConfig(ctx,    conf_lease_reads,                false,            REDISMODULE_CONFIG_DEFAULT,                 getBool,    setBool,    NULL, c);
+    ret |= RedisModule_RegisterBoolConfig(ctx,    conf_follower_reads,             false,            REDISMODULE_CONFIG_DEFAULT,                 getBool,    setBool,    NULL, c);
     ret |= RedisModule_RegisterBoolConfig(ctx,    conf_sharding,                   false,            REDISMODULE_CONFIG_DEFAULT,                 getBool,    setBool,    NULL, c);
     ret |= RedisModule_RegisterBoolConfig(ctx,    conf_external_sharding,          false,            REDISMODULE_CONFIG_DEFAULT,                 getBool,    setBool,    NULL, c);
     ret |= RedisModule_RegisterBoolConfig(ctx,    conf_tls_enabled,                false,            REDISMODULE_CONFIG_DEFAULT,                 getBool,    setBool,    NULL, c);
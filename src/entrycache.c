@@ -9,6 +9,15 @@
 #include "common/redismodule.h"
 
 #include <memory.h>
+#include <stdbool.h>
+
+/* Memory accounted to a cached entry. Entries sharing a payload buffer are
+ * charged their share of it instead of their own payload length.
+ */
+static size_t entryMemSize(raft_entry_t *ety)
+{
+    return sizeof(raft_entry_t) + (ety->data_shared ? ety->shared_size : ety->data_len);
+}
 
 EntryCache *EntryCacheNew(raft_index_t initial_size)
 {
@@ -55,23 +64,26 @@ void EntryCacheAppend(EntryCache *cache, raft_entry_t *ety, raft_index_t idx)
 
     cache->ptrs[(cache->start + cache->len) % cache->size] = ety;
     cache->len++;
-    cache->entries_memsize += sizeof(raft_entry_t) + ety->data_len;
+    cache->entries_memsize += entryMemSize(ety);
     raft_entry_hold(ety);
 }
 
 raft_entry_t *EntryCacheGet(EntryCache *cache, raft_index_t idx)
 {
     if (idx < cache->start_idx) {
+        cache->misses++;
         return NULL;
     }
 
     raft_index_t relidx = idx - cache->start_idx;
     if (relidx >= cache->len) {
+        cache->misses++;
         return NULL;
     }
 
     raft_entry_t *ety = cache->ptrs[(cache->start + relidx) % cache->size];
     raft_entry_hold(ety);
+    cache->hits++;
     return ety;
 }
 
@@ -85,7 +97,7 @@ long EntryCacheDeleteHead(EntryCache *cache, raft_index_t first_idx)
 
     while (first_idx > cache->start_idx && cache->len > 0) {
         raft_entry_t *ety = cache->ptrs[cache->start];
-        cache->entries_memsize -= sizeof(raft_entry_t) + ety->data_len;
+        cache->entries_memsize -= entryMemSize(ety);
         raft_entry_release(ety);
 
         cache->start_idx++;
@@ -128,7 +140,7 @@ long EntryCacheDeleteTail(EntryCache *cache, raft_index_t index)
         unsigned long int ofs = (cache->start + relidx) % cache->size;
         raft_entry_t *ety = cache->ptrs[ofs];
 
-        cache->entries_memsize -= sizeof(raft_entry_t) + ety->data_len;
+        cache->entries_memsize -= entryMemSize(ety);
         raft_entry_release(ety);
 
         cache->ptrs[ofs] = NULL;
@@ -144,13 +156,32 @@ long EntryCacheDeleteTail(EntryCache *cache, raft_index_t index)
     return deleted;
 }
 
-long EntryCacheCompact(EntryCache *cache, size_t max_memory)
+/* Evict entries from the head of the cache to bring its memory usage down.
+ *
+ * Entries from pin_idx onwards are still needed (e.g. by followers that have
+ * not acknowledged them yet), so they are kept as long as memory usage does
+ * not exceed max_pinned_memory. Entries before pin_idx are evicted once memory
+ * usage exceeds max_memory. A pin_idx of zero means no entry is pinned.
+ *
+ * Returns the number of entries evicted.
+ */
+long EntryCacheCompact(EntryCache *cache, size_t max_memory,
+                       raft_index_t pin_idx, size_t max_pinned_memory)
 {
     long deleted = 0;
 
     while (cache->len > 0 && cache->entries_memsize > max_memory) {
+        bool pinned = pin_idx && cache->start_idx >= pin_idx;
+
+        if (pinned) {
+            if (cache->entries_memsize <= max_pinned_memory) {
+                break;
+            }
+            cache->pinned_evictions++;
+        }
+
         raft_entry_t *ety = cache->ptrs[cache->start];
-        cache->entries_memsize -= sizeof(raft_entry_t) + ety->data_len;
+        cache->entries_memsize -= entryMemSize(ety);
         raft_entry_release(ety);
 
         cache->start_idx++;
@@ -17,6 +17,9 @@ typedef struct EntryCache {
     raft_index_t start_idx;            /* Log index of first entry */
     raft_index_t start;                /* ptrs array index of first entry */
     unsigned long int entries_memsize; /* Total memory used by entries */
+    unsigned long hits;                /* Lookups served from the cache */
+    unsigned long misses;              /* Lookups not found in the cache */
+    unsigned long pinned_evictions;    /* Entries evicted while still pinned */
     raft_entry_t **ptrs;
 } EntryCache;
 
@@ -26,6 +29,7 @@ void EntryCacheAppend(EntryCache *cache, raft_entry_t *ety, raft_index_t idx);
 raft_entry_t *EntryCacheGet(EntryCache *cache, raft_index_t idx);
 long EntryCacheDeleteHead(EntryCache *cache, raft_index_t idx);
 long EntryCacheDeleteTail(EntryCache *cache, raft_index_t index);
-long EntryCacheCompact(EntryCache *cache, size_t max_memory);
+long EntryCacheCompact(EntryCache *cache, size_t max_memory,
+                       raft_index_t pin_idx, size_t max_pinned_memory);
 
 #endif
@@ -24,6 +24,7 @@ void fsyncThreadAddTask(FsyncThread *th, int fd, raft_index_t requested_index)
     pthread_mutex_lock(&th->mtx);
 
     th->requested_index = requested_index;
+    th->requested_id++;
     th->fd = fd;
     th->need_fsync = true;
     th->running = true;
@@ -34,6 +35,19 @@ void fsyncThreadAddTask(FsyncThread *th, int fd, raft_index_t requested_index)
     pthread_mutex_unlock(&th->mtx);
 }
 
+/* Add a file to fsync() before the fd of the next task, e.g. a sealed log
+ * segment. The thread takes ownership of fd and closes it afterwards.
+ */
+void fsyncThreadAddFile(FsyncThread *th, int fd)
+{
+    pthread_mutex_lock(&th->mtx);
+
+    th->files = RedisModule_Realloc(th->files, (th->num_files + 1) * sizeof(int));
+    th->files[th->num_files++] = fd;
+
+    pthread_mutex_unlock(&th->mtx);
+}
+
 /* Waits fsync thread until it completes fsync() call */
 void fsyncThreadWaitUntilCompleted(FsyncThread *th)
 {
@@ -46,8 +60,9 @@ void fsyncThreadWaitUntilCompleted(FsyncThread *th)
 
 static void *fsyncLoop(void *arg)
 {
-    int rc, fd;
+    int rc, fd, *files, num_files;
     raft_index_t request_idx;
+    uint64_t request_id;
     FsyncThread *th = arg;
 
     while (1) {
@@ -58,12 +73,27 @@ static void *fsyncLoop(void *arg)
         }
 
         request_idx = th->requested_index;
+        request_id = th->requested_id;
         fd = th->fd;
+        files = th->files;
+        num_files = th->num_files;
+        th->files = NULL;
+        th->num_files = 0;
         th->need_fsync = false;
 
         pthread_mutex_unlock(&th->mtx);
 
         uint64_t begin = RedisModule_MonotonicMicroseconds();
+
+        for (int i = 0; i < num_files; i++) {
+            rc = fsyncFile(files[i]);
+            if (rc != RR_OK) {
+                PANIC("fsync(): %s \n", strerror(errno));
+            }
+            close(files[i]);
+        }
+        RedisModule_Free(files);
+
         rc = fsyncFile(fd);
         if (rc != RR_OK) {
             PANIC("fsync(): %s \n", strerror(errno));
@@ -82,6 +112,7 @@ static void *fsyncLoop(void *arg)
         FsyncThreadResult *rs = RedisModule_Alloc(sizeof(*rs));
         rs->time = time;
         rs->fsync_index = request_idx;
+        rs->request_id = request_id;
         /* Wake up Redis event loop */
         RedisModule_EventLoopAddOneShot(th->on_complete, rs);
     }
@@ -94,6 +125,7 @@ static void *fsyncLoop(void *arg)
  *
  * typedef struct FsyncThreadResult {
  *    raft_index_t fsync_index;  // index parameter passed in fsyncThreadAddTask()
+ *    uint64_t request_id; // Latest request covered, see FsyncThread.requested_id
  *    uint64_t time; // Time fsync() took in microseconds
  * } FsyncThreadResult;
  *
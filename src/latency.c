@@ -0,0 +1,182 @@
+/*
+ * Copyright Redis Ltd. 2020 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+#include "redisraft.h"
+
+#include <string.h>
+
+/* Latency histograms for the stages of a write.
+ *
+ * Values are recorded in microseconds into log-linear buckets: each power of
+ * two is split into 2^LATENCY_SUB_BITS buckets, so percentiles are accurate
+ * within 12.5% for any value, in a fixed amount of memory.
+ */
+
+static const char *stage_names[LATENCY_STAGE_COUNT] = {
+    [LATENCY_APPEND] = "append",
+    [LATENCY_FSYNC] = "fsync",
+    [LATENCY_REPLICATE] = "replicate",
+    [LATENCY_COMMIT] = "commit",
+    [LATENCY_APPLY] = "apply",
+    [LATENCY_TOTAL] = "total",
+};
+
+static int bucketIndex(uint64_t value)
+{
+    if (value < (1 << LATENCY_SUB_BITS)) {
+        return (int) value;
+    }
+
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - LATENCY_SUB_BITS;
+
+    return ((shift + 1) << LATENCY_SUB_BITS) +
+           (int) ((value >> shift) & ((1 << LATENCY_SUB_BITS) - 1));
+}
+
+/* Returns the largest value that is recorded into the bucket. */
+static uint64_t bucketMaxValue(int index)
+{
+    if (index < (1 << LATENCY_SUB_BITS)) {
+        return index;
+    }
+
+    int shift = (index >> LATENCY_SUB_BITS) - 1;
+    uint64_t sub = index & ((1 << LATENCY_SUB_BITS) - 1);
+    uint64_t min = ((1ull << LATENCY_SUB_BITS) + sub) << shift;
+
+    return min + ((1ull << shift) - 1);
+}
+
+void LatencyHistogramRecord(LatencyHistogram *h, uint64_t value)
+{
+    h->buckets[bucketIndex(value)]++;
+    h->count++;
+    h->sum += value;
+    h->max = MAX(h->max, value);
+}
+
+/* Returns the value below which `percentile` percent of the recorded values
+ * fall, or 0 if the histogram is empty. */
+uint64_t LatencyHistogramPercentile(LatencyHistogram *h, double percentile)
+{
+    uint64_t target = (uint64_t) ((double) h->count * percentile / 100.0);
+    uint64_t seen = 0;
+
+    if (target == 0) {
+        target = 1;
+    }
+
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= target) {
+            return MIN(bucketMaxValue(i), h->max);
+        }
+    }
+
+    return 0;
+}
+
+/* Records the time elapsed since `start`, which is a value returned by
+ * RedisModule_MonotonicMicroseconds(). */
+void LatencyRecord(LatencyStats *s, LatencyStage stage, uint64_t start)
+{
+    uint64_t now = RedisModule_MonotonicMicroseconds();
+    LatencyHistogramRecord(&s->stages[stage], now > start ? now - start : 0);
+}
+
+/* Returns the tracking slot of the entry, or NULL if it is not tracked. The
+ * entry id is compared as well, as the index may have been reused after a
+ * leader change. */
+static LatencyEntry *findEntry(LatencyStats *s, raft_index_t idx, raft_entry_id_t id)
+{
+    LatencyEntry *e = &s->entries[idx % LATENCY_TRACKED_ENTRIES];
+
+    if (e->idx != idx || e->id != id) {
+        return NULL;
+    }
+
+    return e;
+}
+
+/* Starts tracking an entry the leader appended to its log at `time`, so the
+ * replicate and commit stages can be measured. */
+void LatencyEntryAppended(LatencyStats *s, raft_index_t idx, raft_entry_id_t id, uint64_t time)
+{
+    s->entries[idx % LATENCY_TRACKED_ENTRIES] = (LatencyEntry){
+        .idx = idx,
+        .id = id,
+        .time = time,
+    };
+}
+
+/* Records the replicate stage for the entries sent to a follower for the
+ * first time. */
+void LatencyEntriesSent(LatencyStats *s, raft_entry_t **entries, raft_index_t first_idx, long n_entries)
+{
+    for (long i = 0; i < n_entries; i++) {
+        LatencyEntry *e = findEntry(s, first_idx + i, entries[i]->id);
+
+        if (e && !e->sent) {
+            LatencyRecord(s, LATENCY_REPLICATE, e->time);
+            e->sent = true;
+        }
+    }
+}
+
+/* Records the commit stage for an entry that is about to be applied and
+ * stops tracking it. */
+void LatencyEntryCommitted(LatencyStats *s, raft_index_t idx, raft_entry_id_t id)
+{
+    LatencyEntry *e = findEntry(s, idx, id);
+
+    if (e) {
+        LatencyRecord(s, LATENCY_COMMIT, e->time);
+        *e = (LatencyEntry){0};
+    }
+}
+
+void LatencyReset(LatencyStats *s)
+{
+    memset(s->stages, 0, sizeof(s->stages));
+}
+
+/* Replies with a map of stage names to the statistics of the stage. */
+void LatencyReply(RedisModuleCtx *ctx, LatencyStats *s)
+{
+    static const struct {
+        const char *name;
+        double percentile;
+    } percentiles[] = {
+        {"p50", 50.0},
+        {"p90", 90.0},
+        {"p99", 99.0},
+        {"p99.9", 99.9},
+    };
+    const int count = sizeof(percentiles) / sizeof(percentiles[0]);
+
+    RedisModule_ReplyWithMap(ctx, LATENCY_STAGE_COUNT);
+
+    for (int i = 0; i < LATENCY_STAGE_COUNT; i++) {
+        LatencyHistogram *h = &s->stages[i];
+
+        RedisModule_ReplyWithCString(ctx, stage_names[i]);
+        RedisModule_ReplyWithMap(ctx, 3 + count);
+
+        RedisModule_ReplyWithCString(ctx, "count");
+        RedisModule_ReplyWithLongLong(ctx, (long long) h->count);
+        RedisModule_ReplyWithCString(ctx, "avg");
+        RedisModule_ReplyWithLongLong(ctx, h->count ? (long long) (h->sum / h->count) : 0);
+
+        for (int j = 0; j < count; j++) {
+            RedisModule_ReplyWithCString(ctx, percentiles[j].name);
+            RedisModule_ReplyWithLongLong(ctx, (long long) LatencyHistogramPercentile(h, percentiles[j].percentile));
+        }
+
+        RedisModule_ReplyWithCString(ctx, "max");
+        RedisModule_ReplyWithLongLong(ctx, (long long) h->max);
+    }
+}
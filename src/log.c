@@ -13,19 +13,67 @@
 #include "common/sc_crc32.h"
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 static const int ENTRY_CACHE_INIT_SIZE = 512;
 static const int ENTRY_ELEM_COUNT = 7;
 static const char *ENTRY_STR = "ENTRY";
 
-static const int RAFTLOG_VERSION = 1;
+/* Log page format versions:
+ *
+ * 1: Entries are stored as RESP multibulk records with a textual crc.
+ * 2: Entries are stored as fixed-size binary headers followed by entry data.
+ *
+ * New pages are always created with the latest version. Pages with an older
+ * version are still read and appended to in their own format.
+ */
+static const int RAFTLOG_VERSION_RESP = 1;
+static const int RAFTLOG_VERSION = 2;
 static const int RAFTLOG_ELEM_COUNT = 7;
 static const char *RAFTLOG_STR = "RAFTLOG";
 
+static const char *MANIFEST_STR = "MANIFEST";
+static const int MANIFEST_VERSION = 1;
+static const int MANIFEST_ELEM_COUNT = 5;
+
+/* Binary entry header (version 2). All fields are little-endian:
+ *
+ * term (u64) | session (u64) | id (u32) | type (u32) | length (u32) | crc (u32)
+ *
+ * Entry data of 'length' bytes follows the header. The crc32c is calculated
+ * over the header (excluding the crc field) and the entry data, seeded with
+ * the crc of the previous entry or the page header.
+ */
+#define ENTRY_HDR_SIZE       32
+#define ENTRY_HDR_CRC_OFFSET 28
+
+/* Index file format. The file starts with a header:
+ *
+ * magic "RAFTIDX" (8 bytes) | version (u32) | page header crc (u32)
+ *
+ * followed by a record for each entry in the log page:
+ *
+ * entry offset (u64) | entry crc (u32) | record crc (u32)
+ *
+ * The page header crc binds the index to its log page and the record crc
+ * detects torn or corrupt records. On load, records that pass these checks are
+ * reused rather than regenerated by parsing the whole log page.
+ */
+static const char IDX_MAGIC[8] = "RAFTIDX";
+static const uint32_t IDX_VERSION = 1;
+
+#define IDX_HDR_SIZE 16
+#define IDX_REC_SIZE 16
+
+/* Minimum number of entries for each verification task when entries of a log
+ * page are verified on the thread pool. */
+#define LOAD_TASK_MIN_ENTRIES 1024
+
 #define RAFTLOG_TRACE(fmt, ...) TRACE_MODULE(RAFTLOG, "<raftlog> " fmt, ##__VA_ARGS__)
 
 static void pageFree(LogPage *p, bool delete_files);
@@ -39,7 +87,7 @@ static size_t pageGenerateHeader(LogPage *p, unsigned char *buf, size_t len)
 
     pos += multibulkWriteLen(pos, end - pos, '*', RAFTLOG_ELEM_COUNT);
     pos += multibulkWriteStr(pos, end - pos, RAFTLOG_STR);
-    pos += multibulkWriteLong(pos, end - pos, RAFTLOG_VERSION);
+    pos += multibulkWriteLong(pos, end - pos, p->version);
     pos += multibulkWriteStr(pos, end - pos, p->dbid);
     pos += multibulkWriteLong(pos, end - pos, p->node_id);
     pos += multibulkWriteLong(pos, end - pos, p->prev_log_term);
@@ -48,11 +96,78 @@ static size_t pageGenerateHeader(LogPage *p, unsigned char *buf, size_t len)
     return pos - buf;
 }
 
+static int pageWriteIdxHeader(LogPage *p, long header_crc)
+{
+    char buf[IDX_HDR_SIZE];
+
+    memcpy(buf, IDX_MAGIC, sizeof(IDX_MAGIC));
+    encodeUInt32LE(buf + 8, IDX_VERSION);
+    encodeUInt32LE(buf + 12, (uint32_t) header_crc);
+
+    if (FileTruncate(&p->idxfile, 0) != RR_OK ||
+        FileWrite(&p->idxfile, buf, sizeof(buf)) != sizeof(buf)) {
+        return RR_ERROR;
+    }
+
+    return RR_OK;
+}
+
+/* Returns true if the index file header matches the log page header */
+static bool pageReadIdxHeader(LogPage *p, long header_crc)
+{
+    char buf[IDX_HDR_SIZE];
+
+    if (FileSetReadOffset(&p->idxfile, 0) != RR_OK ||
+        FileRead(&p->idxfile, buf, sizeof(buf)) != sizeof(buf)) {
+        return false;
+    }
+
+    return memcmp(buf, IDX_MAGIC, sizeof(IDX_MAGIC)) == 0 &&
+           decodeUInt32LE(buf + 8) == IDX_VERSION &&
+           decodeUInt32LE(buf + 12) == (uint32_t) header_crc;
+}
+
+static int pageWriteIdxRecord(LogPage *p, uint64_t offset, long crc)
+{
+    char buf[IDX_REC_SIZE];
+
+    encodeUInt64LE(buf, offset);
+    encodeUInt32LE(buf + 8, (uint32_t) crc);
+    encodeUInt32LE(buf + 12, sc_crc32(0, (uint8_t *) buf, 12));
+
+    if (FileWrite(&p->idxfile, buf, sizeof(buf)) != sizeof(buf)) {
+        return RR_ERROR;
+    }
+
+    return RR_OK;
+}
+
+/* Reads the next record from the index file. Returns false if the record is
+ * missing or fails the crc check. */
+static bool pageReadIdxRecord(LogPage *p, uint64_t *offset, uint32_t *crc)
+{
+    char buf[IDX_REC_SIZE];
+
+    if (FileRead(&p->idxfile, buf, sizeof(buf)) != sizeof(buf) ||
+        decodeUInt32LE(buf + 12) != sc_crc32(0, (uint8_t *) buf, 12)) {
+        return false;
+    }
+
+    *offset = decodeUInt64LE(buf);
+    *crc = decodeUInt32LE(buf + 8);
+
+    return true;
+}
+
 static int pageWriteHeader(LogPage *p)
 {
     unsigned char buf[1024];
     unsigned char *pos;
     unsigned char *end = buf + sizeof(buf);
+
+    /* Header is written to an empty file, so we can use the latest version */
+    p->version = RAFTLOG_VERSION;
+
     ssize_t len = pageGenerateHeader(p, buf, sizeof(buf));
     pos = buf + len;
 
@@ -63,6 +178,7 @@ static int pageWriteHeader(LogPage *p)
 
     if (pageTruncateFiles(p, 0, 0) != RR_OK ||
         FileWrite(&p->file, buf, len) != len ||
+        pageWriteIdxHeader(p, crc) != RR_OK ||
         pageSync(p, true) != RR_OK) {
 
         /* Try to delete files just in case there was a partial write. */
@@ -95,7 +211,7 @@ static int pageReadHeader(LogPage *p, long *read_crc)
     /* Validate */
     if (num_elements != RAFTLOG_ELEM_COUNT ||
         strncmp(RAFTLOG_STR, str, strlen(RAFTLOG_STR)) != 0 ||
-        version != RAFTLOG_VERSION ||
+        version < RAFTLOG_VERSION_RESP || version > RAFTLOG_VERSION ||
         strlen(dbid) != RAFT_DBID_LEN) {
         return RR_ERROR;
     }
@@ -115,6 +231,7 @@ static int pageReadHeader(LogPage *p, long *read_crc)
     memcpy(p->dbid, dbid, sizeof(p->dbid));
     p->dbid[RAFT_DBID_LEN] = '\0';
 
+    p->version = (int) version;
     p->node_id = node_id;
     p->prev_log_term = prev_log_term;
     p->prev_log_idx = prev_log_idx;
@@ -144,44 +261,89 @@ static size_t generateEntryHeader(raft_entry_t *ety, unsigned char *buf, size_t
     return pos - buf;
 }
 
-static int pageWriteEntry(LogPage *p, raft_entry_t *ety)
+/* Generate the binary header of the entry and return its crc, calculated
+ * over the header and the entry data, seeded with prev_crc. */
+static long generateEntryBinaryHeader(raft_entry_t *ety, char *buf, long prev_crc)
+{
+    encodeUInt64LE(buf, (uint64_t) ety->term);
+    encodeUInt64LE(buf + 8, (uint64_t) ety->session);
+    encodeUInt32LE(buf + 16, (uint32_t) ety->id);
+    encodeUInt32LE(buf + 20, (uint32_t) ety->type);
+    encodeUInt32LE(buf + 24, ety->data_len);
+
+    uint32_t crc = sc_crc32((uint32_t) prev_crc, (uint8_t *) buf, ENTRY_HDR_CRC_OFFSET);
+    crc = sc_crc32(crc, (uint8_t *) ety->data, ety->data_len);
+    encodeUInt32LE(buf + ENTRY_HDR_CRC_OFFSET, crc);
+
+    return crc;
+}
+
+static int pageWriteEntryResp(LogPage *p, raft_entry_t *ety, long *crc)
 {
-    int rc;
     unsigned char buf[1024];
     ssize_t len;
 
-    size_t offset = FileSize(&p->file);
-    size_t idxoffset = FileSize(&p->idxfile);
-
     /* header */
     len = generateEntryHeader(ety, buf, sizeof(buf));
     if (FileWrite(&p->file, buf, len) != len) {
-        LOG_WARNING("FileWrite() failed for the file: %s", p->filename);
-        goto error;
+        return RR_ERROR;
     }
 
     /* data */
     if (FileWrite(&p->file, ety->data, ety->data_len) != ety->data_len ||
         FileWrite(&p->file, "\r\n", 2) != 2) {
-        LOG_WARNING("FileWrite() failed for the file: %s", p->filename);
-        goto error;
+        return RR_ERROR;
     }
 
     /* crc */
     /* accumulating crc, so start with current crc */
-    long crc = sc_crc32(p->current_crc, buf, len);
-    crc = sc_crc32(crc, (unsigned char *) ety->data, ety->data_len);
-    crc = sc_crc32(crc, (unsigned char *) "\r\n", 2);
+    *crc = sc_crc32(p->current_crc, buf, len);
+    *crc = sc_crc32(*crc, (unsigned char *) ety->data, ety->data_len);
+    *crc = sc_crc32(*crc, (unsigned char *) "\r\n", 2);
 
     /* write crc as added element */
-    len = multibulkWriteLong(buf, sizeof(buf), crc);
+    len = multibulkWriteLong(buf, sizeof(buf), *crc);
     if (FileWrite(&p->file, buf, len) != len) {
+        return RR_ERROR;
+    }
+
+    return RR_OK;
+}
+
+static int pageWriteEntryBinary(LogPage *p, raft_entry_t *ety, long *crc)
+{
+    char hdr[ENTRY_HDR_SIZE];
+
+    *crc = generateEntryBinaryHeader(ety, hdr, p->current_crc);
+
+    if (FileWrite(&p->file, hdr, sizeof(hdr)) != sizeof(hdr) ||
+        FileWrite(&p->file, ety->data, ety->data_len) != ety->data_len) {
+        return RR_ERROR;
+    }
+
+    return RR_OK;
+}
+
+static int pageWriteEntry(LogPage *p, raft_entry_t *ety)
+{
+    int rc;
+    long crc;
+
+    size_t offset = FileSize(&p->file);
+    size_t idxoffset = FileSize(&p->idxfile);
+
+    if (p->version == RAFTLOG_VERSION_RESP) {
+        rc = pageWriteEntryResp(p, ety, &crc);
+    } else {
+        rc = pageWriteEntryBinary(p, ety, &crc);
+    }
+
+    if (rc != RR_OK) {
         LOG_WARNING("FileWrite() failed for the file: %s", p->filename);
         goto error;
     }
 
-    ssize_t ret = FileWrite(&p->idxfile, &offset, sizeof(offset));
-    if (ret != sizeof(offset)) {
+    if (pageWriteIdxRecord(p, offset, crc) != RR_OK) {
         LOG_WARNING("FileWrite() failed for the file: %s", p->idxfilename);
         goto error;
     }
@@ -199,7 +361,7 @@ error:
     return RR_ERROR;
 }
 
-static raft_entry_t *pageReadEntry(LogPage *p, long *read_crc)
+static raft_entry_t *pageReadEntryResp(LogPage *p, long *read_crc)
 {
     char str[64] = {0};
     int num_elements;
@@ -259,6 +421,154 @@ error:
     return NULL;
 }
 
+static raft_entry_t *pageReadEntryBinary(LogPage *p, long *read_crc)
+{
+    char hdr[ENTRY_HDR_SIZE];
+
+    if (FileRead(&p->file, hdr, sizeof(hdr)) != sizeof(hdr)) {
+        return NULL;
+    }
+
+    /* A corrupt length may point beyond the end of the file */
+    uint32_t length = decodeUInt32LE(hdr + 24);
+    if (length > FileSize(&p->file) - FileGetReadOffset(&p->file)) {
+        return NULL;
+    }
+
+    raft_entry_t *e = raft_entry_new(length);
+    if (FileRead(&p->file, e->data, length) != length) {
+        raft_entry_release(e);
+        return NULL;
+    }
+
+    e->term = (raft_term_t) decodeUInt64LE(hdr);
+    e->session = decodeUInt64LE(hdr + 8);
+    e->id = (raft_entry_id_t) decodeUInt32LE(hdr + 16);
+    e->type = (int) decodeUInt32LE(hdr + 20);
+
+    if (read_crc != NULL) {
+        *read_crc = decodeUInt32LE(hdr + ENTRY_HDR_CRC_OFFSET);
+    }
+
+    return e;
+}
+
+static raft_entry_t *pageReadEntry(LogPage *p, long *read_crc)
+{
+    if (p->version == RAFTLOG_VERSION_RESP) {
+        return pageReadEntryResp(p, read_crc);
+    }
+
+    return pageReadEntryBinary(p, read_crc);
+}
+
+/* Read-only mapping of a sealed log page and its index file, used to read
+ * entries without copying them. Sealed pages are no longer appended to, so the
+ * mapping does not change until the page is truncated. Entries read through
+ * the mapping hold a reference to it, so it may outlive the page. Accessing a
+ * mapping beyond the end of a truncated file raises SIGBUS, so pages are not
+ * truncated while entries reference their mapping, see pageTruncateFiles().
+ */
+typedef struct LogPageMap {
+    int refcount;
+    char *data;      /* Log file contents */
+    size_t data_len; /* Mapped length of the log file */
+    char *idx;       /* Index file contents */
+    size_t idx_len;  /* Mapped length of the index file */
+} LogPageMap;
+
+typedef struct MappedEntry {
+    raft_entry_t entry;
+    LogPageMap *map;
+} MappedEntry;
+
+static LogPageMap *pageMapNew(void)
+{
+    LogPageMap *m = RedisModule_Calloc(1, sizeof(*m));
+    m->refcount = 1;
+
+    return m;
+}
+
+static void pageMapUnmap(LogPageMap *m)
+{
+    if (m->data) {
+        munmap(m->data, m->data_len);
+    }
+    if (m->idx) {
+        munmap(m->idx, m->idx_len);
+    }
+
+    m->data = m->idx = NULL;
+    m->data_len = m->idx_len = 0;
+}
+
+static void pageMapRelease(LogPageMap *m)
+{
+    if (--m->refcount > 0) {
+        return;
+    }
+
+    pageMapUnmap(m);
+    RedisModule_Free(m);
+}
+
+/* Drops the current mapping of the page. The mapping is reused if there are
+ * no entries that reference it. */
+static void pageUnmap(LogPage *p)
+{
+    if (p->map->refcount == 1) {
+        pageMapUnmap(p->map);
+    } else {
+        pageMapRelease(p->map);
+        p->map = pageMapNew();
+    }
+}
+
+/* Maps the current contents of the files */
+static int pageMap(LogPage *p)
+{
+    pageUnmap(p);
+
+    if (FileFlush(&p->file) != RR_OK || FileFlush(&p->idxfile) != RR_OK) {
+        return RR_ERROR;
+    }
+
+    LogPageMap *m = p->map;
+    size_t data_len = FileSize(&p->file);
+    size_t idx_len = FileSize(&p->idxfile);
+
+    char *data = mmap(NULL, data_len, PROT_READ, MAP_SHARED, p->file.fd, 0);
+    char *idx = mmap(NULL, idx_len, PROT_READ, MAP_SHARED, p->idxfile.fd, 0);
+
+    if (data == MAP_FAILED || idx == MAP_FAILED) {
+        LOG_WARNING("mmap() failed for the file: %s: %s", p->filename, strerror(errno));
+
+        if (data != MAP_FAILED) {
+            munmap(data, data_len);
+        }
+        if (idx != MAP_FAILED) {
+            munmap(idx, idx_len);
+        }
+        return RR_ERROR;
+    }
+
+    m->data = data;
+    m->data_len = data_len;
+    m->idx = idx;
+    m->idx_len = idx_len;
+
+    return RR_OK;
+}
+
+static void entryFreeMapped(raft_entry_t *ety)
+{
+    MappedEntry *me = (MappedEntry *) ety;
+
+    pageMapRelease(me->map);
+    RedisModule_Free(me);
+}
+
 static LogPage *pagePrepare(const char *filename)
 {
     int rc;
@@ -269,15 +579,16 @@ static LogPage *pagePrepare(const char *filename)
 
     FileInit(&p->file);
     FileInit(&p->idxfile);
+    p->map = pageMapNew();
 
     rc = FileOpen(&p->file, filename, O_APPEND | O_RDWR | O_CREAT);
     if (rc != RR_OK) {
         goto error;
     }
 
-    int mode = O_APPEND | O_RDWR | O_CREAT | O_TRUNC;
-
-    rc = FileOpen(&p->idxfile, p->idxfilename, mode);
+    /* The index file is validated and reused, or rebuilt, when entries are
+     * loaded. */
+    rc = FileOpen(&p->idxfile, p->idxfilename, O_APPEND | O_RDWR | O_CREAT);
     if (rc != RR_OK) {
         goto error;
     }
@@ -324,6 +635,9 @@ static void pageFree(LogPage *p, bool delete_files)
         return;
     }
 
+    if (p->map) {
+        pageMapRelease(p->map);
+    }
     FileTerm(&p->file);
     FileTerm(&p->idxfile);
 
@@ -365,6 +679,13 @@ static LogPage *pageOpen(const char *filename)
 
 static int pageTruncateFiles(LogPage *p, size_t offset, size_t idxoffset)
 {
+    if (p->map->refcount > 1) {
+        LOG_WARNING("Cannot truncate %s, entries still reference its mapping", p->filename);
+        return RR_ERROR;
+    }
+
+    pageUnmap(p);
+
     if (FileTruncate(&p->file, offset) != RR_OK ||
         FileTruncate(&p->idxfile, idxoffset) != RR_OK) {
         return RR_ERROR;
@@ -373,16 +694,20 @@ static int pageTruncateFiles(LogPage *p, size_t offset, size_t idxoffset)
     return RR_OK;
 }
 
-static bool validateEntryCRC(raft_entry_t *e, long read_crc, long current_crc, long *calc_crc)
+static bool validateEntryCRC(LogPage *p, raft_entry_t *e, long read_crc, long current_crc, long *calc_crc)
 {
     size_t off = 0;
     unsigned char buf[1024];
 
     /* generate the entry as it should be on disk, and calculate crc */
-    off = generateEntryHeader(e, buf, sizeof(buf));
-    *calc_crc = sc_crc32(current_crc, buf, off);
-    *calc_crc = sc_crc32(*calc_crc, (unsigned char *) e->data, e->data_len);
-    *calc_crc = sc_crc32(*calc_crc, (unsigned char *) "\r\n", 2);
+    if (p->version == RAFTLOG_VERSION_RESP) {
+        off = generateEntryHeader(e, buf, sizeof(buf));
+        *calc_crc = sc_crc32(current_crc, buf, off);
+        *calc_crc = sc_crc32(*calc_crc, (unsigned char *) e->data, e->data_len);
+        *calc_crc = sc_crc32(*calc_crc, (unsigned char *) "\r\n", 2);
+    } else {
+        *calc_crc = generateEntryBinaryHeader(e, (char *) buf, current_crc);
+    }
 
     if (*calc_crc != read_crc) {
         return true;
@@ -391,19 +716,16 @@ static bool validateEntryCRC(raft_entry_t *e, long read_crc, long current_crc, l
     return false;
 }
 
-static int pageLoadEntries(LogPage *p)
+/* Loads entries of a version 1 page. Entries are parsed one by one to
+ * validate the running crc, and the index file is rebuilt. */
+static int pageLoadEntriesResp(LogPage *p)
 {
     long calc_crc = 0, read_crc = 0;
 
-    p->num_entries = 0;
-
-    if (pageReadHeader(p, &read_crc) != RR_OK) {
-        return RR_ERROR;
+    if (pageWriteIdxHeader(p, p->current_crc) != RR_OK) {
+        PANIC("FileWrite() failed for the file: %s", p->idxfilename);
     }
 
-    /* already validated crc in LogOpen, update running crc */
-    p->current_crc = read_crc;
-
     /* Read Entries */
     while (true) {
         uint64_t offset = (uint64_t) FileGetReadOffset(&p->file);
@@ -424,7 +746,7 @@ static int pageLoadEntries(LogPage *p)
             return RR_OK;
         }
 
-        bool error = validateEntryCRC(e, read_crc, p->current_crc, &calc_crc);
+        bool error = validateEntryCRC(p, e, read_crc, p->current_crc, &calc_crc);
         raft_entry_release(e);
         if (error) {
             LOG_WARNING("Entry failed crc32 check, truncating log to "
@@ -443,11 +765,309 @@ static int pageLoadEntries(LogPage *p)
         p->index++;
         p->num_entries++;
 
-        ssize_t rc = FileWrite(&p->idxfile, &offset, sizeof(offset));
-        if (rc != sizeof(offset)) {
+        if (pageWriteIdxRecord(p, offset, calc_crc) != RR_OK) {
+            PANIC("FileWrite() failed for the file: %s", p->idxfilename);
+        }
+    }
+}
+
+/* Offsets and crcs of the entries found in a version 2 page */
+typedef struct LoadIndex {
+    uint64_t *offsets;
+    uint32_t *crcs;
+    raft_index_t count;
+    raft_index_t cap;
+} LoadIndex;
+
+static void loadIndexAdd(LoadIndex *li, uint64_t offset, uint32_t crc)
+{
+    if (li->count == li->cap) {
+        li->cap = li->cap ? li->cap * 2 : 1024;
+        li->offsets = RedisModule_Realloc(li->offsets, li->cap * sizeof(*li->offsets));
+        li->crcs = RedisModule_Realloc(li->crcs, li->cap * sizeof(*li->crcs));
+    }
+
+    li->offsets[li->count] = offset;
+    li->crcs[li->count] = crc;
+    li->count++;
+}
+
+/* Locates entries starting at 'pos' by scanning their headers, until the end
+ * of the page or a header with a length that does not fit in the page. */
+static void loadIndexScan(LoadIndex *li, const char *map, size_t size, size_t pos)
+{
+    while (pos + ENTRY_HDR_SIZE <= size) {
+        uint32_t len = decodeUInt32LE(map + pos + 24);
+        if (len > size - pos - ENTRY_HDR_SIZE) {
+            break;
+        }
+
+        loadIndexAdd(li, pos, decodeUInt32LE(map + pos + ENTRY_HDR_CRC_OFFSET));
+        pos += ENTRY_HDR_SIZE + len;
+    }
+}
+
+/* Returns the offset after the last of the first 'count' entries */
+static size_t loadIndexEnd(const LoadIndex *li, const char *map, raft_index_t count, size_t first)
+{
+    if (!count) {
+        return first;
+    }
+
+    uint64_t last = li->offsets[count - 1];
+    return last + ENTRY_HDR_SIZE + decodeUInt32LE(map + last + 24);
+}
+
+typedef struct LoadJob {
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    int pending; /* Tasks still running */
+} LoadJob;
+
+/* Verifies entries [begin, end) of a version 2 page. The crc of each entry is
+ * seeded with the crc stored for the previous entry, so tasks can verify
+ * different ranges of the same page independently. */
+typedef struct LoadTask {
+    LoadJob *job;
+    const LoadIndex *li;
+    const char *map;    /* Log page contents */
+    size_t size;        /* Log page size */
+    raft_index_t begin; /* First entry to verify */
+    raft_index_t end;   /* Entry after the last entry to verify */
+    uint32_t prev_crc;  /* Crc of the entry before 'begin' */
+    raft_index_t valid; /* Number of entries that passed verification */
+} LoadTask;
+
+static void loadTaskVerify(LoadTask *t)
+{
+    const LoadIndex *li = t->li;
+    uint32_t crc = t->prev_crc;
+
+    for (raft_index_t i = t->begin; i < t->end; i++) {
+        const char *hdr = t->map + li->offsets[i];
+        uint64_t len = decodeUInt32LE(hdr + 24);
+        uint64_t next = li->offsets[i] + ENTRY_HDR_SIZE + len;
+
+        /* Entries must be adjacent and the last one must fit in the file */
+        if ((i + 1 < li->count && next != li->offsets[i + 1]) || next > t->size) {
+            return;
+        }
+
+        crc = sc_crc32(crc, (uint8_t *) hdr, ENTRY_HDR_CRC_OFFSET);
+        crc = sc_crc32(crc, (uint8_t *) hdr + ENTRY_HDR_SIZE, (uint32_t) len);
+
+        if (crc != li->crcs[i] || crc != decodeUInt32LE(hdr + ENTRY_HDR_CRC_OFFSET)) {
+            return;
+        }
+
+        t->valid++;
+    }
+}
+
+static void loadTaskRun(void *arg)
+{
+    LoadTask *t = arg;
+    LoadJob *job = t->job;
+
+    loadTaskVerify(t);
+
+    pthread_mutex_lock(&job->mtx);
+    job->pending--;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->mtx);
+}
+
+/* Verifies entries, splitting the work across the thread pool if there are
+ * enough entries. Returns the number of leading entries that are valid. */
+static raft_index_t loadIndexVerify(const LoadIndex *li, const char *map,
+                                    size_t size, long header_crc,
+                                    ThreadPool *pool)
+{
+    raft_index_t tasks = 1;
+
+    if (pool) {
+        tasks = MAX(1, MIN(pool->thread_count, li->count / LOAD_TASK_MIN_ENTRIES));
+    }
+
+    LoadJob job = {
+        .mtx = PTHREAD_MUTEX_INITIALIZER,
+        .pending = (int) tasks,
+    };
+    pthread_cond_init(&job.cond, NULL);
+
+    LoadTask *t = RedisModule_Calloc(tasks, sizeof(*t));
+    raft_index_t per_task = li->count / tasks;
+
+    for (raft_index_t i = 0; i < tasks; i++) {
+        t[i] = (LoadTask){
+            .job = &job,
+            .li = li,
+            .map = map,
+            .size = size,
+            .begin = i * per_task,
+            .end = (i == tasks - 1) ? li->count : (i + 1) * per_task,
+        };
+        t[i].prev_crc = t[i].begin ? li->crcs[t[i].begin - 1] : (uint32_t) header_crc;
+    }
+
+    if (tasks == 1) {
+        loadTaskVerify(&t[0]);
+    } else {
+        for (raft_index_t i = 0; i < tasks; i++) {
+            threadPoolAdd(pool, &t[i], loadTaskRun);
+        }
+
+        pthread_mutex_lock(&job.mtx);
+        while (job.pending > 0) {
+            pthread_cond_wait(&job.cond, &job.mtx);
+        }
+        pthread_mutex_unlock(&job.mtx);
+    }
+
+    /* Entries are valid up to the first failure */
+    raft_index_t valid = 0;
+    for (raft_index_t i = 0; i < tasks; i++) {
+        valid += t[i].valid;
+        if (t[i].valid != t[i].end - t[i].begin) {
+            break;
+        }
+    }
+
+    RedisModule_Free(t);
+    pthread_cond_destroy(&job.cond);
+
+    return valid;
+}
+
+/* Loads entries of a version 2 page.
+ *
+ * Entry offsets are taken from the index file as long as its records are
+ * valid, and the remaining entries are located by scanning the entry headers.
+ * Then, entries are verified in parallel.
+ *
+ * The index file is not fsync'ed, so after a crash, its records may be stale
+ * even though they are self-consistent. If an entry located through the index
+ * file fails verification, the index is discarded from that entry on and the
+ * rest of the page is scanned again. The log page is only truncated at an
+ * entry that fails verification when it is located by scanning, i.e. when the
+ * log file itself is corrupt or partially written. The index file is only
+ * rewritten from the first record that could not be reused. */
+static int pageLoadEntriesBinary(LogPage *p, ThreadPool *pool)
+{
+    LoadIndex li = {0};
+    size_t first = FileGetReadOffset(&p->file);
+    size_t size = FileSize(&p->file);
+    long header_crc = p->current_crc;
+
+    char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, p->file.fd, 0);
+    if (map == MAP_FAILED) {
+        LOG_WARNING("mmap() failed for the file: %s: %s", p->filename, strerror(errno));
+        return RR_ERROR;
+    }
+
+    /* Reuse index records as long as they point to consecutive offsets */
+    bool idx_valid = pageReadIdxHeader(p, header_crc);
+    if (idx_valid) {
+        uint64_t offset, expected = first;
+        uint32_t crc;
+
+        while (pageReadIdxRecord(p, &offset, &crc)) {
+            if (offset < expected || offset > size - ENTRY_HDR_SIZE ||
+                (li.count == 0 && offset != first)) {
+                break;
+            }
+
+            loadIndexAdd(&li, offset, crc);
+            expected = offset + ENTRY_HDR_SIZE;
+        }
+    }
+
+    raft_index_t reused = li.count;
+
+    /* Scan entry headers that follow the last indexed entry */
+    loadIndexScan(&li, map, size, loadIndexEnd(&li, map, li.count, first));
+
+    raft_index_t valid = loadIndexVerify(&li, map, size, header_crc, pool);
+
+    /* Stale index record, rescan the page from the last valid entry */
+    if (valid < reused) {
+        LOG_NOTICE("Index file is stale at entry %ld, rebuilding it from the log file: %s",
+                   p->index + valid + 1, p->filename);
+
+        li.count = valid;
+        reused = valid;
+
+        loadIndexScan(&li, map, size, loadIndexEnd(&li, map, valid, first));
+        valid = loadIndexVerify(&li, map, size, header_crc, pool);
+    }
+
+    size_t end = loadIndexEnd(&li, map, valid, first);
+
+    munmap(map, size);
+
+    if (end < size) {
+        if (valid < li.count) {
+            LOG_WARNING("Entry failed crc32 check, truncating log to "
+                        "previous entry: %ld",
+                        p->index + valid);
+        } else {
+            LOG_WARNING("Found partial entry at the end of the log file. "
+                        "Discarding %zu bytes.",
+                        size - end);
+        }
+
+        if (FileTruncate(&p->file, end) != RR_OK) {
+            PANIC("FileTruncate() failed for the file: %s", p->filename);
+        }
+    }
+
+    /* Rewrite the index file from the first record that was not reused */
+    reused = MIN(reused, valid);
+    if (!idx_valid) {
+        if (pageWriteIdxHeader(p, header_crc) != RR_OK) {
+            PANIC("FileWrite() failed for the file: %s", p->idxfilename);
+        }
+    } else if (FileTruncate(&p->idxfile, IDX_HDR_SIZE + reused * IDX_REC_SIZE) != RR_OK) {
+        PANIC("FileTruncate() failed for the file: %s", p->idxfilename);
+    }
+
+    for (raft_index_t i = reused; i < valid; i++) {
+        if (pageWriteIdxRecord(p, li.offsets[i], li.crcs[i]) != RR_OK) {
             PANIC("FileWrite() failed for the file: %s", p->idxfilename);
         }
     }
+
+    LOG_VERBOSE("Loaded %ld entries from %s, reused %ld index records.",
+                valid, p->filename, reused);
+
+    p->index += valid;
+    p->num_entries = valid;
+    p->current_crc = valid ? li.crcs[valid - 1] : header_crc;
+
+    RedisModule_Free(li.offsets);
+    RedisModule_Free(li.crcs);
+
+    return RR_OK;
+}
+
+static int pageLoadEntries(LogPage *p, ThreadPool *pool)
+{
+    long read_crc = 0;
+
+    p->num_entries = 0;
+
+    if (pageReadHeader(p, &read_crc) != RR_OK) {
+        return RR_ERROR;
+    }
+
+    /* already validated crc in LogOpen, update running crc */
+    p->current_crc = read_crc;
+
+    if (p->version == RAFTLOG_VERSION_RESP) {
+        return pageLoadEntriesResp(p);
+    }
+
+    return pageLoadEntriesBinary(p, pool);
 }
 
 static int pageSync(LogPage *p, bool sync)
@@ -457,6 +1077,13 @@ static int pageSync(LogPage *p, bool sync)
         return RR_ERROR;
     }
 
+    /* Index file is not fsync'ed as it can be repaired on load, but keeping it
+     * up-to-date with the log file lets us reuse more of it after a crash. */
+    if (FileFlush(&p->idxfile) != RR_OK) {
+        LOG_WARNING("FileFlush() failed for the file: %s", p->idxfilename);
+        return RR_ERROR;
+    }
+
     if (sync) {
         if (FileFsync(&p->file) != RR_OK) {
             LOG_WARNING("FileFsync() failed for the file: %s", p->filename);
@@ -482,7 +1109,8 @@ static int pageAppend(LogPage *p, raft_entry_t *entry)
 static size_t pageSeekEntry(LogPage *p, raft_index_t idx)
 {
     uint64_t offset;
-    size_t idxoffset = (sizeof(uint64_t) * (idx - p->prev_log_idx - 1));
+    uint32_t crc;
+    size_t idxoffset = IDX_HDR_SIZE + IDX_REC_SIZE * (idx - p->prev_log_idx - 1);
 
     /* Bounds check */
     if (idx <= p->prev_log_idx ||
@@ -491,7 +1119,7 @@ static size_t pageSeekEntry(LogPage *p, raft_index_t idx)
     }
 
     if (FileSetReadOffset(&p->idxfile, idxoffset) != RR_OK ||
-        FileRead(&p->idxfile, &offset, sizeof(offset)) != sizeof(offset) ||
+        !pageReadIdxRecord(p, &offset, &crc) ||
         FileSetReadOffset(&p->file, offset) != RR_OK) {
         return 0;
     }
@@ -499,8 +1127,68 @@ static size_t pageSeekEntry(LogPage *p, raft_index_t idx)
     return offset;
 }
 
-static raft_entry_t *pageGet(LogPage *p, raft_index_t idx)
+/* Returns an entry of a sealed version 2 page, with data that references the
+ * page mapping. The mapping is recreated if the entry was appended after it,
+ * i.e. the page was truncated and sealed again. */
+static raft_entry_t *pageGetMapped(LogPage *p, raft_index_t idx)
+{
+    size_t idxoffset = IDX_HDR_SIZE + IDX_REC_SIZE * (idx - p->prev_log_idx - 1);
+
+    /* Bounds check */
+    if (idx <= p->prev_log_idx ||
+        idx > p->prev_log_idx + p->num_entries) {
+        return NULL;
+    }
+
+    if (!p->map->data || idxoffset + IDX_REC_SIZE > p->map->idx_len) {
+        if (pageMap(p) != RR_OK || idxoffset + IDX_REC_SIZE > p->map->idx_len) {
+            return NULL;
+        }
+    }
+
+    LogPageMap *m = p->map;
+    const char *rec = m->idx + idxoffset;
+
+    if (decodeUInt32LE(rec + 12) != sc_crc32(0, (uint8_t *) rec, 12)) {
+        return NULL;
+    }
+
+    uint64_t offset = decodeUInt64LE(rec);
+    if (offset + ENTRY_HDR_SIZE > m->data_len) {
+        return NULL;
+    }
+
+    const char *hdr = m->data + offset;
+    uint32_t len = decodeUInt32LE(hdr + 24);
+    if (len > m->data_len - offset - ENTRY_HDR_SIZE) {
+        return NULL;
+    }
+
+    MappedEntry *me = RedisModule_Calloc(1, sizeof(*me));
+
+    me->map = m;
+    m->refcount++;
+
+    me->entry.refs = 1;
+    me->entry.free_func = entryFreeMapped;
+    me->entry.data = (char *) hdr + ENTRY_HDR_SIZE;
+    me->entry.data_len = len;
+    me->entry.term = (raft_term_t) decodeUInt64LE(hdr);
+    me->entry.session = decodeUInt64LE(hdr + 8);
+    me->entry.id = (raft_entry_id_t) decodeUInt32LE(hdr + 16);
+    me->entry.type = (int) decodeUInt32LE(hdr + 20);
+
+    return &me->entry;
+}
+
+/* Returns an entry of the page. If mapped is true, the entry is read through
+ * the page mapping, which suits sealed pages only. */
+static raft_entry_t *pageGet(LogPage *p, raft_index_t idx, bool mapped)
 {
+    if (mapped && p->version != RAFTLOG_VERSION_RESP) {
+        return pageGetMapped(p, idx);
+    }
+
     if (pageSeekEntry(p, idx) <= 0) {
         return NULL;
     }
@@ -525,10 +1213,10 @@ static int pageDelete(LogPage *p, raft_index_t from_idx)
         }
 
         raft_index_t relidx = from_idx - p->prev_log_idx - 1;
-        size_t idxoffset = relidx * sizeof(uint64_t);
+        size_t idxoffset = IDX_HDR_SIZE + relidx * IDX_REC_SIZE;
 
         if (pageTruncateFiles(p, offset, idxoffset) != RR_OK) {
-            PANIC("ftruncate failed: %s", strerror(errno));
+            PANIC("Failed to truncate the file: %s", p->filename);
         }
 
         p->num_entries -= count;
@@ -544,20 +1232,180 @@ static int pageDelete(LogPage *p, raft_index_t from_idx)
             size_t len = pageGenerateHeader(p, buf, sizeof(buf));
             p->current_crc = sc_crc32(0, buf, len);
         } else { /* log entry */
-            /* To regenerate running crc value, need to reread last entry. */
-            long read_crc;
+            /* Running crc value is the crc of the last entry, which is
+             * stored in the index file. */
+            uint64_t pos;
+            uint32_t crc;
+            size_t last = IDX_HDR_SIZE + (relidx - 1) * IDX_REC_SIZE;
+
+            if (FileSetReadOffset(&p->idxfile, last) != RR_OK ||
+                !pageReadIdxRecord(p, &pos, &crc)) {
+                PANIC("Failed to read index file: %s", p->idxfilename);
+            }
+
+            p->current_crc = crc;
+        }
+    }
+
+    return RR_OK;
+}
+
+static char *segmentFileName(char *buf, size_t size, const char *filename, long seq)
+{
+    if (seq == 0) {
+        safesnprintf(buf, size, "%s", filename);
+    } else {
+        safesnprintf(buf, size, "%s.%ld", filename, seq);
+    }
+
+    return buf;
+}
+
+static char *manifestFileName(char *buf, size_t size, const char *filename)
+{
+    safesnprintf(buf, size, "%s.manifest", filename);
+    return buf;
+}
+
+/* Manifest file lists the log segments, ordered by index:
+ *
+ * "MANIFEST" | version | next_seq | compaction_idx | count | seq... (RESP)
+ *
+ * Segment files are named after the log file, with the sequence number as the
+ * suffix. Sequence number zero is the log file itself. The manifest is
+ * replaced atomically whenever segments are added or removed.
+ */
+static void logWriteManifest(Log *log)
+{
+    char filename[PATH_MAX], tmp[PATH_MAX];
+    size_t cap = 256 + (size_t) log->num_pages * 32;
+    char *buf = RedisModule_Alloc(cap);
+    char *pos = buf;
+    char *end = buf + cap;
+    File f;
+
+    pos += multibulkWriteLen(pos, end - pos, '*', MANIFEST_ELEM_COUNT + log->num_pages);
+    pos += multibulkWriteStr(pos, end - pos, MANIFEST_STR);
+    pos += multibulkWriteInt(pos, end - pos, MANIFEST_VERSION);
+    pos += multibulkWriteLong(pos, end - pos, log->next_seq);
+    pos += multibulkWriteLong(pos, end - pos, log->compaction_idx);
+    pos += multibulkWriteInt(pos, end - pos, log->num_pages);
+
+    for (int i = 0; i < log->num_pages; i++) {
+        pos += multibulkWriteLong(pos, end - pos, log->pages[i]->seq);
+    }
+
+    ssize_t len = pos - buf;
 
-            size_t pos = pageSeekEntry(p, p->index);
-            RedisModule_Assert(pos > 0);
+    manifestFileName(filename, sizeof(filename), log->filename);
+    safesnprintf(tmp, sizeof(tmp), "%s.tmp", filename);
 
-            raft_entry_t *e = pageReadEntry(p, &read_crc);
-            raft_entry_release(e);
+    FileInit(&f);
 
-            p->current_crc = read_crc;
+    if (FileOpen(&f, tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND) != RR_OK ||
+        FileWrite(&f, buf, len) != len ||
+        FileTerm(&f) != RR_OK ||
+        fsyncFileAt(tmp) != RR_OK ||
+        syncRename(tmp, filename) != RR_OK) {
+        PANIC("Failed to write manifest file: %s: %s", filename, strerror(errno));
+    }
+
+    RedisModule_Free(buf);
+}
+
+/* Reads the manifest file. Returns the sequence numbers of the segments, or
+ * NULL if there is no manifest file. */
+static long *logReadManifest(Log *log, int *count)
+{
+    char filename[PATH_MAX];
+    char str[64] = {0};
+    int elem_count, version;
+    long *seqs;
+    File f;
+
+    manifestFileName(filename, sizeof(filename), log->filename);
+    FileInit(&f);
+
+    if (FileOpen(&f, filename, O_RDONLY) != RR_OK) {
+        if (errno != ENOENT) {
+            PANIC("FileOpen(): %s: %s", filename, strerror(errno));
         }
+
+        FileTerm(&f);
+        return NULL;
     }
 
-    return RR_OK;
+    if (!multibulkReadLen(&f, '*', &elem_count) ||
+        !multibulkReadStr(&f, str, sizeof(str)) ||
+        !multibulkReadInt(&f, &version) ||
+        !multibulkReadLong(&f, &log->next_seq) ||
+        !multibulkReadLong(&f, &log->compaction_idx) ||
+        !multibulkReadInt(&f, count) ||
+        strncmp(str, MANIFEST_STR, strlen(MANIFEST_STR)) != 0 ||
+        version != MANIFEST_VERSION ||
+        *count < 1 ||
+        elem_count != MANIFEST_ELEM_COUNT + *count) {
+        PANIC("Failed to read manifest file: %s", filename);
+    }
+
+    seqs = RedisModule_Calloc(*count, sizeof(*seqs));
+
+    for (int i = 0; i < *count; i++) {
+        if (!multibulkReadLong(&f, &seqs[i])) {
+            PANIC("Failed to read manifest file: %s", filename);
+        }
+    }
+
+    FileTerm(&f);
+
+    return seqs;
+}
+
+static LogPage *logLastPage(Log *log)
+{
+    return log->pages[log->num_pages - 1];
+}
+
+static void logAddPage(Log *log, LogPage *p)
+{
+    log->pages = RedisModule_Realloc(log->pages, sizeof(*log->pages) * (log->num_pages + 1));
+    log->pages[log->num_pages++] = p;
+}
+
+/* Removes segments from 'from' to the end of the log, and deletes their
+ * files. */
+static void logRemovePages(Log *log, int from)
+{
+    int count = log->num_pages;
+
+    log->num_pages = from;
+    logWriteManifest(log);
+
+    for (int i = from; i < count; i++) {
+        pageFree(log->pages[i], true);
+        log->pages[i] = NULL;
+    }
+}
+
+/* Returns the position of the segment that contains the entry at idx, or -1 */
+static int logFindPage(Log *log, raft_index_t idx)
+{
+    int lo = 0, hi = log->num_pages - 1;
+
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        LogPage *p = log->pages[mid];
+
+        if (idx <= p->prev_log_idx) {
+            hi = mid - 1;
+        } else if (idx > p->index) {
+            lo = mid + 1;
+        } else {
+            return mid;
+        }
+    }
+
+    return -1;
 }
 
 void LogInit(Log *log)
@@ -565,10 +1413,32 @@ void LogInit(Log *log)
     *log = (Log){0};
 }
 
+/* Fsync()s, if sync is true, and closes sealed segment files */
+static void logSyncSealed(Log *log, bool sync)
+{
+    for (int i = 0; i < log->num_sealed_fds; i++) {
+        if (sync && fsyncFile(log->sealed_fds[i]) != RR_OK) {
+            PANIC("fsync(): %s", strerror(errno));
+        }
+        close(log->sealed_fds[i]);
+    }
+
+    RedisModule_Free(log->sealed_fds);
+    log->sealed_fds = NULL;
+    log->num_sealed_fds = 0;
+}
+
 void LogTerm(Log *log)
 {
-    pageFree(log->pages[0], false);
-    pageFree(log->pages[1], false);
+    logSyncSealed(log, false);
+
+    for (int i = 0; i < log->num_pages; i++) {
+        pageFree(log->pages[i], false);
+    }
+
+    RedisModule_Free(log->pages);
+    log->pages = NULL;
+    log->num_pages = 0;
 }
 
 int LogCreate(Log *log, const char *filename, const char *dbid,
@@ -577,57 +1447,85 @@ int LogCreate(Log *log, const char *filename, const char *dbid,
 {
     RedisModule_Assert(strlen(dbid) == RAFT_DBID_LEN);
 
-    log->pages[0] = pageCreate(filename, dbid, node_id, prev_log_term,
-                               prev_log_index);
-    if (!log->pages[0]) {
+    LogPage *p = pageCreate(filename, dbid, node_id, prev_log_term,
+                            prev_log_index);
+    if (!p) {
         return RR_ERROR;
     }
 
-    memcpy(log->dbid, log->pages[0]->dbid, RAFT_DBID_LEN);
+    safesnprintf(log->filename, sizeof(log->filename), "%s", filename);
+    memcpy(log->dbid, p->dbid, RAFT_DBID_LEN);
     log->dbid[RAFT_DBID_LEN] = '\0';
     log->node_id = node_id;
+    log->next_seq = 1;
+    log->compaction_idx = 0;
 
-    return RR_OK;
-}
+    logAddPage(log, p);
+    logWriteManifest(log);
 
-static char *secondPageFileName(char *buf, size_t size, const char *filename)
-{
-    safesnprintf(buf, size, "%s.1", filename);
-    return buf;
+    return RR_OK;
 }
 
 int LogOpen(Log *log, const char *filename)
 {
-    log->pages[0] = pageOpen(filename);
-    if (!log->pages[0]) {
-        return RR_ERROR;
-    }
+    char buf[PATH_MAX];
+    bool legacy = false;
+    int count;
+    long *seqs;
 
-    memcpy(log->dbid, log->pages[0]->dbid, RAFT_DBID_LEN);
-    log->dbid[RAFT_DBID_LEN] = '\0';
-    log->node_id = log->pages[0]->node_id;
+    safesnprintf(log->filename, sizeof(log->filename), "%s", filename);
 
-    char buf[PATH_MAX];
-    secondPageFileName(buf, sizeof(buf), filename);
+    seqs = logReadManifest(log, &count);
+    if (!seqs) {
+        /* No manifest, the log consists of the log file and the second page
+         * of an unfinished compaction, if it exists. */
+        segmentFileName(buf, sizeof(buf), filename, 1);
 
-    if (access(buf, F_OK) != 0) {
-        return RR_OK;
+        count = access(buf, F_OK) == 0 ? 2 : 1;
+        seqs = RedisModule_Calloc(count, sizeof(*seqs));
+        seqs[count - 1] = count - 1;
+        log->next_seq = count;
+        legacy = true;
     }
 
-    log->pages[1] = pageOpen(buf);
-    if (!log->pages[1]) {
-        return RR_ERROR;
+    for (int i = 0; i < count; i++) {
+        segmentFileName(buf, sizeof(buf), filename, seqs[i]);
+
+        LogPage *p = pageOpen(buf);
+        if (!p) {
+            RedisModule_Free(seqs);
+            LogTerm(log);
+            return RR_ERROR;
+        }
+
+        p->seq = seqs[i];
+        logAddPage(log, p);
     }
 
+    RedisModule_Free(seqs);
+
     LogPage *p0 = log->pages[0];
-    LogPage *p1 = log->pages[1];
 
-    if (p0->node_id != p1->node_id || strcmp(p0->dbid, p1->dbid) != 0) {
-        PANIC("Log pages do not match: p0 node_id=%d, dbid=%s, "
-              "p1 node_id=%d, dbid=%s",
-              p0->node_id, p0->dbid, p1->node_id, p1->dbid);
+    for (int i = 1; i < log->num_pages; i++) {
+        LogPage *p = log->pages[i];
+
+        if (p0->node_id != p->node_id || strcmp(p0->dbid, p->dbid) != 0) {
+            PANIC("Log pages do not match: p0 node_id=%d, dbid=%s, "
+                  "p%d node_id=%d, dbid=%s",
+                  p0->node_id, p0->dbid, i, p->node_id, p->dbid);
+        }
+
+    }
+
+    /* Second page of the previous log format means compaction was started */
+    if (legacy && log->num_pages == 2) {
+        log->compaction_idx = log->pages[1]->prev_log_idx;
     }
 
+    memcpy(log->dbid, p0->dbid, RAFT_DBID_LEN);
+    log->dbid[RAFT_DBID_LEN] = '\0';
+    log->node_id = p0->node_id;
+
     return RR_OK;
 }
 
@@ -635,17 +1533,53 @@ size_t LogFileSize(Log *log)
 {
     size_t n = 0;
 
-    if (log->pages[0]) {
-        n += FileSize(&log->pages[0]->file);
+    for (int i = 0; i < log->num_pages; i++) {
+        n += FileSize(&log->pages[i]->file);
     }
 
-    if (log->pages[1]) {
-        n += FileSize(&log->pages[1]->file);
+    return n;
+}
+
+/* Returns the size of the entries after idx in the log files, e.g. to tell how
+ * much data a follower is missing. Page headers are included for the pages
+ * that only contain entries after idx, so the value is an approximation.
+ */
+size_t LogBytesAfter(Log *log, raft_index_t idx)
+{
+    size_t n = 0;
+
+    for (int i = log->num_pages - 1; i >= 0; i--) {
+        LogPage *p = log->pages[i];
+
+        if (idx >= p->index) {
+            break;
+        }
+
+        if (idx <= p->prev_log_idx) {
+            n += FileSize(&p->file);
+            continue;
+        }
+
+        size_t offset = pageSeekEntry(p, idx + 1);
+        if (offset) {
+            n += FileSize(&p->file) - offset;
+        }
+        break;
     }
 
     return n;
 }
 
+size_t LogSegmentSize(Log *log)
+{
+    return FileSize(&logLastPage(log)->file);
+}
+
+int LogSegmentCount(Log *log)
+{
+    return log->num_pages;
+}
+
 raft_node_id_t LogNodeId(Log *log)
 {
     return log->node_id;
@@ -658,37 +1592,125 @@ const char *LogDbid(Log *log)
 
 int LogAppend(Log *log, raft_entry_t *entry)
 {
-    LogPage *last = log->pages[1] ? log->pages[1] : log->pages[0];
-    return pageAppend(last, entry);
+    LogPage *last = logLastPage(log);
+    size_t size = FileSize(&last->file);
+
+    int rc = pageAppend(last, entry);
+    if (rc == RR_OK) {
+        log->bytes_written += FileSize(&last->file) - size;
+    }
+
+    return rc;
 }
 
-int LogLoadEntries(Log *log)
+/* Seals the last segment and starts a new one. Does nothing if the last
+ * segment is empty.
+ *
+ * The sealed segment is only flushed here. Its file is kept open, so it is
+ * fsync'd along with the current segment by the next LogSync() call or by
+ * fsyncThread, see LogTakeSealedFd(). */
+static int logAddSegment(Log *log)
 {
-    LogPage *p0 = log->pages[0];
-    LogPage *p1 = log->pages[1];
+    char buf[PATH_MAX];
+    LogPage *last = logLastPage(log);
+
+    if (last->num_entries == 0) {
+        return RR_OK;
+    }
+
+    raft_entry_t *e = pageGet(last, last->index, false);
+    RedisModule_Assert(e != NULL);
+    raft_term_t term = e->term;
+    raft_entry_release(e);
+
+    if (pageSync(last, false) != RR_OK) {
+        PANIC("pageFsync() failed for the file: %s", last->filename);
+    }
+
+    int fd = dup(last->file.fd);
+    if (fd < 0) {
+        LOG_WARNING("dup() failed for the file: %s, %s", last->filename, strerror(errno));
+        return RR_ERROR;
+    }
+
+    log->sealed_fds = RedisModule_Realloc(log->sealed_fds, (log->num_sealed_fds + 1) * sizeof(int));
+    log->sealed_fds[log->num_sealed_fds++] = fd;
+
+    long seq = log->next_seq++;
+    segmentFileName(buf, sizeof(buf), log->filename, seq);
+
+    LogPage *p = pageCreate(buf, last->dbid, last->node_id, term, last->index);
+    if (!p) {
+        return RR_ERROR;
+    }
+
+    p->seq = seq;
+    logAddPage(log, p);
 
-    if (pageLoadEntries(p0) != RR_OK) {
+    return RR_OK;
+}
+
+int LogAddSegment(Log *log)
+{
+    if (logAddSegment(log) != RR_OK) {
         return RR_ERROR;
     }
 
-    if (p1) {
-        if (pageLoadEntries(p1) != RR_OK) {
+    logWriteManifest(log);
+    return RR_OK;
+}
+
+/* Loads entries from the log files. If 'pool' is not NULL, entry verification
+ * is split across its threads. */
+int LogLoadEntries(Log *log, ThreadPool *pool)
+{
+    int count = log->num_pages;
+
+    for (int i = 0; i < log->num_pages; i++) {
+        if (pageLoadEntries(log->pages[i], pool) != RR_OK) {
             return RR_ERROR;
         }
+    }
+
+    /* Delete segments that follow a gap, e.g. if a segment was truncated due
+     * to corruption, and empty segments at the end of the log. */
+    for (int i = 1; i < count; i++) {
+        LogPage *prev = log->pages[i - 1];
+        LogPage *p = log->pages[i];
+
+        if (p->prev_log_idx != prev->index) {
+            count = i;
+            break;
+        }
+    }
+
+    while (count > 1 && log->pages[count - 1]->num_entries == 0) {
+        count--;
+    }
 
-        /* If second page is empty or if there is a gap between the first and
-         * second page, delete the second page. */
-        if (p1->num_entries == 0 || p1->prev_log_idx != p0->index) {
-            LOG_WARNING("Deleting second log page=%s, first page index:%ld, "
-                        "num_entries=%ld, prev_log_index:%ld",
-                        p1->filename, p0->index, p1->num_entries,
-                        p1->prev_log_idx);
+    for (int i = count; i < log->num_pages; i++) {
+        LogPage *p = log->pages[i];
 
-            pageFree(p1, true);
-            log->pages[1] = NULL;
+        LOG_WARNING("Deleting log segment=%s, previous segment index:%ld, "
+                    "num_entries=%ld, prev_log_index:%ld",
+                    p->filename, log->pages[i - 1]->index, p->num_entries,
+                    p->prev_log_idx);
+    }
+
+    /* Compaction is only in progress if its segment still exists */
+    bool found = false;
+    for (int i = 1; i < count; i++) {
+        if (log->pages[i]->prev_log_idx == log->compaction_idx) {
+            found = true;
         }
     }
 
+    if (!found) {
+        log->compaction_idx = 0;
+    }
+
+    logRemovePages(log, count);
+
     return RR_OK;
 }
 
@@ -704,7 +1726,7 @@ raft_index_t LogPrevLogIndex(Log *log)
 
 raft_index_t LogCompactionIdx(Log *log)
 {
-    return log->pages[0]->index;
+    return log->compaction_idx;
 }
 
 raft_index_t LogFirstIdx(Log *log)
@@ -714,31 +1736,50 @@ raft_index_t LogFirstIdx(Log *log)
 
 raft_index_t LogCurrentIdx(Log *log)
 {
-    LogPage *last = log->pages[1] ? log->pages[1] : log->pages[0];
-    return last->index;
+    return logLastPage(log)->index;
 }
 
 int LogSync(Log *log, bool sync)
 {
-    LogPage *curr = log->pages[1] ? log->pages[1] : log->pages[0];
+    LogPage *curr = logLastPage(log);
     uint64_t begin = RedisModule_MonotonicMicroseconds();
 
+    logSyncSealed(log, sync);
+
     if (pageSync(curr, sync) != RR_OK) {
         PANIC("pageFsync() failed for the file: %s", curr->filename);
     }
 
     uint64_t took = RedisModule_MonotonicMicroseconds() - begin;
-    log->fsync_index = LogCurrentIdx(log);
+    LogFsyncCompleted(log, LogCurrentIdx(log), took);
+
+    return RR_OK;
+}
+
+/* Update fsync() stats after an fsync() call that covers entries up to index
+ * and took the specified number of microseconds.
+ */
+void LogFsyncCompleted(Log *log, raft_index_t index, uint64_t took)
+{
+    uint64_t batch = index > log->fsync_index ? index - log->fsync_index : 0;
+    int bucket = 0;
+
+    while (bucket < LOG_FSYNC_BATCH_BUCKETS - 1 && batch > (1ull << bucket)) {
+        bucket++;
+    }
+
+    log->fsync_index = index;
     log->fsync_count++;
     log->fsync_total += took;
     log->fsync_max = MAX(took, log->fsync_max);
-
-    return RR_OK;
+    log->fsync_entries += batch;
+    log->fsync_batch_max = MAX(batch, log->fsync_batch_max);
+    log->fsync_batch_hist[bucket]++;
 }
 
 int LogFlush(Log *log)
 {
-    LogPage *curr = log->pages[1] ? log->pages[1] : log->pages[0];
+    LogPage *curr = logLastPage(log);
 
     if (FileFlush(&curr->file) != RR_OK) {
         PANIC("FileFlush() failed for the file: %s", curr->filename);
@@ -749,46 +1790,60 @@ int LogFlush(Log *log)
 
 int LogCurrentFd(Log *log)
 {
-    LogPage *curr = log->pages[1] ? log->pages[1] : log->pages[0];
+    LogPage *curr = logLastPage(log);
     return curr->file.fd;
 }
 
-raft_entry_t *LogGet(Log *log, raft_index_t idx)
+/* Returns the file of a sealed segment that is not fsync'd yet, or -1 if there
+ * are none. The caller must fsync() it before, or along with, the current
+ * segment and then close it.
+ */
+int LogTakeSealedFd(Log *log)
 {
-    raft_entry_t *ety = NULL;
-
-    if (log->pages[1]) {
-        ety = pageGet(log->pages[1], idx);
+    if (log->num_sealed_fds == 0) {
+        return -1;
     }
 
-    if (!ety) {
-        ety = pageGet(log->pages[0], idx);
+    int fd = log->sealed_fds[0];
+
+    log->num_sealed_fds--;
+    memmove(log->sealed_fds, log->sealed_fds + 1, log->num_sealed_fds * sizeof(int));
+
+    return fd;
+}
+
+raft_entry_t *LogGet(Log *log, raft_index_t idx)
+{
+    int i = logFindPage(log, idx);
+    if (i < 0) {
+        return NULL;
     }
 
-    return ety;
+    /* The last page is still appended to. Mapping it would mean remapping on
+     * nearly every read of a recent entry, so it is read with pread(). */
+    return pageGet(log->pages[i], idx, i < log->num_pages - 1);
 }
 
 int LogDelete(Log *log, raft_index_t from_idx)
 {
-    LogPage *p0 = log->pages[0];
-    LogPage *p1 = log->pages[1];
-
     if (LogCount(log) == 0 ||
         from_idx < LogFirstIdx(log) || from_idx > LogCurrentIdx(log)) {
         return RR_ERROR;
     }
 
-    pageDelete(p0, from_idx);
+    int i = logFindPage(log, from_idx);
+    RedisModule_Assert(i >= 0);
 
-    if (p1) {
-        pageDelete(p1, from_idx);
+    pageDelete(log->pages[i], from_idx);
 
-        /* If we've deleted an entry from the first page, we should delete the
-         * second page as the entries are not subsequent anymore. */
-        if (p0->index != p1->prev_log_idx) {
-            pageFree(p1, true);
-            log->pages[1] = NULL;
-        }
+    /* Compaction cannot complete if entries it covers are deleted */
+    if (from_idx <= log->compaction_idx) {
+        log->compaction_idx = 0;
+    }
+
+    /* Segments after the truncated one are deleted entirely */
+    if (i < log->num_pages - 1) {
+        logRemovePages(log, i + 1);
     }
 
     return RR_OK;
@@ -796,9 +1851,10 @@ int LogDelete(Log *log, raft_index_t from_idx)
 
 int LogReset(Log *log, raft_index_t index, raft_term_t term)
 {
-    if (log->pages[1]) {
-        pageFree(log->pages[1], true);
-        log->pages[1] = NULL;
+    log->compaction_idx = 0;
+
+    if (log->num_pages > 1) {
+        logRemovePages(log, 1);
     }
 
     log->pages[0]->index = index;
@@ -810,10 +1866,10 @@ int LogReset(Log *log, raft_index_t index, raft_term_t term)
 
 raft_index_t LogCount(Log *log)
 {
-    raft_index_t n = log->pages[0]->num_entries;
+    raft_index_t n = 0;
 
-    if (log->pages[1]) {
-        n += log->pages[1]->num_entries;
+    for (int i = 0; i < log->num_pages; i++) {
+        n += log->pages[i]->num_entries;
     }
 
     return n;
@@ -822,80 +1878,75 @@ raft_index_t LogCount(Log *log)
 void LogArchiveFiles(Log *log)
 {
     char buf[PATH_MAX + 100];
-    LogPage *p0 = log->pages[0];
-    LogPage *p1 = log->pages[1];
+    char filename[PATH_MAX];
 
-    unlink(p0->idxfilename);
-    safesnprintf(buf, sizeof(buf), "%s.%d.bak", p0->filename, p0->node_id);
-    rename(p0->filename, buf);
+    for (int i = 0; i < log->num_pages; i++) {
+        LogPage *p = log->pages[i];
 
-    if (p1) {
-        unlink(p1->idxfilename);
-        safesnprintf(buf, sizeof(buf), "%s.%d.bak", p1->filename, p1->node_id);
-        rename(p1->filename, buf);
+        unlink(p->idxfilename);
+        safesnprintf(buf, sizeof(buf), "%s.%d.bak", p->filename, p->node_id);
+        rename(p->filename, buf);
     }
+
+    manifestFileName(filename, sizeof(filename), log->filename);
+    safesnprintf(buf, sizeof(buf), "%s.%d.bak", filename, log->node_id);
+    rename(filename, buf);
 }
 
+/* Starts compaction of the entries up to the current index. A new segment is
+ * started, so the segments before it can be deleted once the snapshot is
+ * taken. */
 int LogCompactionBegin(Log *log)
 {
-    char tmp[PATH_MAX];
-    LogPage *p0 = log->pages[0];
-
-    if (log->pages[1]) {
+    if (log->compaction_idx) {
         return RR_OK;
     }
 
-    if (p0->num_entries <= 1) {
+    if (LogCount(log) <= 1) {
         return RR_ERROR;
     }
 
-    secondPageFileName(tmp, sizeof(tmp), p0->filename);
-
-    raft_index_t idx = p0->index;
-    raft_entry_t *e = pageGet(p0, idx);
-    raft_term_t term = e->term;
-    raft_entry_release(e);
-
-    if (pageSync(p0, true) != RR_OK) {
-        PANIC("pageFsync() failed for the file: %s", p0->filename);
-    }
-
-    log->pages[1] = pageCreate(tmp, p0->dbid, p0->node_id, term, idx);
-    if (!log->pages[1]) {
+    if (logAddSegment(log) != RR_OK) {
         return RR_ERROR;
     }
 
+    log->compaction_idx = logLastPage(log)->prev_log_idx;
+    logWriteManifest(log);
+
     return RR_OK;
 }
 
-/* Rename page1 over page0 */
+/* Deletes the segments that contain entries up to the compaction index */
 void LogCompactionEnd(Log *log)
 {
-    LogPage *p0 = log->pages[0];
-    LogPage *p1 = log->pages[1];
+    int count = 0;
 
-    RedisModule_Assert(p1);
+    RedisModule_Assert(log->compaction_idx);
 
-    if (rename(p1->idxfilename, p0->idxfilename) != 0) {
-        PANIC("rename() failed: %s", strerror(errno));
+    while (count < log->num_pages - 1 &&
+           log->pages[count]->index <= log->compaction_idx) {
+        count++;
     }
 
-    if (syncRename(p1->filename, p0->filename) != RR_OK) {
-        PANIC("rename() failed.");
-    }
+    LogPage **removed = RedisModule_Alloc(sizeof(*removed) * count);
+    memcpy(removed, log->pages, sizeof(*removed) * count);
+
+    log->num_pages -= count;
+    memmove(log->pages, log->pages + count, sizeof(*log->pages) * log->num_pages);
+    log->compaction_idx = 0;
 
-    strcpy(p1->filename, p0->filename);
-    strcpy(p1->idxfilename, p0->idxfilename);
+    logWriteManifest(log);
 
-    pageFree(p0, false);
+    for (int i = 0; i < count; i++) {
+        pageFree(removed[i], true);
+    }
 
-    log->pages[0] = p1;
-    log->pages[1] = NULL;
+    RedisModule_Free(removed);
 }
 
 bool LogCompactionStarted(Log *log)
 {
-    return log->pages[1] != NULL;
+    return log->compaction_idx != 0;
 }
 
 /*
@@ -931,6 +1982,13 @@ static void logImplReset(void *arg, raft_index_t index, raft_term_t term)
     RedisModule_Assert(index >= 1);
     LogReset(&rr->log, index - 1, term);
 
+    /* Entries before index are included in the snapshot, and an fsync() that
+     * is already requested is for the previous log file. */
+    rr->log.fsync_index = index - 1;
+    rr->fsync_requested_idx = index - 1;
+    rr->ae_ack.match_idx = MIN(rr->ae_ack.match_idx, index - 1);
+    rr->fsync_stale_id = rr->fsyncThread.requested_id;
+
     RAFTLOG_TRACE("Reset(index=%lu,term=%lu)", index, term);
 
     EntryCacheFree(rr->logcache);
@@ -944,6 +2002,13 @@ static int logImplAppend(void *arg, raft_entry_t *ety)
     RAFTLOG_TRACE("Append(id=%d, term=%lu) -> index %lu",
                   ety->id, ety->term, LogCurrentIdx(&rr->log) + 1);
 
+    /* Start a new segment once the current one reaches the size limit */
+    if (rr->config.log_segment_size &&
+        LogSegmentSize(&rr->log) >= rr->config.log_segment_size &&
+        LogAddSegment(&rr->log) != RR_OK) {
+        return -1;
+    }
+
     if (LogAppend(&rr->log, ety) != RR_OK) {
         return -1;
     }
@@ -971,6 +2036,13 @@ static int logImplPop(void *arg, raft_index_t from_idx)
     if (LogDelete(&rr->log, from_idx) != RR_OK) {
         return -1;
     }
+
+    /* An fsync() that is already requested may complete without covering the
+     * entries appended in place of the deleted ones. */
+    rr->log.fsync_index = MIN(rr->log.fsync_index, from_idx - 1);
+    rr->fsync_requested_idx = MIN(rr->fsync_requested_idx, from_idx - 1);
+    rr->ae_ack.match_idx = MIN(rr->ae_ack.match_idx, from_idx - 1);
+    rr->fsync_stale_id = rr->fsyncThread.requested_id;
     return 0;
 }
 
@@ -1036,7 +2108,20 @@ static raft_index_t logImplCount(void *arg)
 static int logImplSync(void *arg)
 {
     RedisRaftCtx *rr = arg;
+
+    /* fsync() will be requested from fsyncThread, see handleAppendEntries() */
+    if (rr->fsync_deferred) {
+        LogFlush(&rr->log);
+        return RR_OK;
+    }
+
+    uint64_t begin = RedisModule_MonotonicMicroseconds();
+
     LogSync(&rr->log, rr->config.log_fsync);
+    if (rr->config.log_fsync) {
+        LatencyRecord(&rr->latency, LATENCY_FSYNC, begin);
+    }
+
     return RR_OK;
 }
 
@@ -17,7 +17,10 @@
 
 extern raft_log_impl_t LogImpl;
 
+struct ThreadPool;
+
 typedef struct LogPage {
+    int version;                /* Page format version */
     char dbid[64];              /* DB unique ID, TODO: size should be RAFT_DBID_LEN + 1, will be fixed with RR-148 */
     raft_node_id_t node_id;     /* Node ID */
     raft_term_t prev_log_term;  /* Entry term that comes just before this page. */
@@ -29,16 +32,31 @@ typedef struct LogPage {
     File file;                  /* Log file */
     File idxfile;               /* Index file descriptor */
     long current_crc;           /* Current running crc value for the log file */
+    struct LogPageMap *map;     /* Read-only mapping of the log and index files */
+    long seq;                   /* Segment sequence number, 0 for the log file itself */
 } LogPage;
 
+/* fsync() batch size histogram buckets: <=1, <=2, <=4 ... <=256, >256 entries */
+#define LOG_FSYNC_BATCH_BUCKETS 10
+
 typedef struct Log {
-    char dbid[64];            /* DB unique ID, TODO: size should be RAFT_DBID_LEN + 1, will be fixed with RR-148 */
-    raft_node_id_t node_id;   /* Node ID */
-    LogPage *pages[2];        /* Log files. Second page will be created on log compaction */
-    raft_index_t fsync_index; /* Last entry index included in the latest fsync() call */
-    uint64_t fsync_count;     /* Count of fsync() calls */
-    uint64_t fsync_max;       /* Slowest fsync() call in microseconds */
-    uint64_t fsync_total;     /* Total time fsync() calls consumed in microseconds */
+    char dbid[64];               /* DB unique ID, TODO: size should be RAFT_DBID_LEN + 1, will be fixed with RR-148 */
+    raft_node_id_t node_id;      /* Node ID */
+    char filename[PATH_MAX];     /* Log file name, segment files are named after it */
+    LogPage **pages;             /* Log segments, ordered by index */
+    int num_pages;               /* Number of log segments */
+    long next_seq;               /* Sequence number of the next segment */
+    raft_index_t compaction_idx; /* Last index to be compacted, 0 if compaction is not started */
+    uint64_t bytes_written;      /* Total bytes appended to the log files */
+    int *sealed_fds;             /* Sealed segment files not fsync'd yet, see LogTakeSealedFd() */
+    int num_sealed_fds;          /* Number of sealed segment files not fsync'd yet */
+    raft_index_t fsync_index;    /* Last entry index included in the latest fsync() call */
+    uint64_t fsync_count;        /* Count of fsync() calls */
+    uint64_t fsync_max;          /* Slowest fsync() call in microseconds */
+    uint64_t fsync_total;        /* Total time fsync() calls consumed in microseconds */
+    uint64_t fsync_entries;      /* Total entries covered by fsync() calls */
+    uint64_t fsync_batch_max;    /* Largest number of entries covered by a single fsync() call */
+    uint64_t fsync_batch_hist[LOG_FSYNC_BATCH_BUCKETS]; /* fsync() batch size distribution */
 } Log;
 
 void LogInit(Log *log);
@@ -53,10 +71,12 @@ raft_node_id_t LogNodeId(Log *log);
 const char *LogDbid(Log *log);
 
 int LogAppend(Log *log, raft_entry_t *entry);
-int LogLoadEntries(Log *log);
+int LogLoadEntries(Log *log, struct ThreadPool *pool);
 int LogSync(Log *log, bool sync);
 int LogFlush(Log *log);
+void LogFsyncCompleted(Log *log, raft_index_t index, uint64_t took);
 int LogCurrentFd(Log *log);
+int LogTakeSealedFd(Log *log);
 raft_entry_t *LogGet(Log *log, raft_index_t idx);
 int LogDelete(Log *log, raft_index_t from_idx);
 int LogReset(Log *log, raft_index_t index, raft_term_t term);
@@ -66,6 +86,10 @@ raft_index_t LogCount(Log *log);
 raft_index_t LogFirstIdx(Log *log);
 raft_index_t LogCurrentIdx(Log *log);
 size_t LogFileSize(Log *log);
+size_t LogBytesAfter(Log *log, raft_index_t idx);
+size_t LogSegmentSize(Log *log);
+int LogSegmentCount(Log *log);
+int LogAddSegment(Log *log);
 void LogArchiveFiles(Log *log);
 
 int LogCompactionBegin(Log *log);
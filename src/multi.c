@@ -112,7 +112,7 @@ bool MultiHandleCommand(RedisRaftCtx *rr,
         /* We have to detect commands that are unsupported or must not be
          * intercepted and reject the transaction.
          */
-        unsigned int cmd_flags = CommandSpecTableGetAggregateFlags(rr->commands_spec_table, rr->subcommand_spec_tables, cmds, 0);
+        unsigned int cmd_flags = CommandSpecTableGetAggregateFlags(rr->commands_spec_table, cmds, 0);
 
         if (cmd_flags & CMD_SPEC_UNSUPPORTED) {
             RedisModule_ReplyWithError(ctx, "ERR not supported by RedisRaft");
@@ -134,9 +134,15 @@ bool MultiHandleCommand(RedisRaftCtx *rr,
         }
 
         /* "Multi Dry Run" - only check for ACL, not for OOM, as OOM is checked above */
-        enterRedisModuleCall();
-        RedisModuleCallReply *reply = RedisModule_Call(ctx, cmd_str, "DCEv", cmd->argv + 1, cmd->argc - 1);
-        exitRedisModuleCall();
+        RedisModuleCallReply *reply = NULL;
+        if (CommandCheckCached(rr, ctx, cmd, false)) {
+            rr->cmd_checks_cached++;
+        } else {
+            rr->cmd_checks_dry_run++;
+            enterRedisModuleCall();
+            reply = RedisModule_Call(ctx, cmd_str, "DCEv", cmd->argv + 1, cmd->argc - 1);
+            exitRedisModuleCall();
+        }
         if (reply != NULL) {
             RedisModule_ReplyWithCallReply(ctx, reply);
             RedisModule_FreeCallReply(reply);
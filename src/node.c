@@ -17,6 +17,107 @@
  * and reconnects).
  */
 
+/* Flow control limits for appendreq messages, see NodeUpdateFlowControl() */
+#define NODE_FLOW_MIN_WINDOW          1
+#define NODE_FLOW_MIN_BATCH_SIZE      (64 * 1024)
+#define NODE_FLOW_MIN_QUEUE_DELAY     5000     /* 5 ms */
+#define NODE_FLOW_MIN_RTT_LIFETIME    10000000 /* 10 seconds */
+
+/* Restart flow control from the minimum window and batch size, e.g. after a
+ * reconnect, as the path to the node may have changed.
+ */
+static void resetFlowControl(Node *node)
+{
+    node->ae_window = NODE_FLOW_MIN_WINDOW;
+    node->ae_batch_size = NODE_FLOW_MIN_BATCH_SIZE;
+    node->ae_window_acks = 0;
+    node->ae_window_limited = false;
+    node->ae_batch_limited = false;
+    node->ae_slow_start = true;
+    node->ae_min_rtt = 0;
+    node->ae_min_rtt_time = 0;
+    node->ae_backoff_time = 0;
+}
+
+/* Responses arrive in the order the requests were sent on a connection, so
+ * pending responses are kept in a ring buffer per connection, which only
+ * grows when it is full.
+ */
+static void queueInit(PendingResponseQueue *q)
+{
+    q->capacity = NODE_PENDING_RESPONSES_INITIAL;
+    q->buf = RedisModule_Alloc(q->capacity * sizeof(*q->buf));
+    q->head = 0;
+    q->count = 0;
+}
+
+static void queueClear(PendingResponseQueue *q)
+{
+    q->head = 0;
+    q->count = 0;
+}
+
+/* Returns the oldest pending response, or NULL if there is none. */
+static PendingResponse *queueHead(PendingResponseQueue *q)
+{
+    if (!q->count) {
+        return NULL;
+    }
+
+    return &q->buf[q->head];
+}
+
+/* Doubles the capacity of the ring buffer, moving the pending responses to the
+ * beginning of the new buffer. */
+static void queueGrow(PendingResponseQueue *q)
+{
+    unsigned long capacity = q->capacity * 2;
+    PendingResponse *buf = RedisModule_Alloc(capacity * sizeof(*buf));
+
+    for (unsigned long i = 0; i < q->count; i++) {
+        buf[i] = q->buf[(q->head + i) & (q->capacity - 1)];
+    }
+
+    RedisModule_Free(q->buf);
+    q->buf = buf;
+    q->capacity = capacity;
+    q->head = 0;
+}
+
+static PendingResponse *queuePush(PendingResponseQueue *q, bool proxy, size_t bytes)
+{
+    static int response_id = 0;
+
+    if (q->count == q->capacity) {
+        queueGrow(q);
+    }
+
+    PendingResponse *resp = &q->buf[(q->head + q->count) & (q->capacity - 1)];
+    *resp = (PendingResponse){
+        .proxy = proxy,
+        .request_time = RedisModule_Milliseconds(),
+        .sent_time = RedisModule_MonotonicMicroseconds(),
+        .bytes = bytes,
+        .id = ++response_id,
+    };
+    q->count++;
+
+    return resp;
+}
+
+/* Removes the oldest pending response. The returned pointer is valid until
+ * the next queuePush(). */
+static PendingResponse *queuePop(PendingResponseQueue *q)
+{
+    PendingResponse *resp = queueHead(q);
+    RedisModule_Assert(resp != NULL);
+
+    q->head = (q->head + 1) & (q->capacity - 1);
+    q->count--;
+
+    return resp;
+}
+
 /* Clear all pending responses and metrics from the node. We have to do that
  * when reconnecting.
  */
@@ -24,13 +125,48 @@ static void clearPendingResponses(Node *node)
 {
     node->pending_raft_response_num = 0;
     node->pending_proxy_response_num = 0;
+    node->pending_raft_bytes = 0;
+    queueClear(&node->pending);
+}
 
-    struct sc_list *tmp, *it;
+/* Reply callback for the capability probe. COMMAND INFO replies with a nil
+ * element for commands the node doesn't know.
+ */
+static void handleCommandProbeResponse(redisAsyncContext *c, void *r, void *privdata)
+{
+    Node *node = privdata;
+    redisReply *reply = r;
 
-    sc_list_foreach_safe (&node->pending_responses, tmp, it) {
-        PendingResponse *resp = sc_list_entry(it, PendingResponse, entries);
-        sc_list_del(&node->pending_responses, it);
-        RedisModule_Free(resp);
+    if (!reply) {
+        return;
+    }
+
+    if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 2) {
+        NODE_LOG_NOTICE(node, "invalid COMMAND INFO reply, using RAFT.AE");
+        return;
+    }
+
+    node->ae_text_only = reply->element[0]->type != REDIS_REPLY_ARRAY;
+    node->ae_ack = reply->element[1]->type == REDIS_REPLY_ARRAY;
+
+    if (node->ae_text_only) {
+        NODE_LOG_NOTICE(node, "RAFT.AEBIN not supported, using RAFT.AE");
+    }
+
+    NODE_TRACE(node, "Node supports: RAFT.AEBIN=%d, RAFT.AEACK=%d",
+               !node->ae_text_only, node->ae_ack);
+}
+
+/* Asks the node which optional commands it supports. Older versions handle
+ * an unknown RAFT.AEBIN as a user command, which may be redirected, rejected
+ * with an arbitrary error or even proxied and appended to the log, so we
+ * can't rely on the reply to RAFT.AEBIN itself.
+ */
+static void probeNodeCommands(Node *node)
+{
+    if (redisAsyncCommand(ConnGetRedisCtx(node->conn), handleCommandProbeResponse,
+                          node, "COMMAND INFO RAFT.AEBIN RAFT.AEACK") != REDIS_OK) {
+        NODE_TRACE(node, "failed to probe node commands");
     }
 }
 
@@ -41,10 +177,28 @@ static void handleNodeConnect(Connection *conn)
 
     if (ConnIsConnected(conn)) {
         clearPendingResponses(node);
+        resetFlowControl(node);
+
+        /* Node might have been upgraded or downgraded, use RAFT.AE until it
+         * confirms it supports RAFT.AEBIN. */
+        node->ae_text_only = true;
+        node->ae_ack = false;
+        probeNodeCommands(node);
         NODE_TRACE(node, "Node connection established.");
     }
 }
 
+/* Priority connection connect callback */
+static void handlePriorityConnect(Connection *conn)
+{
+    Node *node = (Node *) ConnGetPrivateData(conn);
+
+    if (ConnIsConnected(conn)) {
+        queueClear(&node->priority_pending);
+        NODE_TRACE(node, "Node priority connection established.");
+    }
+}
+
 /* Idle callback: when we have a connection associated with an active node,
  * we initiate ConnConnect().
  */
@@ -55,11 +209,15 @@ static void nodeIdleCallback(Connection *conn)
 
     raft_node_t *raft_node = raft_get_node(rr->raft, node->id);
     if (raft_node != NULL && raft_node_is_active(raft_node)) {
-        ConnConnect(node->conn, &node->addr, handleNodeConnect);
+        if (conn == node->priority_conn) {
+            ConnConnect(conn, &node->addr, handlePriorityConnect);
+        } else {
+            ConnConnect(conn, &node->addr, handleNodeConnect);
+        }
     }
 }
 
-/* Free node object and remove it from the nodes linked list */
+/* Free node object */
 static void NodeFree(Node *node)
 {
     if (!node) {
@@ -67,20 +225,46 @@ static void NodeFree(Node *node)
     }
 
     clearPendingResponses(node);
-
-    sc_list_del(&node->rr->nodes, &node->entries);
+    RedisModule_Free(node->pending.buf);
+    RedisModule_Free(node->priority_pending.buf);
     RedisModule_Free(node);
 }
 
+/* Drops a connection's reference to the node. Reply callbacks of a connection
+ * are called before the connection is freed, so the node outlives them.
+ */
+static void nodeRelease(Node *node)
+{
+    RedisModule_Assert(node->refcount > 0);
+
+    if (--node->refcount == 0) {
+        NodeFree(node);
+    }
+}
+
 /* hiredis free callback */
 static void nodeFreeCallback(void *privdata)
 {
     Node *node = (Node *) privdata;
-    NodeFree(node);
+
+    node->conn = NULL;
+    nodeRelease(node);
 }
 
-/* Create a new node object, put it in the nodes list and create a connection
- * object for it.
+/* hiredis free callback of the priority connection */
+static void nodePriorityFreeCallback(void *privdata)
+{
+    Node *node = (Node *) privdata;
+
+    node->priority_conn = NULL;
+    nodeRelease(node);
+}
+
+/* Create a new node object, put it in the nodes list and create the connection
+ * objects for it.
+ *
+ * Besides the main connection, a priority connection is used for messages that
+ * keep leadership stable, see Node.priority_conn.
  *
  * Note that at this point no actual connection is made. The idle callback
  * fires at a later stage and handles connection setup.
@@ -90,42 +274,79 @@ Node *NodeCreate(RedisRaftCtx *rr, int id, const NodeAddr *addr)
 {
     Node *node = RedisModule_Calloc(1, sizeof(Node));
 
-    sc_list_init(&node->pending_responses);
     sc_list_init(&node->entries);
 
+    queueInit(&node->pending);
+    queueInit(&node->priority_pending);
+
     node->id = id;
     node->rr = rr;
 
     strcpy(node->addr.host, addr->host);
     node->addr.port = addr->port;
 
+    resetFlowControl(node);
+
     sc_list_add_head(&rr->nodes, &node->entries);
 
+    /* Each connection holds a reference, see nodeRelease() */
+    node->refcount = 2;
     node->conn = ConnCreate(node->rr, node, nodeIdleCallback, nodeFreeCallback,
                             rr->config.cluster_user, rr->config.cluster_password);
+    node->priority_conn = ConnCreate(node->rr, node, nodeIdleCallback, nodePriorityFreeCallback,
+                                     rr->config.cluster_user, rr->config.cluster_password);
     return node;
 }
 
+/* Remove a node that was removed from the cluster from the nodes list and
+ * terminate its connections. The node is freed once both connections are
+ * freed.
+ */
+void NodeTerminate(Node *node)
+{
+    sc_list_del(&node->rr->nodes, &node->entries);
+
+    ConnAsyncTerminate(node->priority_conn);
+    ConnAsyncTerminate(node->conn);
+}
+
 /* Track a new pending response for a request that was sent to the node.
  * This is used to track connection liveness and decide when it should be
- * dropped.
+ * dropped. `bytes` is the payload size of the request, see
+ * Node.pending_raft_bytes.
  */
-void NodeAddPendingResponse(Node *node, bool proxy)
+/* Returns true if all other nodes are known to apply RAFT_LOGTYPE_BATCH
+ * entries. Older versions skip them silently, so batching is only enabled
+ * once each node has been probed. Batch entries predate RAFT.AEACK, so nodes
+ * that support RAFT.AEACK apply them too.
+ */
+bool NodesSupportBatchEntries(RedisRaftCtx *rr)
 {
-    static int response_id = 0;
+    for (int i = 0; i < raft_get_num_nodes(rr->raft); i++) {
+        raft_node_t *raft_node = raft_get_node_from_idx(rr->raft, i);
+        if (raft_node_get_id(raft_node) == raft_get_nodeid(rr->raft)) {
+            continue;
+        }
 
-    PendingResponse *resp = RedisModule_Calloc(1, sizeof(PendingResponse));
-    resp->proxy = proxy;
-    resp->request_time = RedisModule_Milliseconds();
-    resp->id = ++response_id;
-    sc_list_init(&resp->entries);
+        Node *node = raft_node_get_udata(raft_node);
+        if (!node || !node->ae_ack) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void NodeAddPendingResponse(Node *node, bool proxy, size_t bytes)
+{
+    PendingResponse *resp = queuePush(&node->pending, proxy, bytes);
 
     if (proxy) {
         node->pending_proxy_response_num++;
     } else {
         node->pending_raft_response_num++;
+        node->pending_raft_bytes += bytes;
     }
-    sc_list_add_tail(&node->pending_responses, &resp->entries);
 
     NODE_TRACE(node, "NodeAddPendingResponse: id=%d, type=%s, request_time=%lld",
                resp->id, proxy ? "proxy" : "raft", resp->request_time);
@@ -133,23 +354,99 @@ void NodeAddPendingResponse(Node *node, bool proxy)
 
 /* Acknowledge a response that has been received and remove it from the
  * node's list of pending responses.
+ *
+ * Returns the time the request was sent, see PendingResponse.sent_time.
  */
-void NodeDismissPendingResponse(Node *node)
+uint64_t NodeDismissPendingResponse(Node *node)
 {
-    struct sc_list *elem = sc_list_pop_head(&node->pending_responses);
-    PendingResponse *resp = sc_list_entry(elem, PendingResponse, entries);
+    PendingResponse *resp = queuePop(&node->pending);
 
     if (resp->proxy) {
         node->pending_proxy_response_num--;
     } else {
         node->pending_raft_response_num--;
+        node->pending_raft_bytes -= resp->bytes;
+
+        uint64_t rtt = RedisModule_MonotonicMicroseconds() - resp->sent_time;
+        node->rtt[node->rtt_count++ % NODE_RTT_SAMPLES] = rtt;
     }
 
     NODE_TRACE(node, "NodeDismissPendingResponse: id=%d, type=%s, latency=%lld",
                resp->id, resp->proxy ? "proxy" : "raft",
                RedisModule_Milliseconds() - resp->request_time);
 
-    RedisModule_Free(resp);
+    return resp->sent_time;
+}
+
+/* Same as NodeAddPendingResponse(), for a request sent over the priority
+ * connection. These are not included in the pending response counters.
+ */
+void NodeAddPriorityResponse(Node *node)
+{
+    PendingResponse *resp = queuePush(&node->priority_pending, false, 0);
+
+    NODE_TRACE(node, "NodeAddPriorityResponse: id=%d, request_time=%lld",
+               resp->id, resp->request_time);
+}
+
+/* Same as NodeDismissPendingResponse(), for a response received over the
+ * priority connection.
+ */
+uint64_t NodeDismissPriorityResponse(Node *node)
+{
+    PendingResponse *resp = queuePop(&node->priority_pending);
+
+    NODE_TRACE(node, "NodeDismissPriorityResponse: id=%d, latency=%lld",
+               resp->id, RedisModule_Milliseconds() - resp->request_time);
+
+    return resp->sent_time;
+}
+
+/* Update the entries per appendreq distribution after sending an appendreq
+ * message. Heartbeats, i.e. messages without entries, are not included.
+ */
+void NodeRecordAppendEntries(Node *node, long n_entries)
+{
+    int bucket = 0;
+
+    if (n_entries <= 0) {
+        return;
+    }
+
+    while (bucket < NODE_AE_BATCH_BUCKETS - 1 && n_entries > (1l << bucket)) {
+        bucket++;
+    }
+
+    node->ae_sent++;
+    node->ae_entries_sent += n_entries;
+    node->ae_batch_hist[bucket]++;
+}
+
+static int compareRtt(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Returns the percentile of the recent round-trip times of Raft requests sent
+ * to the node, in microseconds. Returns 0 if there is none.
+ */
+uint64_t NodeRttPercentile(Node *node, double percentile)
+{
+    uint64_t samples[NODE_RTT_SAMPLES];
+    size_t count = MIN(node->rtt_count, NODE_RTT_SAMPLES);
+
+    if (count == 0) {
+        return 0;
+    }
+
+    memcpy(samples, node->rtt, count * sizeof(*samples));
+    qsort(samples, count, sizeof(*samples), compareRtt);
+
+    size_t i = (size_t) ((double) count * percentile / 100.0);
+    return samples[MIN(i, count - 1)];
 }
 
 /* Gets called periodically to look for nodes with commands that should time out
@@ -165,10 +462,17 @@ void HandleNodeStates(RedisRaftCtx *rr)
 
     sc_list_foreach_safe (&rr->nodes, tmp, it) {
         Node *node = sc_list_entry(it, Node, entries);
-        struct sc_list *head = sc_list_head(&node->pending_responses);
+        PendingResponse *resp = queueHead(&node->pending);
+        PendingResponse *prio = queueHead(&node->priority_pending);
+
+        if (ConnIsConnected(node->priority_conn) && prio != NULL &&
+            rr->config.response_timeout &&
+            prio->request_time + rr->config.response_timeout < RedisModule_Milliseconds()) {
+            NODE_TRACE(node, "Pending priority response timeout expired, reconnecting.");
+            ConnMarkDisconnected(node->priority_conn);
+        }
 
-        if (ConnIsConnected(node->conn) && head != NULL) {
-            PendingResponse *resp = sc_list_entry(head, PendingResponse, entries);
+        if (ConnIsConnected(node->conn) && resp != NULL) {
             long timeout;
 
             if (raft_is_leader(rr->raft)) {
@@ -185,3 +489,75 @@ void HandleNodeStates(RedisRaftCtx *rr)
         }
     }
 }
+
+/* Returns the max number of in-flight Raft messages for the node, capped by
+ * append-req-max-count. */
+long NodeAppendWindow(Node *node)
+{
+    return MIN(node->ae_window, node->rr->config.append_req_max_count);
+}
+
+/* Returns the max appendreq message size for the node, capped by
+ * append-req-max-size. */
+long long NodeAppendBatchSize(Node *node)
+{
+    return MIN(node->ae_batch_size, node->rr->config.append_req_max_size);
+}
+
+/* Adapts the appendreq window and batch size of the node after a reply to an
+ * appendreq message sent at `sent_time`.
+ *
+ * This is an AIMD controller driven by queueing delay, as messages are never
+ * lost over TCP. The lowest round-trip time seen recently is taken as the
+ * base round-trip time of the path. While replies arrive within twice the base
+ * round-trip time (or NODE_FLOW_MIN_QUEUE_DELAY, for nodes on the same rack),
+ * the window and batch size grow, if they limited the messages sent to the
+ * node. Starting from the minimum, they double every round-trip until queueing
+ * is first detected, and grow linearly afterwards. When replies are delayed,
+ * both are halved, at most once per round-trip.
+ *
+ * append-req-max-count and append-req-max-size cap the values, so a node
+ * catching up fills the link, while the latency of the messages sent in
+ * steady state is kept close to the base round-trip time.
+ */
+void NodeUpdateFlowControl(Node *node, uint64_t sent_time)
+{
+    RedisRaftConfig *c = &node->rr->config;
+    uint64_t now = RedisModule_MonotonicMicroseconds();
+    uint64_t rtt = now > sent_time ? now - sent_time : 0;
+
+    /* Expire the base round-trip time, it might have increased */
+    if (!node->ae_min_rtt_time || rtt <= node->ae_min_rtt ||
+        now - node->ae_min_rtt_time > NODE_FLOW_MIN_RTT_LIFETIME) {
+        node->ae_min_rtt = rtt;
+        node->ae_min_rtt_time = now;
+    }
+
+    uint64_t queue_delay = rtt - node->ae_min_rtt;
+    if (queue_delay > MAX(node->ae_min_rtt, NODE_FLOW_MIN_QUEUE_DELAY)) {
+        /* Messages sent before the last decrease don't reflect it yet */
+        if (sent_time > node->ae_backoff_time) {
+            node->ae_window = MAX(NodeAppendWindow(node) / 2, NODE_FLOW_MIN_WINDOW);
+            node->ae_batch_size = MAX(NodeAppendBatchSize(node) / 2, NODE_FLOW_MIN_BATCH_SIZE);
+            node->ae_window_acks = 0;
+            node->ae_slow_start = false;
+            node->ae_backoff_time = now;
+        }
+        return;
+    }
+
+    if (node->ae_batch_limited) {
+        node->ae_batch_limited = false;
+        node->ae_batch_size += node->ae_slow_start ? node->ae_batch_size : NODE_FLOW_MIN_BATCH_SIZE;
+        node->ae_batch_size = MIN(node->ae_batch_size, c->append_req_max_size);
+    }
+
+    /* Increase the window by one per reply in slow start, doubling it every
+     * round-trip, and by one per round-trip afterwards. */
+    if (node->ae_window_limited &&
+        (node->ae_slow_start || ++node->ae_window_acks >= (unsigned long) node->ae_window)) {
+        node->ae_window_limited = false;
+        node->ae_window_acks = 0;
+        node->ae_window = MIN(node->ae_window + 1, c->append_req_max_count);
+    }
+}
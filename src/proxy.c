@@ -95,9 +95,122 @@ RRStatus ProxyCommand(RedisRaftCtx *rr, RedisModuleCtx *ctx,
         return RR_ERROR;
     }
 
-    NodeAddPendingResponse(leader, true);
+    NodeAddPendingResponse(leader, true, 0);
     rr->proxy_reqs++;
     rr->proxy_outstanding_reqs++;
 
     return RR_OK;
 }
+
+/* A read-only command executed on a follower, waiting for the log to be
+ * applied up to its read index (stored in req->raft_idx).
+ */
+typedef struct FollowerRead {
+    RaftReq *req;
+    long long request_time;
+    struct sc_list entries;
+} FollowerRead;
+
+static void executeFollowerRead(RedisRaftCtx *rr, RaftReq *req)
+{
+    if (!RedisModule_BlockedClientDisconnected(req->ctx)) {
+        RaftExecuteCommandArray(rr, req, &req->r.redis.cmds);
+        rr->follower_reads++;
+    }
+
+    RaftReqFree(req);
+}
+
+static void handleReadIndexResponse(redisAsyncContext *c, void *r, void *privdata)
+{
+    RedisRaftCtx *rr = &redis_raft;
+    RaftReq *req = privdata;
+    redisReply *reply = r;
+
+    rr->proxy_outstanding_reqs--;
+    NodeDismissPendingResponse(req->r.redis.proxy_node);
+
+    if (!reply) {
+        ConnMarkDisconnected(req->r.redis.proxy_node->conn);
+        RedisModule_ReplyWithError(req->ctx, "TIMEOUT no reply from leader");
+        rr->proxy_failed_responses++;
+        goto exit;
+    }
+
+    if (reply->type != REDIS_REPLY_INTEGER) {
+        if (reply->type != REDIS_REPLY_ERROR ||
+            hiredisReplyToModule(reply, req->ctx) != RR_OK) {
+            RedisModule_ReplyWithError(req->ctx, "ERR bad reply from leader");
+        }
+        goto exit;
+    }
+
+    req->raft_idx = reply->integer;
+    if (raft_get_last_applied_idx(rr->raft) >= req->raft_idx) {
+        executeFollowerRead(rr, req);
+        return;
+    }
+
+    FollowerRead *fr = RedisModule_Calloc(1, sizeof(*fr));
+    fr->req = req;
+    fr->request_time = RedisModule_Milliseconds();
+    sc_list_init(&fr->entries);
+    sc_list_add_tail(&rr->follower_read_list, &fr->entries);
+    return;
+
+exit:
+    RaftReqFree(req);
+}
+
+/* Request a read index from the leader, and execute the read-only commands
+ * locally once the log is applied up to it.
+ */
+RRStatus FollowerReadCommand(RedisRaftCtx *rr, RedisModuleCtx *ctx,
+                             RaftRedisCommandArray *cmds, Node *leader)
+{
+    redisAsyncContext *rc;
+
+    if (!ConnIsConnected(leader->conn) || !(rc = ConnGetRedisCtx(leader->conn))) {
+        return RR_ERROR;
+    }
+
+    RaftReq *req = RaftReqInit(ctx, RR_REDISCOMMAND);
+    req->r.redis.proxy_node = leader;
+
+    if (redisAsyncCommand(rc, handleReadIndexResponse, req, "RAFT.READINDEX") != REDIS_OK) {
+        RaftReqFree(req);
+        return RR_ERROR;
+    }
+    RaftRedisCommandArrayMove(&req->r.redis.cmds, cmds);
+
+    NodeAddPendingResponse(leader, true, 0);
+    rr->proxy_outstanding_reqs++;
+
+    return RR_OK;
+}
+
+/* Execute follower reads whose read index has been applied, and fail the ones
+ * that have been waiting for longer than proxy-response-timeout.
+ */
+void HandleFollowerReads(RedisRaftCtx *rr)
+{
+    struct sc_list *it, *tmp;
+    raft_index_t applied = raft_get_last_applied_idx(rr->raft);
+    long long now = RedisModule_Milliseconds();
+
+    sc_list_foreach_safe (&rr->follower_read_list, tmp, it) {
+        FollowerRead *fr = sc_list_entry(it, FollowerRead, entries);
+
+        if (fr->req->raft_idx <= applied) {
+            executeFollowerRead(rr, fr->req);
+        } else if (now - fr->request_time > rr->config.proxy_response_timeout) {
+            RedisModule_ReplyWithError(fr->req->ctx, "TIMEOUT read index not applied");
+            RaftReqFree(fr->req);
+        } else {
+            continue;
+        }
+
+        sc_list_del(&rr->follower_read_list, &fr->entries);
+        RedisModule_Free(fr);
+    }
+}
@@ -31,6 +31,7 @@ const char *RaftReqTypeStr[] = {
     [RR_DELETE_UNLOCK_KEYS] = "RR_DELETE_UNLOCK_KEYS",
     [RR_END_SESSION] = "RR_END_SESSION",
     [RR_CLIENT_UNBLOCK] = "RR_CLIENT_UNBLOCK",
+    [RR_WRITE_BATCH] = "RR_WRITE_BATCH",
 };
 
 /* Forward declarations */
@@ -76,7 +77,12 @@ void entryFreeAttachedRaftReq(raft_entry_t *ety)
 {
     RaftReq *req = entryDetachRaftReq(&redis_raft, ety);
 
-    if (req) {
+    if (req && req->type == RR_WRITE_BATCH) {
+        for (int i = 0; i < req->r.batch.len; i++) {
+            RedisModule_ReplyWithError(req->r.batch.reqs[i]->ctx, "TIMEOUT not committed yet");
+        }
+        RaftReqFree(req);
+    } else if (req) {
         RedisModule_ReplyWithError(req->ctx, "TIMEOUT not committed yet");
         RaftReqFree(req);
     }
@@ -98,6 +104,44 @@ void entryAttachRaftReq(RedisRaftCtx *rr, raft_entry_t *entry, RaftReq *req)
     rr->client_attached_entries++;
 }
 
+/* A Raft log entry with a payload that references a retained RedisModuleString
+ * (e.g. a RAFT.AE argument), rather than a private copy of it.
+ */
+typedef struct StringRefEntry {
+    raft_entry_t entry;
+    RedisModuleString *str;
+} StringRefEntry;
+
+static void entryFreeStringRef(raft_entry_t *ety)
+{
+    StringRefEntry *ref = (StringRefEntry *) ety;
+
+    RedisModule_FreeString(NULL, ref->str);
+    RedisModule_Free(ref);
+}
+
+/* Create a Raft log entry with the payload of data/len, which must point into
+ * the memory of str. The string is retained until the entry is freed. The log
+ * cache only accounts for the payload, so if str holds much more than that, or
+ * is shared by several entries, callers should set data_shared/shared_size.
+ *
+ * Entries must be released on the main thread.
+ */
+raft_entry_t *entryNewFromString(RedisModuleString *str, const char *data, unsigned int len)
+{
+    StringRefEntry *ref = RedisModule_Calloc(1, sizeof(*ref));
+
+    RedisModule_RetainString(NULL, str);
+    ref->str = str;
+
+    ref->entry.refs = 1;
+    ref->entry.data = (char *) data;
+    ref->entry.data_len = len;
+    ref->entry.free_func = entryFreeStringRef;
+
+    return &ref->entry;
+}
+
 /* ----------------------------- Log Execution ------------------------------ */
 
 static bool isSharding(RedisRaftCtx *rr)
@@ -695,10 +739,13 @@ static void timeoutBlockedCommand(RedisRaftCtx *rr, raft_entry_t *entry, RaftReq
  * 1) Execution of a raft entry received from another node.
  * 2) Execution of a locally initiated command.
  */
-static void executeLogEntry(RedisRaftCtx *rr, raft_entry_t *entry, raft_index_t entry_idx, RaftReq *req)
+/* Execute a serialized command array of a log entry. If req is not NULL, the
+ * command array of the request is executed instead of deserializing it.
+ */
+static void executeCommandArray(RedisRaftCtx *rr, raft_index_t entry_idx,
+                                raft_session_t session, const char *data,
+                                size_t data_len, RaftReq *req)
 {
-    RedisModule_Assert(entry->type == RAFT_LOGTYPE_NORMAL);
-
     RaftRedisCommandArray tmp = {0};
     RaftRedisCommandArray *cmds;
 
@@ -706,12 +753,10 @@ static void executeLogEntry(RedisRaftCtx *rr, raft_entry_t *entry, raft_index_t
     if (req) {
         cmds = &req->r.redis.cmds;
     } else {
-        if (RaftRedisCommandArrayDeserialize(&tmp,
-                                             entry->data,
-                                             entry->data_len) != RR_OK) {
+        if (RaftRedisCommandArrayDeserializeArena(&tmp, data, data_len, &rr->apply_arena) != RR_OK) {
             PANIC("Invalid Raft entry");
         }
-        tmp.client_id = entry->session;
+        tmp.client_id = session;
         cmds = &tmp;
     }
 
@@ -720,6 +765,7 @@ static void executeLogEntry(RedisRaftCtx *rr, raft_entry_t *entry, raft_index_t
     if (reply == NULL) {
         /* setup for req/non req nodes needs to mirror teardown below */
         if (req) { /*  node instance where client issued command */
+            LatencyRecord(&rr->latency, LATENCY_TOTAL, req->start_time);
             RaftReqFree(req);
         } else {
             RaftRedisCommandArrayFree(cmds);
@@ -727,7 +773,7 @@ static void executeLogEntry(RedisRaftCtx *rr, raft_entry_t *entry, raft_index_t
     } else {
         size_t cmdstr_len;
         const char *cmdstr = RedisModule_StringPtrLen(cmds->commands[0]->argv[0], &cmdstr_len);
-        BlockedCommand *bc = allocBlockedCommand(cmdstr, entry_idx, entry->session, entry->data, entry->data_len, req, reply);
+        BlockedCommand *bc = allocBlockedCommand(cmdstr, entry_idx, session, data, data_len, req, reply);
         addBlockedCommand(bc);
         RedisModule_CallReplyPromiseSetUnblockHandler(reply, handleUnblock, bc);
         if (req) {
@@ -737,6 +783,15 @@ static void executeLogEntry(RedisRaftCtx *rr, raft_entry_t *entry, raft_index_t
             RaftRedisCommandArrayFree(cmds);
         }
     }
+}
+
+static void executeLogEntry(RedisRaftCtx *rr, raft_entry_t *entry, raft_index_t entry_idx, RaftReq *req)
+{
+    RedisModule_Assert(entry->type == RAFT_LOGTYPE_NORMAL);
+
+    executeCommandArray(rr, entry_idx, entry->session, entry->data,
+                        entry->data_len, req);
+    ArenaReset(&rr->apply_arena);
 
     /* Update snapshot info in Redis dataset. This must be done now so it's
      * always consistent with what we applied and we never end up applying
@@ -746,6 +801,46 @@ static void executeLogEntry(RedisRaftCtx *rr, raft_entry_t *entry, raft_index_t
     rr->snapshot_info.last_applied_idx = entry_idx;
 }
 
+/* Execute the command arrays of a batch entry in order. On the node that
+ * created the entry, each reply goes to the request of the corresponding
+ * client. */
+static void executeBatchEntry(RedisRaftCtx *rr, raft_entry_t *entry, raft_index_t entry_idx, RaftReq *batch)
+{
+    RedisModule_Assert(entry->type == RAFT_LOGTYPE_BATCH);
+
+    size_t count;
+    RaftRedisCommandBatchItem *items;
+
+    size_t data_len = entry->data_len;
+    const char *data = RaftRedisDecompressPayload(entry->data, &data_len, &rr->apply_arena);
+    if (!data || !(items = RaftRedisCommandBatchDeserialize(data, data_len, &count))) {
+        PANIC("Invalid Raft entry");
+    }
+    RedisModule_Assert(!batch || (size_t) batch->r.batch.len == count);
+
+    for (size_t i = 0; i < count; i++) {
+        RaftReq *req = NULL;
+
+        if (batch) {
+            req = batch->r.batch.reqs[i];
+            batch->r.batch.reqs[i] = NULL;
+        }
+
+        executeCommandArray(rr, entry_idx, items[i].session, items[i].data,
+                            items[i].data_len, req);
+    }
+
+    RedisModule_Free(items);
+    ArenaReset(&rr->apply_arena);
+    if (batch) {
+        batch->r.batch.len = 0;
+        RaftReqFree(batch);
+    }
+
+    rr->snapshot_info.last_applied_term = entry->term;
+    rr->snapshot_info.last_applied_idx = entry_idx;
+}
+
 static void raftSendNodeShutdown(raft_node_t *raft_node)
 {
     if (!raft_node) {
@@ -778,10 +873,10 @@ static void handleRequestVoteResponse(redisAsyncContext *c, void *r, void *privd
 
     redisReply *reply = r;
 
-    NodeDismissPendingResponse(node);
+    NodeDismissPriorityResponse(node);
     if (!reply) {
         NODE_LOG_DEBUG(node, "RAFT.REQUESTVOTE failed: connection dropped.");
-        ConnMarkDisconnected(node->conn);
+        ConnMarkDisconnected(node->priority_conn);
         return;
     }
     if (reply->type == REDIS_REPLY_ERROR) {
@@ -820,18 +915,21 @@ static void handleRequestVoteResponse(redisAsyncContext *c, void *r, void *privd
     }
 }
 
+/* Votes are sent over the priority connection, so they are not delayed by
+ * replication traffic. */
 static int raftSendRequestVote(raft_server_t *raft, void *user_data,
                                raft_node_t *raft_node, raft_requestvote_req_t *msg)
 {
     Node *node = (Node *) raft_node_get_udata(raft_node);
 
-    if (!ConnIsConnected(node->conn)) {
-        NODE_TRACE(node, "not connected, state=%s", ConnGetStateStr(node->conn));
+    if (!ConnIsConnected(node->priority_conn)) {
+        NODE_TRACE(node, "priority connection not connected, state=%s",
+                   ConnGetStateStr(node->priority_conn));
         return 0;
     }
 
     /* RAFT.REQUESTVOTE <target_node_id> <src_node_id> <prevote>:<term>:<candidate_id>:<last_log_idx>:<last_log_term> */
-    if (redisAsyncCommand(ConnGetRedisCtx(node->conn), handleRequestVoteResponse,
+    if (redisAsyncCommand(ConnGetRedisCtx(node->priority_conn), handleRequestVoteResponse,
                           node, "RAFT.REQUESTVOTE %d %d %d:%ld:%d:%ld:%ld",
                           raft_node_get_id(raft_node),
                           raft_get_nodeid(raft),
@@ -842,7 +940,7 @@ static int raftSendRequestVote(raft_server_t *raft, void *user_data,
                           msg->last_log_term) != REDIS_OK) {
         NODE_TRACE(node, "failed requestvote");
     } else {
-        NodeAddPendingResponse(node, false);
+        NodeAddPriorityResponse(node);
     }
 
     return 0;
@@ -850,12 +948,13 @@ static int raftSendRequestVote(raft_server_t *raft, void *user_data,
 
 /* ------------------------------------ AppendEntries ------------------------------------ */
 
+static void handleAppendEntriesReply(Node *node, redisReply *reply, uint64_t sent_time);
+
 static void handleAppendEntriesResponse(redisAsyncContext *c, void *r, void *privdata)
 {
     Node *node = privdata;
-    RedisRaftCtx *rr = node->rr;
 
-    NodeDismissPendingResponse(node);
+    uint64_t sent_time = NodeDismissPendingResponse(node);
 
     redisReply *reply = r;
     if (!reply) {
@@ -869,6 +968,48 @@ static void handleAppendEntriesResponse(redisAsyncContext *c, void *r, void *pri
         return;
     }
 
+    handleAppendEntriesReply(node, reply, sent_time);
+}
+
+/* Reply callback for RAFT.AEBIN. Support is negotiated when connecting, see
+ * probeNodeCommands(). Still, if the node doesn't know the command or our
+ * encoding version, e.g. after it was downgraded, or the command is not
+ * permitted, we fall back to RAFT.AE until it reconnects. Other errors (e.g.
+ * -LOADING) are transient. Either way, the failed message is resent by the
+ * Raft library as usual.
+ */
+static void handleAppendEntriesBinaryResponse(redisAsyncContext *c, void *r, void *privdata)
+{
+    Node *node = privdata;
+
+    uint64_t sent_time = NodeDismissPendingResponse(node);
+
+    redisReply *reply = r;
+    if (!reply) {
+        NODE_TRACE(node, "RAFT.AEBIN failed: connection dropped.");
+        ConnMarkDisconnected(node->conn);
+        return;
+    }
+
+    if (reply->type == REDIS_REPLY_ERROR) {
+        if (!strncmp(reply->str, "ERR unknown command", 19) ||
+            !strncmp(reply->str, "ERR unsupported RAFT.AEBIN", 26) ||
+            !strncmp(reply->str, "NOPERM", 6)) {
+            NODE_LOG_NOTICE(node, "RAFT.AEBIN error: %s, falling back to RAFT.AE", reply->str);
+            node->ae_text_only = true;
+        } else {
+            NODE_TRACE(node, "RAFT.AEBIN error: %s", reply->str);
+        }
+        return;
+    }
+
+    handleAppendEntriesReply(node, reply, sent_time);
+}
+
+static void handleAppendEntriesReply(Node *node, redisReply *reply, uint64_t sent_time)
+{
+    RedisRaftCtx *rr = node->rr;
+
     if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 4 ||
         reply->element[0]->type != REDIS_REPLY_INTEGER ||
         reply->element[1]->type != REDIS_REPLY_INTEGER ||
@@ -885,7 +1026,28 @@ static void handleAppendEntriesResponse(redisAsyncContext *c, void *r, void *pri
         .msg_id = reply->element[3]->integer,
     };
 
+    /* Node may have been removed while the request was in flight */
     raft_node_t *raft_node = raft_get_node(rr->raft, node->id);
+    if (!raft_node) {
+        NODE_TRACE(node, "RAFT.AE stale reply.");
+        return;
+    }
+
+    /* The node has accepted us as the leader of the current term, so it won't
+     * vote for another node before an election timeout elapses from the time
+     * the request was sent. */
+    if (response.term == raft_get_current_term(rr->raft) &&
+        sent_time > node->lease_ack_time) {
+        node->lease_ack_time = sent_time;
+    }
+
+    if (response.success) {
+        node->match_idx = response.current_idx;
+    }
+
+    if (response.term == raft_get_current_term(rr->raft)) {
+        NodeUpdateFlowControl(node, sent_time);
+    }
 
     int ret = raft_recv_appendentries_response(rr->raft, raft_node, &response);
     if (ret != 0) {
@@ -893,9 +1055,32 @@ static void handleAppendEntriesResponse(redisAsyncContext *c, void *r, void *pri
     }
 }
 
+/* Send AppendEntries using the RAFT.AEBIN binary encoding. The command is
+ * formatted into a single buffer by AppendEntriesFormatBinaryCommand(); see
+ * AppendEntriesSerializeBinary() for the message layout.
+ */
+static int sendAppendEntriesBinary(raft_server_t *raft, Node *node,
+                                   raft_node_t *raft_node, raft_appendentries_req_t *msg)
+{
+    size_t cmd_len;
+    char *cmd = AppendEntriesFormatBinaryCommand(msg, raft_node_get_id(raft_node),
+                                                 raft_get_nodeid(raft), &cmd_len);
+
+    if (redisAsyncFormattedCommand(ConnGetRedisCtx(node->conn), handleAppendEntriesBinaryResponse,
+                                   node, cmd, cmd_len) != REDIS_OK) {
+        NODE_TRACE(node, "failed appendentries");
+    } else {
+        NodeAddPendingResponse(node, false, cmd_len);
+    }
+
+    RedisModule_Free(cmd);
+    return 0;
+}
+
 static int raftSendAppendEntries(raft_server_t *raft, void *user_data,
                                  raft_node_t *raft_node, raft_appendentries_req_t *msg)
 {
+    RedisRaftCtx *rr = user_data;
     Node *node = (Node *) raft_node_get_udata(raft_node);
 
     int argc = 5 + msg->n_entries * 2;
@@ -907,6 +1092,14 @@ static int raftSendAppendEntries(raft_server_t *raft, void *user_data,
         return 0;
     }
 
+    LatencyEntriesSent(&rr->latency, msg->entries, msg->prev_log_idx + 1,
+                       msg->n_entries);
+    NodeRecordAppendEntries(node, msg->n_entries);
+
+    if (!node->ae_text_only) {
+        return sendAppendEntriesBinary(raft, node, raft_node, msg);
+    }
+
     argv = RedisModule_Alloc(sizeof(argv[0]) * argc);
     argvlen = RedisModule_Alloc(sizeof(argvlen[0]) * argc);
 
@@ -937,19 +1130,21 @@ static int raftSendAppendEntries(raft_server_t *raft, void *user_data,
     argvlen[4] = snprintf(nentries_str, sizeof(nentries_str) - 1, "%ld", msg->n_entries);
 
     int i;
+    size_t bytes = 0;
     for (i = 0; i < msg->n_entries; i++) {
         raft_entry_t *e = msg->entries[i];
         argv[5 + i * 2] = RedisModule_Alloc(64);
         argvlen[5 + i * 2] = snprintf(argv[5 + i * 2], 63, "%ld:%d:%llu:%d", e->term, e->id, e->session, e->type);
         argvlen[6 + i * 2] = e->data_len;
         argv[6 + i * 2] = e->data;
+        bytes += e->data_len;
     }
 
     if (redisAsyncCommandArgv(ConnGetRedisCtx(node->conn), handleAppendEntriesResponse,
                               node, argc, (const char **) argv, argvlen) != REDIS_OK) {
         NODE_TRACE(node, "failed appendentries");
     } else {
-        NodeAddPendingResponse(node, false);
+        NodeAddPendingResponse(node, false, bytes);
     }
 
     for (i = 0; i < msg->n_entries; i++) {
@@ -968,12 +1163,12 @@ static void handleTimeoutNowResponse(redisAsyncContext *c, void *r, void *privda
 {
     Node *node = privdata;
 
-    NodeDismissPendingResponse(node);
+    NodeDismissPriorityResponse(node);
 
     redisReply *reply = r;
     if (!reply) {
         NODE_TRACE(node, "RAFT.TIMEOUT_NOW failed: connection dropped.");
-        ConnMarkDisconnected(node->conn);
+        ConnMarkDisconnected(node->priority_conn);
         return;
     }
     if (reply->type == REDIS_REPLY_ERROR) {
@@ -991,21 +1186,168 @@ static int raftSendTimeoutNow(raft_server_t *raft, void *udata, raft_node_t *raf
 {
     Node *node = raft_node_get_udata(raft_node);
 
-    if (!ConnIsConnected(node->conn)) {
-        NODE_TRACE(node, "not connected, state=%s", ConnGetStateStr(node->conn));
+    if (!ConnIsConnected(node->priority_conn)) {
+        NODE_TRACE(node, "priority connection not connected, state=%s",
+                   ConnGetStateStr(node->priority_conn));
         return 0;
     }
 
-    if (redisAsyncCommand(ConnGetRedisCtx(node->conn), handleTimeoutNowResponse,
+    if (redisAsyncCommand(ConnGetRedisCtx(node->priority_conn), handleTimeoutNowResponse,
                           node, "RAFT.TIMEOUT_NOW") != REDIS_OK) {
         NODE_TRACE(node, "failed timeout now");
     } else {
-        NodeAddPendingResponse(node, false);
+        NodeAddPriorityResponse(node);
     }
 
     return 0;
 }
 
+/* ------------------------------------ Keepalive ---------------------------------------- */
+
+static void handleKeepaliveResponse(redisAsyncContext *c, void *r, void *privdata)
+{
+    Node *node = privdata;
+    RedisRaftCtx *rr = node->rr;
+
+    uint64_t sent_time = NodeDismissPriorityResponse(node);
+
+    redisReply *reply = r;
+    if (!reply) {
+        NODE_TRACE(node, "RAFT.AE keepalive failed: connection dropped.");
+        ConnMarkDisconnected(node->priority_conn);
+        return;
+    }
+
+    if (reply->type == REDIS_REPLY_ERROR) {
+        NODE_TRACE(node, "RAFT.AE keepalive error: %s", reply->str);
+        return;
+    }
+
+    if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 4 ||
+        reply->element[0]->type != REDIS_REPLY_INTEGER) {
+        NODE_LOG_WARNING(node, "invalid RAFT.AE keepalive reply");
+        return;
+    }
+
+    /* A higher term is handled once a reply to a regular appendreq message
+     * arrives, the keepalive is ignored by the Raft library. */
+    if (raft_is_leader(rr->raft) &&
+        reply->element[0]->integer == raft_get_current_term(rr->raft) &&
+        sent_time > node->lease_ack_time) {
+        node->lease_ack_time = sent_time;
+    }
+}
+
+/* Send keepalives to the nodes that have Raft messages in flight, over the
+ * priority connection.
+ *
+ * Heartbeats are regular appendreq messages. Behind a large appendreq message
+ * or snapshot chunk, or when backpressure is applied, they may not reach a
+ * node within the election timeout, so it would start an election while the
+ * leader is healthy. A keepalive is an appendreq message without entries for
+ * log index 0. It resets the election timer of the node as any appendreq
+ * message of the current term does, but it never changes the log, and its
+ * reply is only used to extend the read lease, see Node.lease_ack_time. The
+ * Raft library ignores the reply as its message id is 0, so replication is not
+ * affected.
+ */
+static void raftSendKeepalives(RedisRaftCtx *rr)
+{
+    struct sc_list *it;
+    uint64_t now = RedisModule_MonotonicMicroseconds();
+    uint64_t interval = (uint64_t) rr->config.request_timeout * 1000;
+
+    if (!raft_is_leader(rr->raft)) {
+        return;
+    }
+
+    sc_list_foreach (&rr->nodes, it) {
+        Node *node = sc_list_entry(it, Node, entries);
+
+        if (!node->pending_raft_response_num ||
+            node->priority_pending.count ||
+            now - node->keepalive_time < interval ||
+            !raft_get_node(rr->raft, node->id) ||
+            !ConnIsConnected(node->priority_conn)) {
+            continue;
+        }
+
+        /* RAFT.AE <target_node_id> <src_node_id> <leader_id>:<term>:<prev_log_idx>:<prev_log_term>:<leader_commit>:<msg_id> <n_entries> */
+        if (redisAsyncCommand(ConnGetRedisCtx(node->priority_conn), handleKeepaliveResponse,
+                              node, "RAFT.AE %d %d %d:%ld:0:0:0:0 0",
+                              node->id,
+                              raft_get_nodeid(rr->raft),
+                              raft_get_nodeid(rr->raft),
+                              raft_get_current_term(rr->raft)) != REDIS_OK) {
+            NODE_TRACE(node, "failed keepalive");
+            continue;
+        }
+
+        NodeAddPriorityResponse(node);
+        node->keepalive_time = now;
+    }
+}
+
+/* ------------------------------------ AppendEntries Ack ------------------------------- */
+
+static void handleAppendEntriesAckResponse(redisAsyncContext *c, void *r, void *privdata)
+{
+    Node *node = privdata;
+
+    NodeDismissPriorityResponse(node);
+
+    redisReply *reply = r;
+    if (!reply) {
+        NODE_TRACE(node, "RAFT.AEACK failed: connection dropped.");
+        ConnMarkDisconnected(node->priority_conn);
+        return;
+    }
+
+    if (reply->type == REDIS_REPLY_ERROR) {
+        NODE_TRACE(node, "RAFT.AEACK error: %s", reply->str);
+    }
+}
+
+/* Acknowledge entries to the leader once they are fsync'd. Replies to
+ * appendreq messages only acknowledge entries that are already fsync'd, see
+ * handleAppendEntries(). A single RAFT.AEACK covers every message received
+ * until fsync() completes. If it can't be sent, the leader learns about the
+ * entries from the reply to its next appendreq message.
+ */
+static void raftSendAppendEntriesAck(RedisRaftCtx *rr)
+{
+    AppendEntriesAck *ack = &rr->ae_ack;
+    raft_index_t idx = MIN(ack->match_idx, rr->log.fsync_index);
+
+    if (idx <= ack->acked_idx ||
+        raft_is_leader(rr->raft) ||
+        ack->term != raft_get_current_term(rr->raft)) {
+        return;
+    }
+
+    raft_node_t *raft_node = raft_get_node(rr->raft, ack->leader_id);
+    Node *node = raft_node ? raft_node_get_udata(raft_node) : NULL;
+
+    if (!node || !node->ae_ack || !ConnIsConnected(node->priority_conn)) {
+        return;
+    }
+
+    /* RAFT.AEACK <target_node_id> <src_node_id> <term> <current_idx> <msg_id> */
+    if (redisAsyncCommand(ConnGetRedisCtx(node->priority_conn), handleAppendEntriesAckResponse,
+                          node, "RAFT.AEACK %d %d %ld %ld %lu",
+                          node->id,
+                          raft_get_nodeid(rr->raft),
+                          ack->term,
+                          idx,
+                          ack->msg_id) != REDIS_OK) {
+        NODE_TRACE(node, "failed appendentries ack");
+        return;
+    }
+
+    NodeAddPriorityResponse(node);
+    ack->acked_idx = idx;
+}
+
 /* ------------------------------------ Log Callbacks ------------------------------------ */
 
 static int raftPersistMetadata(raft_server_t *raft, void *user_data,
@@ -1058,8 +1400,18 @@ static int raftApplyLog(raft_server_t *raft, void *user_data, raft_entry_t *entr
             break;
         }
         case RAFT_LOGTYPE_NORMAL:
-            executeLogEntry(rr, entry, entry_idx, req);
+        case RAFT_LOGTYPE_BATCH: {
+            uint64_t start = RedisModule_MonotonicMicroseconds();
+
+            LatencyEntryCommitted(&rr->latency, entry_idx, entry->id);
+            if (entry->type == RAFT_LOGTYPE_NORMAL) {
+                executeLogEntry(rr, entry, entry_idx, req);
+            } else {
+                executeBatchEntry(rr, entry, entry_idx, req);
+            }
+            LatencyRecord(&rr->latency, LATENCY_APPLY, start);
             break;
+        }
         case RAFT_LOGTYPE_ADD_SHARDGROUP:
         case RAFT_LOGTYPE_UPDATE_SHARDGROUP:
             applyShardGroupChange(rr, entry, req);
@@ -1208,7 +1560,7 @@ void raftNotifyMembershipEvent(raft_server_t *raft, void *user_data,
         case RAFT_MEMBERSHIP_REMOVE:
             node = raft_node_get_udata(raft_node);
             if (node != NULL) {
-                ConnAsyncTerminate(node->conn);
+                NodeTerminate(node);
                 raft_node_set_udata(raft_node, NULL);
             }
             break;
@@ -1268,6 +1620,7 @@ static void raftNotifyStateEvent(raft_server_t *raft, void *user_data, raft_stat
         case RAFT_STATE_LEADER:
             LOG_NOTICE("State change: Node is now a leader, term %ld",
                        raft_get_current_term(raft));
+            redis_raft.lease_epoch = RedisModule_MonotonicMicroseconds();
             break;
         default:
             break;
@@ -1288,13 +1641,14 @@ static void raftNotifyStateEvent(raft_server_t *raft, void *user_data, raft_stat
  * want to create many appendentries messages for the node if we don't get
  * replies. Otherwise, it might cause out of memory. Second, we want to send
  * entries in batches for performance reasons. We are effectively batching
- * entries until we get replies from the previous ones. */
+ * entries until we get replies from the previous ones. The number of in-flight
+ * messages adapts to the node, see NodeUpdateFlowControl(). */
 static int raftBackpressure(raft_server_t *raft, void *user_data, raft_node_t *raft_node)
 {
-    RedisRaftCtx *rr = &redis_raft;
     Node *node = raft_node_get_udata(raft_node);
-    if (node->pending_raft_response_num >= rr->config.append_req_max_count) {
+    if (node->pending_raft_response_num >= NodeAppendWindow(node)) {
         /* Don't send append req to this node */
+        node->ae_window_limited = true;
         return 1;
     }
 
@@ -1314,24 +1668,40 @@ static raft_index_t raftGetEntriesToSend(raft_server_t *raft, void *user_data,
                                          raft_index_t entries_n,
                                          raft_entry_t **entries)
 {
-    (void) node;
+    (void) raft;
     (void) user_data;
 
     raft_index_t i;
     long long serialized_size = 0;
     RedisRaftCtx *rr = &redis_raft;
+    Node *n = raft_node_get_udata(node);
+
+    n->next_idx = idx;
 
     for (i = 0; i < entries_n; i++) {
-        raft_entry_t *e = raft_get_entry_from_idx(raft, idx + i);
+        raft_entry_t *e = EntryCacheGet(rr->logcache, idx + i);
+        bool cached = (e != NULL);
+
         if (!e) {
-            break;
+            e = LogGet(&rr->log, idx + i);
+            if (!e) {
+                break;
+            }
         }
         serialized_size += e->data_len;
         /* A single entry can be larger than the limit, so, we always allow the
          * first entry. */
-        if (i != 0 && serialized_size > rr->config.append_req_max_size) {
+        if (i != 0 && serialized_size > NodeAppendBatchSize(n)) {
+            n->ae_batch_limited = true;
+            raft_entry_release(e);
             break;
         }
+
+        if (cached) {
+            n->cache_hits++;
+        } else {
+            n->cache_misses++;
+        }
         entries[i] = e;
     }
 
@@ -1364,7 +1734,7 @@ static RRStatus loadRaftLog(RedisRaftCtx *rr)
 {
     int ret;
 
-    if (LogLoadEntries(&rr->log) != RR_OK) {
+    if (LogLoadEntries(&rr->log, &rr->thread_pool) != RR_OK) {
         LOG_WARNING("Failed to read Raft log");
         return RR_ERROR;
     }
@@ -1485,6 +1855,114 @@ static void handleLoadingState(RedisRaftCtx *rr)
     }
 }
 
+static int leaseTimeCmp(const void *a, const void *b)
+{
+    uint64_t va = *(const uint64_t *) a;
+    uint64_t vb = *(const uint64_t *) b;
+
+    return va < vb ? 1 : (va > vb ? -1 : 0);
+}
+
+/* Returns true if this node is the leader and holds a valid leader lease.
+ *
+ * Followers won't vote for another node within an election timeout of the
+ * last request they acknowledged from the leader, as a pre-vote is rejected
+ * while a leader is known. Once a majority of voters have acknowledged
+ * requests sent at time T, no other leader can be elected before
+ * T + election_timeout, minus the clock drift allowance.
+ *
+ * A leadership transfer bypasses pre-vote, so the lease is not used for the
+ * rest of the term once a transfer has been requested.
+ */
+bool RaftHasLeaderLease(RedisRaftCtx *rr)
+{
+    if (!raft_is_leader(rr->raft) ||
+        raft_get_transfer_leader(rr->raft) != RAFT_NODE_ID_NONE ||
+        rr->lease_blocked_term == raft_get_current_term(rr->raft)) {
+        return false;
+    }
+
+    raft_node_t *me = raft_get_my_node(rr->raft);
+    if (!me || !raft_node_is_voting(me)) {
+        return false;
+    }
+
+    int num_nodes = raft_get_num_nodes(rr->raft);
+    uint64_t times[num_nodes];
+    uint64_t now = RedisModule_MonotonicMicroseconds();
+    int voters = 0;
+
+    for (int i = 0; i < num_nodes; i++) {
+        raft_node_t *rn = raft_get_node_from_idx(rr->raft, i);
+        if (!raft_node_is_voting(rn)) {
+            continue;
+        }
+
+        if (rn == me) {
+            times[voters++] = now;
+        } else {
+            Node *n = raft_node_get_udata(rn);
+            times[voters++] = n ? n->lease_ack_time : 0;
+        }
+    }
+
+    qsort(times, voters, sizeof(times[0]), leaseTimeCmp);
+
+    /* Time of the latest request acknowledged by a majority */
+    uint64_t start = times[voters / 2];
+    if (start < rr->lease_epoch) {
+        return false;
+    }
+
+    uint64_t duration = (uint64_t) rr->config.election_timeout * 1000 *
+                        (100 - rr->config.lease_clock_drift) / 100;
+
+    return now < start + duration;
+}
+
+/* Returns the lowest log index the leader still has to send to a connected
+ * follower, so the log cache can keep these entries in memory. Returns zero if
+ * no entries are needed.
+ */
+static raft_index_t cachePinIdx(RedisRaftCtx *rr)
+{
+    raft_index_t pin_idx = 0;
+
+    if (!raft_is_leader(rr->raft)) {
+        return 0;
+    }
+
+    for (int i = 0; i < raft_get_num_nodes(rr->raft); i++) {
+        Node *n = raft_node_get_udata(raft_get_node_from_idx(rr->raft, i));
+
+        if (!n || !n->next_idx || !ConnIsConnected(n->conn)) {
+            continue;
+        }
+        if (!pin_idx || n->next_idx < pin_idx) {
+            pin_idx = n->next_idx;
+        }
+    }
+
+    return pin_idx;
+}
+
+/* Returns the log file size that triggers compaction, 0 if disabled.
+ *
+ * Compaction rewrites the whole dataset, regardless of how much of it has
+ * changed. If log-max-file-size-percentage is set, the limit grows with the
+ * last snapshot, so compaction I/O stays proportional to the write volume. */
+static uint64_t logCompactionLimit(RedisRaftCtx *rr)
+{
+    uint64_t limit = rr->config.log_max_file_size;
+    uint64_t percentage = rr->config.log_max_file_size_percentage;
+
+    if (!limit || !percentage) {
+        return limit;
+    }
+
+    return MAX(limit, rr->outgoing_snapshot_file.len * percentage / 100);
+}
+
 void callRaftPeriodic(RedisModuleCtx *ctx, void *arg)
 {
     RedisRaftCtx *rr = arg;
@@ -1526,9 +2004,12 @@ void callRaftPeriodic(RedisModuleCtx *ctx, void *arg)
 
     RedisModule_Assert(ret == 0);
 
+    raftSendKeepalives(rr);
+
     /* Compact cache */
     if (rr->config.log_max_cache_size) {
-        EntryCacheCompact(rr->logcache, rr->config.log_max_cache_size);
+        EntryCacheCompact(rr->logcache, rr->config.log_max_cache_size,
+                          cachePinIdx(rr), rr->config.log_max_cache_pinned_size);
     }
 
     /* Initiate snapshot if log size exceeds raft-log-file-max
@@ -1542,7 +2023,7 @@ void callRaftPeriodic(RedisModuleCtx *ctx, void *arg)
         bool start;
         /* Step-1: Start compaction if we are over the file size limit or if
          * there is a debug req. */
-        uint64_t limit = rr->config.log_max_file_size;
+        uint64_t limit = logCompactionLimit(rr);
         start = (limit && LogFileSize(&rr->log) > limit);
 
         if (start && !LogCompactionStarted(&rr->log) &&
@@ -1743,6 +2224,11 @@ void RaftReqFree(RaftReq *req)
         if (req->r.redis.cmds.size) {
             RaftRedisCommandArrayFree(&req->r.redis.cmds);
         }
+    } else if (req->type == RR_WRITE_BATCH) {
+        for (int i = 0; i < req->r.batch.len; i++) {
+            RaftReqFree(req->r.batch.reqs[i]);
+        }
+        RedisModule_Free(req->r.batch.reqs);
     } else if (req->type == RR_IMPORT_KEYS) {
         if (req->r.import_keys.key_names) {
             for (size_t i = 0; i < req->r.import_keys.num_keys; i++) {
@@ -1813,6 +2299,7 @@ static RaftReq *RaftReqInitCore(RedisModuleCtx *ctx, enum RaftReqType type)
         req->ctx = RedisModule_GetThreadSafeContext(req->client);
     }
     req->type = type;
+    req->start_time = RedisModule_MonotonicMicroseconds();
 
     return req;
 }
@@ -1850,6 +2337,124 @@ RaftReq *RaftReqInitBlocking(RedisModuleCtx *ctx, enum RaftReqType type, long lo
     return req;
 }
 
+/* Compress the payload of a new entry, if it is large enough. See
+ * RaftRedisCompressEntry().
+ */
+raft_entry_t *RaftCompressEntry(RedisRaftCtx *rr, raft_entry_t *entry)
+{
+    size_t len = entry->data_len;
+
+    entry = RaftRedisCompressEntry(entry, rr->config.log_compression_threshold);
+    if (entry->data_len < len) {
+        rr->compressed_entries++;
+        rr->compression_saved_bytes += len - entry->data_len;
+    }
+
+    return entry;
+}
+
+/* Record the append latency of the requests of a new entry, and start tracking
+ * the entry to measure the time until it is replicated and committed.
+ */
+void RaftRecordAppendLatency(RedisRaftCtx *rr, raft_index_t idx, raft_entry_id_t id, RaftReq **reqs, int count)
+{
+    uint64_t now = RedisModule_MonotonicMicroseconds();
+
+    for (int i = 0; i < count; i++) {
+        LatencyRecord(&rr->latency, LATENCY_APPEND, reqs[i]->start_time);
+    }
+
+    LatencyEntryAppended(&rr->latency, idx, id, now);
+}
+
+/* Add a client write to the batch of the current event loop iteration. The
+ * batch is appended to the log by RaftFlushWriteBatch(), once it is full or
+ * before the event loop goes to sleep.
+ */
+void RaftAddToWriteBatch(RedisRaftCtx *rr, RaftReq *req)
+{
+    if (!rr->write_batch) {
+        rr->write_batch = RaftReqInit(NULL, RR_WRITE_BATCH);
+    }
+
+    RaftReq *batch = rr->write_batch;
+
+    if (batch->r.batch.len == batch->r.batch.size) {
+        batch->r.batch.size = batch->r.batch.size ? batch->r.batch.size * 2 : 16;
+        batch->r.batch.reqs = RedisModule_Realloc(batch->r.batch.reqs,
+                                                  batch->r.batch.size * sizeof(RaftReq *));
+    }
+    batch->r.batch.reqs[batch->r.batch.len++] = req;
+
+    if (batch->r.batch.len >= rr->config.write_batch_max_requests) {
+        RaftFlushWriteBatch(rr);
+    }
+}
+
+/* Append pending client writes to the log. A single write is appended as a
+ * regular entry, multiple writes as a single RAFT_LOGTYPE_BATCH entry.
+ */
+void RaftFlushWriteBatch(RedisRaftCtx *rr)
+{
+    RaftReq *batch = rr->write_batch;
+    RaftReq *req = batch;
+    raft_entry_t *entry;
+
+    if (!batch) {
+        return;
+    }
+    rr->write_batch = NULL;
+
+    int len = batch->r.batch.len;
+    if (len == 1) {
+        req = batch->r.batch.reqs[0];
+        batch->r.batch.len = 0;
+        RaftReqFree(batch);
+
+        entry = RaftCompressEntry(rr, RaftRedisCommandArraySerialize(&req->r.redis.cmds));
+        entry->type = RAFT_LOGTYPE_NORMAL;
+        entry->session = req->r.redis.cmds.client_id;
+    } else {
+        RaftRedisCommandArray **arrays = RedisModule_Alloc(len * sizeof(*arrays));
+        for (int i = 0; i < len; i++) {
+            arrays[i] = &batch->r.batch.reqs[i]->r.redis.cmds;
+        }
+
+        entry = RaftCompressEntry(rr, RaftRedisCommandBatchSerialize(arrays, len));
+        entry->type = RAFT_LOGTYPE_BATCH;
+        RedisModule_Free(arrays);
+    }
+    entry->id = rand();
+    raft_entry_id_t id = entry->id;
+
+    int e = RedisRaftRecvEntry(rr, entry, req);
+    if (e != 0) {
+        if (len > 1) {
+            for (int i = 0; i < len; i++) {
+                replyRaftError(batch->r.batch.reqs[i]->ctx, NULL, e);
+            }
+        } else {
+            replyRaftError(req->ctx, NULL, e);
+        }
+        RaftReqFree(req);
+        return;
+    }
+
+    raft_index_t idx = raft_get_current_idx(rr->raft);
+
+    if (len > 1) {
+        for (int i = 0; i < len; i++) {
+            batch->r.batch.reqs[i]->raft_idx = idx;
+        }
+        rr->write_batches++;
+        rr->write_batch_requests += len;
+        RaftRecordAppendLatency(rr, idx, id, batch->r.batch.reqs, len);
+    } else {
+        req->raft_idx = idx;
+        RaftRecordAppendLatency(rr, idx, id, &req, 1);
+    }
+}
+
 /* ------------------------------------ RaftReq Implementation ------------------------------------ */
 
 /*
@@ -2005,11 +2610,13 @@ void handleFsyncCompleted(void *result)
     FsyncThreadResult *rs = result;
     RedisRaftCtx *rr = &redis_raft;
 
-    rr->log.fsync_count++;
-    rr->log.fsync_index = rs->fsync_index;
-    rr->log.fsync_total += rs->time;
-    rr->log.fsync_max = MAX(rs->time, rr->log.fsync_max);
+    LatencyHistogramRecord(&rr->latency.stages[LATENCY_FSYNC], rs->time);
 
+    /* Log entries have been deleted since this fsync() was requested, it
+     * may not cover the entries that replaced them. */
+    if (rs->request_id > rr->fsync_stale_id) {
+        LogFsyncCompleted(&rr->log, rs->fsync_index, rs->time);
+    }
     RedisModule_Free(rs);
 }
 
@@ -2018,6 +2625,72 @@ static void noopCallback(void *result)
     (void) result;
 }
 
+static void groupCommitTimerCallback(RedisModuleCtx *ctx, void *data)
+{
+    RedisRaftCtx *rr = data;
+
+    /* Nothing to do here, handleBeforeSleep() will request the fsync() */
+    rr->fsync_timer_set = false;
+}
+
+/* Request an fsync() of the log up to idx from fsyncThread, including log
+ * segments sealed since the last request.
+ */
+void RaftRequestLogFsync(RedisRaftCtx *rr, raft_index_t idx)
+{
+    int fd;
+
+    while ((fd = LogTakeSealedFd(&rr->log)) != -1) {
+        fsyncThreadAddFile(&rr->fsyncThread, fd);
+    }
+
+    fsyncThreadAddTask(&rr->fsyncThread, LogCurrentFd(&rr->log), idx);
+    rr->fsync_requested_idx = idx;
+}
+
+/* Group commit: if log-fsync-delay is set, the leader does not request an
+ * fsync() for new entries right away. Instead, appends are coalesced across
+ * event loop iterations until the oldest pending entry has waited for
+ * log-fsync-delay microseconds, or log-fsync-pending-bytes have been written.
+ *
+ * Returns true if fsync() should be requested now. Otherwise, makes sure the
+ * event loop wakes up in time to request it later.
+ */
+static bool groupCommitReady(RedisRaftCtx *rr)
+{
+    if (!rr->config.log_fsync_delay || !raft_is_leader(rr->raft)) {
+        return true;
+    }
+
+    if (raft_get_current_idx(rr->raft) <= rr->fsync_requested_idx) {
+        rr->fsync_pending_since = 0;
+        return true;
+    }
+
+    uint64_t now = RedisModule_MonotonicMicroseconds();
+    uint64_t pending_bytes = rr->log.bytes_written - rr->fsync_requested_bytes;
+
+    if (!rr->fsync_pending_since) {
+        rr->fsync_pending_since = now;
+    }
+
+    uint64_t waited = now - rr->fsync_pending_since;
+    if (waited >= (uint64_t) rr->config.log_fsync_delay ||
+        pending_bytes >= (uint64_t) rr->config.log_fsync_pending_bytes) {
+        return true;
+    }
+
+    if (!rr->fsync_timer_set) {
+        uint64_t remaining = rr->config.log_fsync_delay - waited;
+
+        RedisModule_CreateTimer(rr->ctx, (mstime_t) ((remaining + 999) / 1000),
+                                groupCommitTimerCallback, rr);
+        rr->fsync_timer_set = true;
+    }
+
+    return false;
+}
+
 /* Redis thread callback, called just before Redis main thread goes to sleep,
  * e.g epoll_wait(). At this point, we've read all new network messages for this
  * event loop iteration. We can trigger new appendentries messages for the new
@@ -2028,16 +2701,29 @@ void handleBeforeSleep(RedisRaftCtx *rr)
         return;
     }
 
+    RaftFlushWriteBatch(rr);
+
     raft_index_t flushed = rr->log.fsync_index;
-    raft_index_t next = raft_get_index_to_sync(rr->raft);
+    raft_index_t next = 0;
+
+    if (!rr->config.log_fsync || groupCommitReady(rr)) {
+        next = raft_get_index_to_sync(rr->raft);
+    }
+
     if (next > 0) {
         LogFlush(&rr->log);
 
         if (rr->config.log_fsync) {
             /* Trigger async fsync() for the current index */
-            fsyncThreadAddTask(&rr->fsyncThread, LogCurrentFd(&rr->log), next);
+            RaftRequestLogFsync(rr, next);
+            rr->fsync_requested_bytes = rr->log.bytes_written;
+            rr->fsync_pending_since = 0;
         } else {
             /* Skipping fsync(), we can just update the sync'd index. */
+            int fd;
+            while ((fd = LogTakeSealedFd(&rr->log)) != -1) {
+                close(fd);
+            }
             flushed = next;
         }
     }
@@ -2048,6 +2734,9 @@ void handleBeforeSleep(RedisRaftCtx *rr)
     }
     RedisModule_Assert(e == 0);
 
+    raftSendAppendEntriesAck(rr);
+    HandleFollowerReads(rr);
+
     if (raft_pending_operations(rr->raft)) {
         /* If there are pending operations, we need to call raft_flush() again.
          * We'll do it in the next iteration as we want to process messages
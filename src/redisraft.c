@@ -226,6 +226,9 @@ static int cmdRaftTransferLeader(RedisModuleCtx *ctx, RedisModuleString **argv,
         return REDISMODULE_OK;
     }
 
+    /* The target starts an election without a pre-vote */
+    rr->lease_blocked_term = raft_get_current_term(rr->raft);
+
     rr->transfer_req = RaftReqInit(ctx, RR_TRANSFER_LEADER);
 
     return REDISMODULE_OK;
@@ -264,6 +267,71 @@ static int cmdRaftTimeoutNow(RedisModuleCtx *ctx, RedisModuleString **argv, int
     return REDISMODULE_OK;
 }
 
+static void handleReadIndex(void *arg, int can_read)
+{
+    RaftReq *req = arg;
+
+    if (!can_read) {
+        RedisModule_ReplyWithError(req->ctx, "TIMEOUT no quorum for read");
+    } else {
+        RedisModule_ReplyWithLongLong(req->ctx, req->raft_idx);
+    }
+
+    RaftReqFree(req);
+}
+
+/* RAFT.READINDEX
+ *   Request a read index from the leader. A follower may serve a read-only
+ *   command locally once it has applied the log up to the read index.
+ * Reply:
+ *   -NOCLUSTER ||
+ *   -LOADING ||
+ *   -MOVED <addr> ||
+ *   -CLUSTERDOWN ||
+ *   -TIMEOUT ||
+ *   :<read index>
+ */
+static int cmdRaftReadIndex(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
+{
+    RedisRaftCtx *rr = &redis_raft;
+
+    if (argc != 1) {
+        RedisModule_WrongArity(ctx);
+        return REDISMODULE_OK;
+    }
+
+    if (checkRaftState(rr, ctx) != RR_OK ||
+        checkLeader(rr, ctx, NULL) != RR_OK) {
+        return REDISMODULE_OK;
+    }
+
+    /* Commit index is not known to be up-to-date until an entry from the
+     * current term is applied. */
+    if (raft_get_current_term(rr->raft) != rr->snapshot_info.last_applied_term) {
+        replyClusterDown(ctx);
+        return REDISMODULE_OK;
+    }
+
+    raft_index_t read_idx = raft_get_commit_idx(rr->raft);
+
+    if (!rr->config.quorum_reads ||
+        (rr->config.lease_reads && RaftHasLeaderLease(rr))) {
+        RedisModule_ReplyWithLongLong(ctx, read_idx);
+        return REDISMODULE_OK;
+    }
+
+    RaftReq *req = RaftReqInit(ctx, RR_GENERIC);
+    req->raft_idx = read_idx;
+
+    int rc = raft_recv_read_request(rr->raft, handleReadIndex, req);
+    if (rc != 0) {
+        replyRaftError(ctx, NULL, rc);
+        RaftReqFree(req);
+    }
+
+    return REDISMODULE_OK;
+}
+
 /* RAFT.REQUESTVOTE [target_node_id] [src_node_id] [prevote]:[term]:[candidate_id]:[last_log_idx]:[last_log_term]
  *   Request a node's vote (per Raft paper).
  * Reply:
@@ -316,11 +384,26 @@ static int cmdRaftRequestVote(RedisModuleCtx *ctx, RedisModuleString **argv, int
     raft_requestvote_resp_t resp = {0};
     raft_node_t *node = raft_get_node(rr->raft, src_node_id);
 
+    /* A node that restarts forgets the leader it acknowledged, which may still
+     * hold a lease based on it, see RaftHasLeaderLease(). Refuse votes until
+     * such a lease has expired. */
+    uint64_t elapsed = RedisModule_MonotonicMicroseconds() - rr->vote_epoch;
+    if (elapsed < (uint64_t) rr->config.election_timeout * 1000) {
+        resp = (raft_requestvote_resp_t){
+            .prevote = req.prevote,
+            .request_term = req.term,
+            .term = raft_get_current_term(rr->raft),
+            .vote_granted = 0,
+        };
+        goto reply;
+    }
+
     if (raft_recv_requestvote(rr->raft, node, &req, &resp) != 0) {
         RedisModule_ReplyWithError(ctx, "ERR operation failed");
         return REDISMODULE_OK;
     }
 
+reply:
     RedisModule_ReplyWithArray(ctx, 4);
     RedisModule_ReplyWithLongLong(ctx, resp.prevote);
     RedisModule_ReplyWithLongLong(ctx, resp.request_term);
@@ -691,6 +774,90 @@ static bool handleUnwatch(RedisRaftCtx *rr, RedisModuleCtx *ctx, RaftRedisComman
     return false;
 }
 
+/* Check the commands can be executed (e.g. ACL, OOM) without executing them.
+ * If not, the error is replied and RR_ERROR is returned.
+ */
+static RRStatus dryRunCommands(RedisRaftCtx *rr, RedisModuleCtx *ctx, RaftRedisCommandArray *cmds)
+{
+    for (int i = 0; i < cmds->len; i++) {
+        RaftRedisCommand *cmd = cmds->commands[i];
+        size_t cmdlen;
+        const char *cmdstr = RedisModule_StringPtrLen(cmd->argv[0], &cmdlen);
+        /* skip multi */
+        if (i == 0 && cmdlen == 5 && !strncasecmp(cmdstr, "MULTI", 5)) {
+            continue;
+        }
+
+        if (CommandCheckCached(rr, ctx, cmd, true)) {
+            rr->cmd_checks_cached++;
+            continue;
+        }
+        rr->cmd_checks_dry_run++;
+
+        enterRedisModuleCall();
+        RedisModuleCallReply *reply = RedisModule_Call(ctx, cmdstr, "DCEMv", cmd->argv + 1, cmd->argc - 1);
+        exitRedisModuleCall();
+        if (reply != NULL) {
+            RedisModule_ReplyWithCallReply(ctx, reply);
+            RedisModule_FreeCallReply(reply);
+            return RR_ERROR;
+        }
+    }
+
+    return RR_OK;
+}
+
+/* Returns the aggregate flags of the commands, calculating them only if they
+ * were not carried with the array already.
+ */
+static unsigned int getCommandArrayFlags(RedisRaftCtx *rr, RaftRedisCommandArray *cmds)
+{
+    if (!cmds->cmd_flags_valid) {
+        cmds->cmd_flags = CommandSpecTableGetAggregateFlags(rr->commands_spec_table, cmds, CMD_SPEC_WRITE);
+        cmds->cmd_flags_valid = true;
+    }
+
+    return cmds->cmd_flags;
+}
+
+/* Handle a read-only command on a follower, if follower reads are enabled.
+ * The command is executed locally, once the log is applied up to the read
+ * index obtained from the leader.
+ *
+ * Returns true if the command has been handled, or false if it should be
+ * redirected or proxied to the leader.
+ */
+static bool handleFollowerRead(RedisRaftCtx *rr, RedisModuleCtx *ctx,
+                               RaftRedisCommandArray *cmds)
+{
+    if (!rr->config.follower_reads || raft_is_leader(rr->raft) || cmds->asking) {
+        return false;
+    }
+
+    raft_node_t *n = raft_get_leader_node(rr->raft);
+    Node *leader = n ? raft_node_get_udata(n) : NULL;
+    if (!leader || !ConnIsConnected(leader->conn)) {
+        return false;
+    }
+
+    unsigned int cmd_flags = getCommandArrayFlags(rr, cmds);
+    if (!(cmd_flags & CMD_SPEC_READONLY) ||
+        cmd_flags & (CMD_SPEC_WRITE | CMD_SPEC_UNSUPPORTED | CMD_SPEC_MULTI |
+                     CMD_SPEC_SCRIPTS | CMD_SPEC_BLOCKING)) {
+        return false;
+    }
+
+    if (dryRunCommands(rr, ctx, cmds) != RR_OK) {
+        return true;
+    }
+
+    if (FollowerReadCommand(rr, ctx, cmds, leader) != RR_OK) {
+        return false;
+    }
+
+    return true;
+}
+
 static void handleRedisCommandAppend(RedisRaftCtx *rr,
                                      RedisModuleCtx *ctx,
                                      RaftRedisCommandArray *cmds)
@@ -699,6 +866,7 @@ static void handleRedisCommandAppend(RedisRaftCtx *rr,
      * joining or loading data.
      */
     if (checkRaftState(rr, ctx) != RR_OK ||
+        handleFollowerRead(rr, ctx, cmds) ||
         checkLeader(rr, ctx, cmds) != RR_OK) {
         return;
     }
@@ -724,7 +892,7 @@ static void handleRedisCommandAppend(RedisRaftCtx *rr,
      * MULTI/EXEC transaction in which case all queued commands are handled at
      * once.
      */
-    unsigned int cmd_flags = CommandSpecTableGetAggregateFlags(rr->commands_spec_table, rr->subcommand_spec_tables, cmds, CMD_SPEC_WRITE);
+    unsigned int cmd_flags = getCommandArrayFlags(rr, cmds);
     if (cmd_flags & CMD_SPEC_MULTI) {
         /* if this is a MULTI, we aren't blocking */
         cmd_flags &= ~CMD_SPEC_BLOCKING;
@@ -736,24 +904,8 @@ static void handleRedisCommandAppend(RedisRaftCtx *rr,
         return;
     }
 
-    /* dry run */
-    for (int i = 0; i < cmds->len; i++) {
-        RaftRedisCommand *cmd = cmds->commands[i];
-        size_t cmdlen;
-        const char *cmdstr = RedisModule_StringPtrLen(cmd->argv[0], &cmdlen);
-        /* skip multi */
-        if (i == 0 && cmdlen == 5 && !strncasecmp(cmdstr, "MULTI", 5)) {
-            continue;
-        }
-
-        enterRedisModuleCall();
-        RedisModuleCallReply *reply = RedisModule_Call(ctx, cmdstr, "DCEMv", cmd->argv + 1, cmd->argc - 1);
-        exitRedisModuleCall();
-        if (reply != NULL) {
-            RedisModule_ReplyWithCallReply(ctx, reply);
-            RedisModule_FreeCallReply(reply);
-            return;
-        }
+    if (dryRunCommands(rr, ctx, cmds) != RR_OK) {
+        return;
     }
 
     handleWatch(rr, ctx, cmds);
@@ -772,7 +924,8 @@ static void handleRedisCommandAppend(RedisRaftCtx *rr,
 
     /* Handle the special case of read-only commands here: if quorum reads
      * are enabled schedule the request to be processed when we have a guarantee
-     * we're still a leader. Otherwise, just process the reads. */
+     * we're still a leader, unless the leader lease already provides it.
+     * Otherwise, just process the reads. */
     if (cmd_flags & CMD_SPEC_READONLY && !(cmd_flags & CMD_SPEC_WRITE)) {
         if (!rr->config.quorum_reads) {
             RaftReq req = {.ctx = ctx};
@@ -780,6 +933,13 @@ static void handleRedisCommandAppend(RedisRaftCtx *rr,
             return;
         }
 
+        if (rr->config.lease_reads && RaftHasLeaderLease(rr)) {
+            RaftReq req = {.ctx = ctx};
+            RaftExecuteCommandArray(rr, &req, cmds);
+            rr->lease_reads++;
+            return;
+        }
+
         RaftReq *req = RaftReqInit(ctx, RR_REDISCOMMAND);
         RaftRedisCommandArrayMove(&req->r.redis.cmds, cmds);
 
@@ -792,6 +952,19 @@ static void handleRedisCommandAppend(RedisRaftCtx *rr,
     }
 
     RaftReq *req;
+
+    /* Coalesce writes into a single entry, unless blocking. A blocking command
+     * is tracked by the index of its entry until it is unblocked. */
+    if (rr->config.write_batch_max_requests && !(cmd_flags & CMD_SPEC_BLOCKING) &&
+        NodesSupportBatchEntries(rr)) {
+        req = RaftReqInit(ctx, RR_REDISCOMMAND);
+        RaftRedisCommandArrayMove(&req->r.redis.cmds, cmds);
+        req->r.redis.cmds.client_id = RedisModule_GetClientId(ctx);
+
+        RaftAddToWriteBatch(rr, req);
+        return;
+    }
+
     if (cmd_flags & CMD_SPEC_BLOCKING) { /* protect against blocking commands in a MULTI above */
         long long timeout = 0;
         if (extractBlockingTimeout(ctx, cmds, &timeout) != RR_OK) {
@@ -803,10 +976,11 @@ static void handleRedisCommandAppend(RedisRaftCtx *rr,
     }
     RaftRedisCommandArrayMove(&req->r.redis.cmds, cmds);
 
-    raft_entry_t *entry = RaftRedisCommandArraySerialize(&req->r.redis.cmds);
+    raft_entry_t *entry = RaftCompressEntry(rr, RaftRedisCommandArraySerialize(&req->r.redis.cmds));
     entry->id = rand();
     entry->session = RedisModule_GetClientId(ctx);
     entry->type = RAFT_LOGTYPE_NORMAL;
+    raft_entry_id_t id = entry->id;
 
     int e = RedisRaftRecvEntry(rr, entry, req);
     if (e != 0) {
@@ -815,6 +989,7 @@ static void handleRedisCommandAppend(RedisRaftCtx *rr,
         return;
     }
     req->raft_idx = raft_get_current_idx(rr->raft);
+    RaftRecordAppendLatency(rr, req->raft_idx, id, &req, 1);
 }
 
 static void handleRedisCommand(RedisRaftCtx *rr,
@@ -872,6 +1047,15 @@ static int cmdRaft(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
         cmd->argv[i] = argv[i + 1];
         RedisModule_RetainString(ctx, cmd->argv[i]);
     }
+
+    /* Reuse the flags found by the command filter, if it intercepted this
+     * command. The subcommand is only set for commands with subcommands. */
+    if (argv[1] == rr->filter_cmd &&
+        (!rr->filter_subcmd || (argc > 2 && argv[2] == rr->filter_subcmd))) {
+        cmds.cmd_flags = rr->filter_flags != -1 ? (unsigned int) rr->filter_flags : CMD_SPEC_WRITE;
+        cmds.cmd_flags_valid = true;
+    }
+
     handleRedisCommand(rr, ctx, &cmds);
     RaftRedisCommandArrayFree(&cmds);
 
@@ -908,6 +1092,107 @@ static int cmdRaftEntry(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
     return REDISMODULE_OK;
 }
 
+static void freeAppendEntriesMsg(raft_appendentries_req_t *msg)
+{
+    if (msg->n_entries > 0) {
+        for (int i = 0; i < msg->n_entries; i++) {
+            raft_entry_t *e = msg->entries[i];
+            if (e) {
+                raft_entry_release(e);
+            }
+        }
+        RedisModule_Free(msg->entries);
+    }
+}
+
+static void replyAppendEntries(RedisModuleCtx *ctx, raft_appendentries_resp_t *resp)
+{
+    RedisModule_ReplyWithArray(ctx, 4);
+    RedisModule_ReplyWithLongLong(ctx, resp->term);
+    RedisModule_ReplyWithLongLong(ctx, resp->success);
+    RedisModule_ReplyWithLongLong(ctx, resp->current_idx);
+    RedisModule_ReplyWithLongLong(ctx, resp->msg_id);
+}
+
+/* Track the entries a successful appendreq message matched, so they can be
+ * acknowledged to the leader once they are fsync'd, see
+ * raftSendAppendEntriesAck().
+ */
+static void trackAppendEntriesAck(RedisRaftCtx *rr, raft_node_id_t leader_id,
+                                  raft_appendentries_resp_t *resp)
+{
+    AppendEntriesAck *ack = &rr->ae_ack;
+
+    if (ack->leader_id != leader_id || ack->term != resp->term) {
+        *ack = (AppendEntriesAck){
+            .leader_id = leader_id,
+            .term = resp->term,
+        };
+    }
+
+    ack->msg_id = MAX(ack->msg_id, resp->msg_id);
+    ack->match_idx = MAX(ack->match_idx, resp->current_idx);
+}
+
+/* Pass a decoded AppendEntries message to the Raft library and reply. Entries
+ * of the message are released.
+ *
+ * If log-fsync-follower-async is enabled and the leader supports RAFT.AEACK,
+ * new entries are only written to the log file here and fsync() is requested
+ * from fsyncThread, so the event loop does not block on the disk. The reply
+ * is sent right away, but a successful reply only acknowledges entries that
+ * are already fsync'd. The rest are acknowledged with a single RAFT.AEACK
+ * once fsync() covers them, so the leader connection is never blocked and
+ * one fsync() acknowledges every message received in the meantime.
+ */
+static void handleAppendEntries(RedisRaftCtx *rr, RedisModuleCtx *ctx,
+                                raft_node_id_t src_node_id,
+                                raft_appendentries_req_t *msg)
+{
+    rr->appendreq_received++;
+    rr->appendreq_with_entry_received += (msg->n_entries > 0) ? 1 : 0;
+
+    raft_appendentries_resp_t resp = {0};
+    raft_node_t *node = raft_get_node(rr->raft, src_node_id);
+    Node *leader = node ? raft_node_get_udata(node) : NULL;
+
+    rr->fsync_deferred = msg->n_entries > 0 &&
+                         rr->config.log_fsync &&
+                         rr->config.log_fsync_follower_async &&
+                         leader && leader->ae_ack;
+
+    int ret = raft_recv_appendentries(rr->raft, node, msg, &resp);
+    rr->fsync_deferred = false;
+
+    if (ret != 0) {
+        RedisModule_ReplyWithError(ctx, "ERR operation failed");
+        goto out;
+    }
+
+    if (resp.success) {
+        trackAppendEntriesAck(rr, src_node_id, &resp);
+
+        raft_index_t idx = LogCurrentIdx(&rr->log);
+        if (rr->config.log_fsync && idx > rr->log.fsync_index &&
+            idx > rr->fsync_requested_idx) {
+            RaftRequestLogFsync(rr, idx);
+        }
+
+        /* Entries that are not fsync'd yet are acknowledged later */
+        if (rr->config.log_fsync && resp.current_idx > rr->log.fsync_index) {
+            resp.current_idx = rr->log.fsync_index;
+            rr->appendreq_deferred++;
+        }
+
+        rr->ae_ack.acked_idx = MAX(rr->ae_ack.acked_idx, resp.current_idx);
+    }
+
+    replyAppendEntries(ctx, &resp);
+
+out:
+    freeAppendEntriesMsg(msg);
+}
+
 /* RAFT.AE [target_node_id] [src_node_id]
  *         [leader_id]:[term]:[prev_log_idx]:[prev_log_term]:[leader_commit]:[msg_id]
  *         [n_entries] [<term>:<id>:<session>:<type> <entry>]...
@@ -975,14 +1260,14 @@ static int cmdRaftAppendEntries(RedisModuleCtx *ctx, RedisModuleString **argv, i
 
     msg.n_entries = (int) n_entries;
     if (n_entries > 0) {
-        msg.entries = RedisModule_Calloc(n_entries, sizeof(raft_entry_t));
+        msg.entries = RedisModule_Calloc(n_entries, sizeof(raft_entry_t *));
     }
 
     for (int i = 0; i < n_entries; i++) {
-        /* Create entry with payload */
+        /* Create entry, referencing the payload argument rather than copying it */
         tmpstr = RedisModule_StringPtrLen(argv[6 + 2 * i], &tmplen);
-        raft_entry_t *e = raft_entry_new(tmplen);
-        memcpy(e->data, tmpstr, tmplen);
+        raft_entry_t *e = entryNewFromString(argv[6 + 2 * i], tmpstr, tmplen);
+        msg.entries[i] = e;
 
         /* Parse additional entry fields */
         tmpstr = RedisModule_StringPtrLen(argv[5 + 2 * i], &tmplen);
@@ -990,37 +1275,131 @@ static int cmdRaftAppendEntries(RedisModuleCtx *ctx, RedisModuleString **argv, i
             RedisModule_ReplyWithError(ctx, "invalid entry");
             goto out;
         }
-        msg.entries[i] = e;
     }
 
-    rr->appendreq_received++;
-    rr->appendreq_with_entry_received += (msg.n_entries > 0) ? 1 : 0;
+    handleAppendEntries(rr, ctx, src_node_id, &msg);
+    return REDISMODULE_OK;
 
-    raft_appendentries_resp_t resp = {0};
-    raft_node_t *node = raft_get_node(rr->raft, src_node_id);
+out:
+    freeAppendEntriesMsg(&msg);
+    return REDISMODULE_OK;
+}
 
-    if (raft_recv_appendentries(rr->raft, node, &msg, &resp) != 0) {
-        RedisModule_ReplyWithError(ctx, "ERR operation failed");
-        goto out;
+/* RAFT.AEBIN [target_node_id] [src_node_id] [message]
+ *
+ *   Same as RAFT.AE, using the binary message encoding described in
+ *   AppendEntriesSerializeBinary(). Nodes that don't recognize the command or
+ *   the encoding version reply with an error, which makes the leader fall back
+ *   to RAFT.AE.
+ * Reply:
+ *   Same as RAFT.AE.
+ */
+static int cmdRaftAppendEntriesBinary(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
+{
+    RedisRaftCtx *rr = &redis_raft;
+
+    if (argc != 4) {
+        RedisModule_WrongArity(ctx);
+        return REDISMODULE_OK;
     }
 
-    RedisModule_ReplyWithArray(ctx, 4);
-    RedisModule_ReplyWithLongLong(ctx, resp.term);
-    RedisModule_ReplyWithLongLong(ctx, resp.success);
-    RedisModule_ReplyWithLongLong(ctx, resp.current_idx);
-    RedisModule_ReplyWithLongLong(ctx, resp.msg_id);
+    if (checkRaftState(rr, ctx) == RR_ERROR) {
+        return REDISMODULE_OK;
+    }
 
-out:
-    if (msg.n_entries > 0) {
-        for (int i = 0; i < msg.n_entries; i++) {
-            raft_entry_t *e = msg.entries[i];
-            if (e) {
-                raft_entry_release(e);
-            }
+    int target_node_id;
+    if (RedisModuleStringToInt(argv[1], &target_node_id) == REDISMODULE_ERR ||
+        target_node_id != rr->config.id) {
+        RedisModule_ReplyWithError(ctx, "invalid or incorrect target node id");
+        return REDISMODULE_OK;
+    }
+
+    raft_node_id_t src_node_id;
+    if (RedisModuleStringToInt(argv[2], &src_node_id) == REDISMODULE_ERR) {
+        RedisModule_ReplyWithError(ctx, "invalid source node id");
+        return REDISMODULE_OK;
+    }
+
+    size_t len;
+    const char *buf = RedisModule_StringPtrLen(argv[3], &len);
+
+    raft_appendentries_req_t msg = {0};
+    if (AppendEntriesDeserializeBinary(&msg, buf, len, argv[3]) != RR_OK) {
+        RedisModule_ReplyWithError(ctx, "ERR unsupported RAFT.AEBIN message or version");
+        return REDISMODULE_OK;
+    }
+
+    handleAppendEntries(rr, ctx, src_node_id, &msg);
+    return REDISMODULE_OK;
+}
+
+/* RAFT.AEACK [target_node_id] [src_node_id] [term] [current_idx] [msg_id]
+ *
+ *   A follower acknowledges entries up to current_idx once they are fsync'd,
+ *   after replying to the appendreq messages that carried them. It is
+ *   handled like a successful reply to appendreq message msg_id, see
+ *   handleAppendEntries().
+ * Reply:
+ *   -NOCLUSTER ||
+ *   -LOADING ||
+ *   +OK
+ */
+static int cmdRaftAppendEntriesAck(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
+{
+    RedisRaftCtx *rr = &redis_raft;
+
+    if (argc != 6) {
+        RedisModule_WrongArity(ctx);
+        return REDISMODULE_OK;
+    }
+
+    if (checkRaftState(rr, ctx) == RR_ERROR) {
+        return REDISMODULE_OK;
+    }
+
+    int target_node_id;
+    if (RedisModuleStringToInt(argv[1], &target_node_id) == REDISMODULE_ERR ||
+        target_node_id != rr->config.id) {
+        RedisModule_ReplyWithError(ctx, "invalid or incorrect target node id");
+        return REDISMODULE_OK;
+    }
+
+    raft_node_id_t src_node_id;
+    if (RedisModuleStringToInt(argv[2], &src_node_id) == REDISMODULE_ERR) {
+        RedisModule_ReplyWithError(ctx, "invalid source node id");
+        return REDISMODULE_OK;
+    }
+
+    long long term, current_idx, msg_id;
+    if (RedisModule_StringToLongLong(argv[3], &term) != REDISMODULE_OK ||
+        RedisModule_StringToLongLong(argv[4], &current_idx) != REDISMODULE_OK ||
+        RedisModule_StringToLongLong(argv[5], &msg_id) != REDISMODULE_OK) {
+        RedisModule_ReplyWithError(ctx, "invalid message");
+        return REDISMODULE_OK;
+    }
+
+    raft_appendentries_resp_t resp = {
+        .term = term,
+        .success = 1,
+        .current_idx = current_idx,
+        .msg_id = msg_id,
+    };
+
+    raft_node_t *raft_node = raft_get_node(rr->raft, src_node_id);
+    if (raft_node && raft_is_leader(rr->raft) &&
+        resp.term == raft_get_current_term(rr->raft)) {
+        Node *node = raft_node_get_udata(raft_node);
+        if (node) {
+            node->match_idx = MAX(node->match_idx, resp.current_idx);
+        }
+
+        int ret = raft_recv_appendentries_response(rr->raft, raft_node, &resp);
+        if (ret != 0) {
+            LOG_VERBOSE("raft_recv_appendentries_response failed, error %d", ret);
         }
-        RedisModule_Free(msg.entries);
     }
 
+    RedisModule_ReplyWithSimpleString(ctx, "OK");
     return REDISMODULE_OK;
 }
 
@@ -1217,7 +1596,7 @@ static int cmdRaftCluster(RedisModuleCtx *ctx, RedisModuleString **argv, int arg
         clusterInit(cluster_id);
 
         char reply[RAFT_DBID_LEN + 260];
-        snprintf(reply, sizeof(reply) - 1, "OK %s", rr->snapshot_info.dbid);
+        snprintf(reply, sizeof(reply) - 1, "OK %.*s", RAFT_DBID_LEN, rr->snapshot_info.dbid);
 
         RedisModule_ReplyWithSimpleString(ctx, reply);
     } else if (!strncasecmp(cmd, "JOIN", cmd_len)) {
@@ -1470,8 +1849,7 @@ static int cmdRaftDebug(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
             RedisModule_FreeCallReply(reply);
         }
     } else if (!strncasecmp(cmd, "commandspec", cmdlen) && argc == 3) {
-        int flags = CommandSpecTableGetFlags(redis_raft.commands_spec_table, redis_raft.subcommand_spec_tables, argv[2],
-                                             NULL);
+        int flags = CommandSpecTableGetFlags(redis_raft.commands_spec_table, argv[2], NULL);
         if (flags == -1) {
             RedisModule_ReplyWithError(ctx, "ERR unknown command");
         } else {
@@ -1573,6 +1951,172 @@ static int cmdRaftRejectSubscribe(RedisModuleCtx *ctx, RedisModuleString **argv,
     return REDISMODULE_OK;
 }
 
+/* RAFT.LATENCY [RESET]
+ *   Returns latency statistics of the stages of a write, in microseconds:
+ *     append:    Request received -> entry appended to the log
+ *     fsync:     fsync() of the log file
+ *     replicate: Entry appended -> first sent to a follower
+ *     commit:    Entry appended -> committed, about to be applied
+ *     apply:     Execution of an entry
+ *     total:     Request received -> reply
+ *   If RESET is specified, the statistics are reset instead.
+ * Reply:
+ *   A map of stage names to maps of count, avg, p50, p90, p99, p99.9 and max
+ *   values, or +OK for RESET.
+ */
+static int cmdRaftLatency(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
+{
+    RedisRaftCtx *rr = &redis_raft;
+
+    if (argc > 2) {
+        RedisModule_WrongArity(ctx);
+        return REDISMODULE_OK;
+    }
+
+    if (argc == 2) {
+        size_t len;
+        const char *str = RedisModule_StringPtrLen(argv[1], &len);
+
+        if (len != strlen("reset") || strncasecmp(str, "reset", len) != 0) {
+            RedisModule_ReplyWithError(ctx, "ERR unknown RAFT.LATENCY subcommand");
+            return REDISMODULE_OK;
+        }
+
+        LatencyReset(&rr->latency);
+        RedisModule_ReplyWithSimpleString(ctx, "OK");
+        return REDISMODULE_OK;
+    }
+
+    LatencyReply(ctx, &rr->latency);
+    return REDISMODULE_OK;
+}
+
+/* Returns the number of entries the node is missing, only known on the
+ * leader. */
+static long long nodeLagEntries(RedisRaftCtx *rr, Node *node)
+{
+    if (!rr->raft || !raft_is_leader(rr->raft)) {
+        return 0;
+    }
+
+    raft_index_t current = raft_get_current_idx(rr->raft);
+    return current > node->match_idx ? current - node->match_idx : 0;
+}
+
+/* Returns the size of the log entries the node is missing, only known on the
+ * leader. */
+static size_t nodeLagBytes(RedisRaftCtx *rr, Node *node)
+{
+    if (!nodeLagEntries(rr, node)) {
+        return 0;
+    }
+
+    return LogBytesAfter(&rr->log, node->match_idx);
+}
+
+/* RAFT.NODESTATS
+ *   Returns replication statistics of the other nodes, to detect slow nodes
+ *   before they fall behind the log and require a snapshot:
+ *     match_idx:        Last index the node acknowledged to have in its log
+ *     lag_entries:      Number of entries the node is missing (leader only)
+ *     lag_bytes:        Size of the entries the node is missing (leader only)
+ *     inflight_msgs:    Raft requests waiting for a response
+ *     inflight_bytes:   Payload size of the requests waiting for a response
+ *     rtt_p50/p90/p99/max: Round-trip time of recent Raft requests (us)
+ *     ae_msgs:          appendreq messages sent with at least one entry
+ *     ae_entries:       Entries sent in appendreq messages
+ *     ae_batch_entries: Entries per appendreq message distribution
+ *     ae_window:        Current max in-flight messages, see NodeUpdateFlowControl()
+ *     ae_batch_size:    Current max appendreq message size
+ *     snapshot_offset:  Bytes of the last snapshot the node acknowledged
+ *     snapshot_size:    Size of the last snapshot sent to the node
+ *     snapshots_sent:   Number of snapshots delivered to the node
+ * Reply:
+ *   An array of maps, one per node.
+ */
+static int cmdRaftNodeStats(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
+{
+    (void) argv;
+    RedisRaftCtx *rr = &redis_raft;
+
+    if (argc != 1) {
+        RedisModule_WrongArity(ctx);
+        return REDISMODULE_OK;
+    }
+
+    if (checkRaftState(rr, ctx) == RR_ERROR) {
+        return REDISMODULE_OK;
+    }
+
+    int count = 0;
+    RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_LEN);
+
+    for (int i = 0; i < raft_get_num_nodes(rr->raft); i++) {
+        Node *n = raft_node_get_udata(raft_get_node_from_idx(rr->raft, i));
+        if (!n) {
+            continue;
+        }
+
+        RedisModule_ReplyWithMap(ctx, 19);
+        RedisModule_ReplyWithCString(ctx, "id");
+        RedisModule_ReplyWithLongLong(ctx, n->id);
+        RedisModule_ReplyWithCString(ctx, "state");
+        RedisModule_ReplyWithCString(ctx, ConnGetStateStr(n->conn));
+        RedisModule_ReplyWithCString(ctx, "match_idx");
+        RedisModule_ReplyWithLongLong(ctx, n->match_idx);
+        RedisModule_ReplyWithCString(ctx, "lag_entries");
+        RedisModule_ReplyWithLongLong(ctx, nodeLagEntries(rr, n));
+        RedisModule_ReplyWithCString(ctx, "lag_bytes");
+        RedisModule_ReplyWithLongLong(ctx, (long long) nodeLagBytes(rr, n));
+        RedisModule_ReplyWithCString(ctx, "inflight_msgs");
+        RedisModule_ReplyWithLongLong(ctx, n->pending_raft_response_num);
+        RedisModule_ReplyWithCString(ctx, "inflight_bytes");
+        RedisModule_ReplyWithLongLong(ctx, (long long) n->pending_raft_bytes);
+        RedisModule_ReplyWithCString(ctx, "rtt_p50");
+        RedisModule_ReplyWithLongLong(ctx, (long long) NodeRttPercentile(n, 50));
+        RedisModule_ReplyWithCString(ctx, "rtt_p90");
+        RedisModule_ReplyWithLongLong(ctx, (long long) NodeRttPercentile(n, 90));
+        RedisModule_ReplyWithCString(ctx, "rtt_p99");
+        RedisModule_ReplyWithLongLong(ctx, (long long) NodeRttPercentile(n, 99));
+        RedisModule_ReplyWithCString(ctx, "rtt_max");
+        RedisModule_ReplyWithLongLong(ctx, (long long) NodeRttPercentile(n, 100));
+        RedisModule_ReplyWithCString(ctx, "ae_msgs");
+        RedisModule_ReplyWithLongLong(ctx, (long long) n->ae_sent);
+        RedisModule_ReplyWithCString(ctx, "ae_entries");
+        RedisModule_ReplyWithLongLong(ctx, (long long) n->ae_entries_sent);
+
+        RedisModule_ReplyWithCString(ctx, "ae_batch_entries");
+        RedisModule_ReplyWithMap(ctx, NODE_AE_BATCH_BUCKETS);
+        for (int j = 0; j < NODE_AE_BATCH_BUCKETS; j++) {
+            char name[32];
+
+            if (j < NODE_AE_BATCH_BUCKETS - 1) {
+                snprintf(name, sizeof(name), "le_%llu", 1ull << j);
+            } else {
+                snprintf(name, sizeof(name), "gt_%llu", 1ull << (j - 1));
+            }
+            RedisModule_ReplyWithCString(ctx, name);
+            RedisModule_ReplyWithLongLong(ctx, (long long) n->ae_batch_hist[j]);
+        }
+
+        RedisModule_ReplyWithCString(ctx, "ae_window");
+        RedisModule_ReplyWithLongLong(ctx, NodeAppendWindow(n));
+        RedisModule_ReplyWithCString(ctx, "ae_batch_size");
+        RedisModule_ReplyWithLongLong(ctx, NodeAppendBatchSize(n));
+
+        RedisModule_ReplyWithCString(ctx, "snapshot_offset");
+        RedisModule_ReplyWithLongLong(ctx, (long long) n->snapshot_offset);
+        RedisModule_ReplyWithCString(ctx, "snapshot_size");
+        RedisModule_ReplyWithLongLong(ctx, (long long) n->snapshot_size);
+        RedisModule_ReplyWithCString(ctx, "snapshots_sent");
+        RedisModule_ReplyWithLongLong(ctx, (long long) n->snapshots_sent);
+        count++;
+    }
+
+    RedisModule_ReplySetArrayLength(ctx, count);
+    return REDISMODULE_OK;
+}
+
 static int cmdRaftScan(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
 {
     RedisRaftCtx *rr = &redis_raft;
@@ -1699,6 +2243,31 @@ void handleClientEvent(RedisModuleCtx *ctx, RedisModuleEvent eid,
     }
 }
 
+/* Remember the flags of an intercepted command, so cmdRaft() can use them.
+ * The strings are retained, so their address cannot be reused by another
+ * command until the next one is intercepted. subcmd is NULL unless the command
+ * has subcommands.
+ */
+static void setFilterFlags(RedisRaftCtx *rr, RedisModuleString *cmd,
+                           RedisModuleString *subcmd, int flags)
+{
+    if (rr->filter_cmd) {
+        RedisModule_FreeString(NULL, rr->filter_cmd);
+    }
+    if (rr->filter_subcmd) {
+        RedisModule_FreeString(NULL, rr->filter_subcmd);
+    }
+
+    rr->filter_cmd = cmd;
+    rr->filter_subcmd = subcmd;
+    rr->filter_flags = flags;
+
+    RedisModule_RetainString(NULL, cmd);
+    if (subcmd) {
+        RedisModule_RetainString(NULL, subcmd);
+    }
+}
+
 /* Command filter callback that intercepts normal Redis commands and prefixes them
  * with a RAFT command prefix in order to divert them to execute inside RedisRaft.
  */
@@ -1716,7 +2285,7 @@ static void interceptRedisCommands(RedisModuleCommandFilterCtx *filter)
         /* if we are running a command in lua that has to be sorted to be deterministic across all nodes */
         if (rr->entered_eval) {
             int flags;
-            if ((flags = CommandSpecTableGetFlags(rr->commands_spec_table, rr->subcommand_spec_tables, cmd, subcmd)) != -1) {
+            if ((flags = CommandSpecTableGetFlags(rr->commands_spec_table, cmd, subcmd)) != -1) {
                 if (flags & CMD_SPEC_SORT_REPLY) {
                     s = RedisModule_CreateString(NULL, "RAFT._SORT_REPLY", 16);
                     RedisModule_CommandFilterArgInsert(filter, 0, s);
@@ -1730,7 +2299,15 @@ static void interceptRedisCommands(RedisModuleCommandFilterCtx *filter)
         return;
     }
 
-    int flags = CommandSpecTableGetFlags(rr->commands_spec_table, rr->subcommand_spec_tables, cmd, subcmd);
+    /* Only commands with subcommands depend on argv[1], it is usually a key
+     * otherwise and should not be retained by setFilterFlags() */
+    int flags = CommandSpecTableGetFlags(rr->commands_spec_table, cmd, NULL);
+    if (flags != -1 && (flags & CMD_SPEC_SUBCOMMAND) && subcmd) {
+        flags = CommandSpecTableGetFlags(rr->commands_spec_table, cmd, subcmd);
+    } else {
+        subcmd = NULL;
+    }
+
     if (flags != -1 && (flags & CMD_SPEC_DONT_INTERCEPT))
         return;
 
@@ -1748,6 +2325,8 @@ static void interceptRedisCommands(RedisModuleCommandFilterCtx *filter)
         return;
     }
 
+    setFilterFlags(rr, cmd, subcmd, flags);
+
     /* Prepend RAFT to the original command */
     RedisModuleString *raft_str = RedisModule_CreateString(NULL, "RAFT", 4);
     RedisModule_CommandFilterArgInsert(filter, 0, raft_str);
@@ -1804,6 +2383,7 @@ static void handleInfo(RedisModuleInfoCtx *ctx, int for_crash_report)
         RedisModule_InfoBeginDictField(ctx, name);
         RedisModule_InfoAddFieldLongLong(ctx, "id", n->id);
         RedisModule_InfoAddFieldCString(ctx, "state", ConnGetStateStr(n->conn));
+        RedisModule_InfoAddFieldCString(ctx, "priority_state", ConnGetStateStr(n->priority_conn));
         RedisModule_InfoAddFieldCString(ctx, "voting", raft_node_is_voting(rn) ? "yes" : "no");
         RedisModule_InfoAddFieldCString(ctx, "addr", n->addr.host);
         RedisModule_InfoAddFieldULongLong(ctx, "port", n->addr.port);
@@ -1816,6 +2396,17 @@ static void handleInfo(RedisModuleInfoCtx *ctx, int for_crash_report)
 
         RedisModule_InfoAddFieldULongLong(ctx, "conn_errors", n->conn->connect_errors);
         RedisModule_InfoAddFieldULongLong(ctx, "conn_oks", n->conn->connect_oks);
+        RedisModule_InfoAddFieldULongLong(ctx, "cache_hits", n->cache_hits);
+        RedisModule_InfoAddFieldULongLong(ctx, "cache_misses", n->cache_misses);
+        RedisModule_InfoAddFieldLongLong(ctx, "lag_entries", nodeLagEntries(rr, n));
+        RedisModule_InfoAddFieldULongLong(ctx, "lag_bytes", nodeLagBytes(rr, n));
+        RedisModule_InfoAddFieldLongLong(ctx, "inflight_msgs", n->pending_raft_response_num);
+        RedisModule_InfoAddFieldULongLong(ctx, "inflight_bytes", n->pending_raft_bytes);
+        RedisModule_InfoAddFieldULongLong(ctx, "rtt_p50_microseconds", NodeRttPercentile(n, 50));
+        RedisModule_InfoAddFieldULongLong(ctx, "rtt_p99_microseconds", NodeRttPercentile(n, 99));
+        RedisModule_InfoAddFieldULongLong(ctx, "ae_avg_entries", n->ae_sent ? n->ae_entries_sent / n->ae_sent : 0);
+        RedisModule_InfoAddFieldULongLong(ctx, "snapshot_offset", n->snapshot_offset);
+        RedisModule_InfoAddFieldULongLong(ctx, "snapshot_size", n->snapshot_size);
         RedisModule_InfoEndDictField(ctx);
     }
 
@@ -1825,8 +2416,12 @@ static void handleInfo(RedisModuleInfoCtx *ctx, int for_crash_report)
     RedisModule_InfoAddFieldLongLong(ctx, "commit_index", rr->raft ? raft_get_commit_idx(rr->raft) : 0);
     RedisModule_InfoAddFieldLongLong(ctx, "last_applied_index", rr->raft ? raft_get_last_applied_idx(rr->raft) : 0);
     RedisModule_InfoAddFieldULongLong(ctx, "file_size", LogFileSize(&rr->log));
+    RedisModule_InfoAddFieldLongLong(ctx, "segments", LogSegmentCount(&rr->log));
     RedisModule_InfoAddFieldULongLong(ctx, "cache_memory_size", rr->logcache ? rr->logcache->entries_memsize : 0);
     RedisModule_InfoAddFieldLongLong(ctx, "cache_entries", rr->logcache ? rr->logcache->len : 0);
+    RedisModule_InfoAddFieldULongLong(ctx, "cache_hits", rr->logcache ? rr->logcache->hits : 0);
+    RedisModule_InfoAddFieldULongLong(ctx, "cache_misses", rr->logcache ? rr->logcache->misses : 0);
+    RedisModule_InfoAddFieldULongLong(ctx, "cache_pinned_evictions", rr->logcache ? rr->logcache->pinned_evictions : 0);
     RedisModule_InfoAddFieldULongLong(ctx, "client_attached_entries", rr->client_attached_entries);
     RedisModule_InfoAddFieldULongLong(ctx, "fsync_count", rr->log.fsync_count);
     RedisModule_InfoAddFieldULongLong(ctx, "fsync_max_microseconds", rr->log.fsync_max);
@@ -1837,6 +2432,26 @@ static void handleInfo(RedisModuleInfoCtx *ctx, int for_crash_report)
     }
     RedisModule_InfoAddFieldULongLong(ctx, "fsync_avg_microseconds", avg);
 
+    uint64_t avg_batch = 0;
+    if (rr->log.fsync_count) {
+        avg_batch = rr->log.fsync_entries / rr->log.fsync_count;
+    }
+    RedisModule_InfoAddFieldULongLong(ctx, "fsync_avg_batch_entries", avg_batch);
+    RedisModule_InfoAddFieldULongLong(ctx, "fsync_max_batch_entries", rr->log.fsync_batch_max);
+
+    RedisModule_InfoBeginDictField(ctx, "fsync_batch_entries");
+    for (int i = 0; i < LOG_FSYNC_BATCH_BUCKETS; i++) {
+        char name[32];
+
+        if (i < LOG_FSYNC_BATCH_BUCKETS - 1) {
+            snprintf(name, sizeof(name), "le_%llu", 1ull << i);
+        } else {
+            snprintf(name, sizeof(name), "gt_%llu", 1ull << (i - 1));
+        }
+        RedisModule_InfoAddFieldULongLong(ctx, name, rr->log.fsync_batch_hist[i]);
+    }
+    RedisModule_InfoEndDictField(ctx);
+
     RedisModule_InfoAddSection(ctx, "snapshot");
     RedisModule_InfoAddFieldCString(ctx, "snapshot_filename", rr->config.rdb_filename);
     RedisModule_InfoAddFieldULongLong(ctx, "snapshot_last_idx", rr->raft ? raft_get_snapshot_last_idx(rr->raft) : 0);
@@ -1864,8 +2479,17 @@ static void handleInfo(RedisModuleInfoCtx *ctx, int for_crash_report)
     RedisModule_InfoAddSection(ctx, "stats");
     RedisModule_InfoAddFieldULongLong(ctx, "appendreq_received", rr->appendreq_received);
     RedisModule_InfoAddFieldULongLong(ctx, "appendreq_with_entry_received", rr->appendreq_with_entry_received);
+    RedisModule_InfoAddFieldULongLong(ctx, "appendreq_deferred", rr->appendreq_deferred);
     RedisModule_InfoAddFieldULongLong(ctx, "snapshotreq_received", rr->snapshotreq_received);
     RedisModule_InfoAddFieldULongLong(ctx, "exec_throttled", rr->exec_throttled);
+    RedisModule_InfoAddFieldULongLong(ctx, "lease_reads", rr->lease_reads);
+    RedisModule_InfoAddFieldULongLong(ctx, "follower_reads", rr->follower_reads);
+    RedisModule_InfoAddFieldULongLong(ctx, "write_batches", rr->write_batches);
+    RedisModule_InfoAddFieldULongLong(ctx, "write_batch_requests", rr->write_batch_requests);
+    RedisModule_InfoAddFieldULongLong(ctx, "compressed_entries", rr->compressed_entries);
+    RedisModule_InfoAddFieldULongLong(ctx, "compression_saved_bytes", rr->compression_saved_bytes);
+    RedisModule_InfoAddFieldULongLong(ctx, "cmd_checks_cached", rr->cmd_checks_cached);
+    RedisModule_InfoAddFieldULongLong(ctx, "cmd_checks_dry_run", rr->cmd_checks_dry_run);
     RedisModule_InfoAddFieldULongLong(ctx, "num_sessions", RedisModule_DictSize(rr->client_session_dict));
 }
 
@@ -1907,6 +2531,16 @@ static int registerRaftCommands(RedisModuleCtx *ctx)
         return REDISMODULE_ERR;
     }
 
+    if (RedisModule_CreateCommand(ctx, "raft.aebin", cmdRaftAppendEntriesBinary,
+                                  "write", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "raft.aeack", cmdRaftAppendEntriesAck,
+                                  "write", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
     if (RedisModule_CreateCommand(ctx, "raft.transfer_leader",
                                   cmdRaftTransferLeader,
                                   "admin", 0, 0, 0) == REDISMODULE_ERR) {
@@ -1918,6 +2552,11 @@ static int registerRaftCommands(RedisModuleCtx *ctx)
         return REDISMODULE_ERR;
     }
 
+    if (RedisModule_CreateCommand(ctx, "raft.readindex", cmdRaftReadIndex,
+                                  "admin", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
     if (RedisModule_CreateCommand(ctx, "raft.requestvote", cmdRaftRequestVote,
                                   "admin", 0, 0, 0) == REDISMODULE_ERR) {
         return REDISMODULE_ERR;
@@ -1965,6 +2604,16 @@ static int registerRaftCommands(RedisModuleCtx *ctx)
         return REDISMODULE_ERR;
     }
 
+    if (RedisModule_CreateCommand(ctx, "raft.latency", cmdRaftLatency,
+                                  "admin", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
+    if (RedisModule_CreateCommand(ctx, "raft.nodestats", cmdRaftNodeStats,
+                                  "admin", 0, 0, 0) == REDISMODULE_ERR) {
+        return REDISMODULE_ERR;
+    }
+
     RedisRaftType = RedisModule_CreateDataType(ctx, REDIS_RAFT_DATATYPE_NAME,
                                                REDIS_RAFT_DATATYPE_ENCVER,
                                                &RedisRaftTypeMethods);
@@ -1981,6 +2630,7 @@ void moduleChangeCallback(RedisModuleCtx *ctx, RedisModuleEvent e, uint64_t sub,
 
     /* rebuild the command spec table on any module change */
     CommandSpecTableRebuild(redis_raft.ctx, redis_raft.commands_spec_table, redis_raft.config.ignored_commands);
+    CommandCheckCacheReset(&redis_raft);
 }
 
 RRStatus RedisRaftCtxInit(RedisRaftCtx *rr, RedisModuleCtx *ctx)
@@ -1988,6 +2638,7 @@ RRStatus RedisRaftCtxInit(RedisRaftCtx *rr, RedisModuleCtx *ctx)
     *rr = (RedisRaftCtx){
         .state = REDIS_RAFT_UNINITIALIZED,
         .ctx = RedisModule_GetDetachedThreadSafeContext(ctx),
+        .vote_epoch = RedisModule_MonotonicMicroseconds(),
     };
 
     sc_crc32_init();
@@ -1995,7 +2646,7 @@ RRStatus RedisRaftCtxInit(RedisRaftCtx *rr, RedisModuleCtx *ctx)
     sc_list_init(&rr->connections);
 
     CommandSpecTableInit(rr->ctx, &rr->commands_spec_table);
-    SubCommandsSpecTableInit(rr->ctx, &rr->subcommand_spec_tables);
+    CommandCheckCacheReset(rr);
 
     if (ConfigInit(rr->ctx, &rr->config) != RR_OK) {
         LOG_WARNING("Failed to init configuration");
@@ -2009,6 +2660,7 @@ RRStatus RedisRaftCtxInit(RedisRaftCtx *rr, RedisModuleCtx *ctx)
     /* setup blocked command state */
     rr->blocked_command_dict = RedisModule_CreateDict(rr->ctx);
     sc_list_init(&rr->blocked_command_list);
+    sc_list_init(&rr->follower_read_list);
 
     /* acl -> user dictionary */
     rr->acl_dict = RedisModule_CreateDict(rr->ctx);
@@ -2046,6 +2698,7 @@ RRStatus RedisRaftCtxInit(RedisRaftCtx *rr, RedisModuleCtx *ctx)
     RedisModule_CreateTimer(rr->ctx, rr->config.reconnect_interval, callHandleNodeStates, rr);
     threadPoolInit(&rr->thread_pool, 5);
     fsyncThreadStart(&rr->fsyncThread, handleFsyncCompleted);
+    snapshotWriterStart(&rr->snapshot_writer, SNAPSHOT_WRITER_MAX_QUEUED);
 
     return RR_OK;
 
@@ -2124,11 +2777,18 @@ void RedisRaftCtxClear(RedisRaftCtx *rr)
         rr->client_session_dict = NULL;
     }
 
-    if (rr->subcommand_spec_tables) {
-        FreeSubCommandSpecTables(rr, rr->subcommand_spec_tables);
+    if (rr->filter_cmd) {
+        RedisModule_FreeString(NULL, rr->filter_cmd);
+        rr->filter_cmd = NULL;
+    }
+    if (rr->filter_subcmd) {
+        RedisModule_FreeString(NULL, rr->filter_subcmd);
+        rr->filter_subcmd = NULL;
     }
 
     CommandSpecTableClear(rr->commands_spec_table);
+    CommandCheckCacheFree(rr);
+    ArenaFree(&rr->apply_arena);
 }
 
 void RedisRaftFreeGlobals()
@@ -255,6 +255,50 @@ typedef struct RaftSnapshotInfo {
     NodeIdEntry *used_node_ids; /* All node ids that are, or have ever been, part of this cluster */
 } RaftSnapshotInfo;
 
+/* Arena for objects freed together, see ArenaAlloc() */
+typedef struct Arena {
+    char *buf;                 /* Buffer allocations are served from */
+    size_t size;               /* Size of buf */
+    size_t used;               /* Bytes of buf in use */
+    size_t peak;               /* Bytes allocated since last reset, including chunks */
+    struct ArenaChunk *chunks; /* Allocations that did not fit into buf */
+} Arena;
+
+/* Write stages measured by the latency histograms, see RAFT.LATENCY */
+typedef enum LatencyStage {
+    LATENCY_APPEND,    /* Request received -> entry appended to the log */
+    LATENCY_FSYNC,     /* fsync() of the log file */
+    LATENCY_REPLICATE, /* Entry appended -> first sent to a follower */
+    LATENCY_COMMIT,    /* Entry appended -> committed, about to be applied */
+    LATENCY_APPLY,     /* Execution of an entry */
+    LATENCY_TOTAL,     /* Request received -> reply */
+    LATENCY_STAGE_COUNT
+} LatencyStage;
+
+#define LATENCY_SUB_BITS        3
+#define LATENCY_BUCKETS         ((64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+#define LATENCY_TRACKED_ENTRIES 4096
+
+typedef struct LatencyHistogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[LATENCY_BUCKETS];
+} LatencyHistogram;
+
+/* Append time of an entry created by the leader */
+typedef struct LatencyEntry {
+    raft_index_t idx;
+    raft_entry_id_t id;
+    bool sent;     /* Entry was sent to a follower */
+    uint64_t time; /* Monotonic time (us) the entry was appended */
+} LatencyEntry;
+
+typedef struct LatencyStats {
+    LatencyHistogram stages[LATENCY_STAGE_COUNT];
+    LatencyEntry entries[LATENCY_TRACKED_ENTRIES]; /* Recent entries, by index */
+} LatencyStats;
+
 typedef struct SnapshotFile {
     void *mmap;
     size_t len;
@@ -284,6 +328,7 @@ void threadPoolShutdown(ThreadPool *pool);
 
 typedef struct FsyncThreadResult {
     raft_index_t fsync_index;
+    uint64_t request_id;
     uint64_t time;
 } FsyncThreadResult;
 
@@ -298,6 +343,9 @@ typedef struct FsyncThread {
 
     int fd;
     raft_index_t requested_index;
+    uint64_t requested_id; /* Incremented on each fsyncThreadAddTask() call */
+    int *files;            /* Files to fsync() and close before fd, see fsyncThreadAddFile() */
+    int num_files;
 
     void (*on_complete)(void *result);
 
@@ -305,8 +353,37 @@ typedef struct FsyncThread {
 
 void fsyncThreadStart(FsyncThread *th, void (*on_complete)(void *result));
 void fsyncThreadAddTask(FsyncThread *th, int fd, raft_index_t requested_index);
+void fsyncThreadAddFile(FsyncThread *th, int fd);
 void fsyncThreadWaitUntilCompleted(FsyncThread *th);
 
+/* snapshot_writer.c */
+#define SNAPSHOT_WRITER_MAX_QUEUED 16
+
+typedef struct SnapshotWriter {
+    pthread_t id;
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;      /* Signaled when a chunk is queued */
+    pthread_cond_t done_cond; /* Signaled when a chunk is written */
+
+    int fd;                          /* Incoming snapshot file, -1 if closed */
+    struct SnapshotWriterChunk *head; /* Queued chunks */
+    struct SnapshotWriterChunk *tail;
+    int queued;                      /* Number of queued chunks */
+    int max_queued;                  /* Queue depth limit */
+    bool busy;                       /* Writer thread is writing a chunk */
+    int err;                         /* errno of the first failed write */
+    raft_size_t end;                 /* End offset of the queued data */
+    raft_size_t allocated;           /* Preallocated file size */
+    raft_size_t flushed;             /* Data up to this offset is queued for writeback */
+} SnapshotWriter;
+
+void snapshotWriterStart(SnapshotWriter *w, int max_queued);
+int snapshotWriterOpen(SnapshotWriter *w, const char *path, bool truncate);
+bool snapshotWriterIsOpen(SnapshotWriter *w);
+int snapshotWriterAdd(SnapshotWriter *w, raft_size_t offset, const void *data, raft_size_t len);
+int snapshotWriterFinish(SnapshotWriter *w);
+void snapshotWriterDiscard(SnapshotWriter *w);
+
 typedef enum {
     DEBUG_MIGRATION_NONE = 0,
     DEBUG_MIGRATION_EMULATE_CONNECT_FAILED,
@@ -323,6 +400,8 @@ typedef struct RedisRaftConfig {
     char *log_filename;     /* Raft log file name, derived from dbfilename */
     bool follower_proxy;    /* Do follower nodes proxy requests to leader? */
     bool quorum_reads;      /* Reads have to go through quorum */
+    bool lease_reads;       /* Leader serves quorum reads locally while its lease is valid */
+    bool follower_reads;    /* Followers serve reads locally using a read index from the leader */
     char *ignored_commands; /* Comma delimited list of commands that should not be intercepted */
     char *cluster_user;     /* ACL user to use for internode communication */
     char *cluster_password; /* Password used for internode communication */
@@ -331,6 +410,7 @@ typedef struct RedisRaftConfig {
     int periodic_interval;            /* raft_periodic() interval */
     int request_timeout;              /* Milliseconds before sending a heartbeat message to the followers */
     int election_timeout;             /* Milliseconds before starting an election if there is no leader */
+    int lease_clock_drift;            /* Clock drift allowance, percent of election_timeout deducted from leader lease */
     int connection_timeout;           /* Milliseconds the node will continue to try connecting to another node */
     int join_timeout;                 /* Milliseconds the node will continue to try joining a cluster */
     int reconnect_interval;           /* Milliseconds to wait to reconnect to a node if connection drops */
@@ -353,8 +433,16 @@ typedef struct RedisRaftConfig {
 
     /* Cache and file compaction */
     unsigned long log_max_cache_size; /* The memory limit for the in-memory Raft log cache */
+    unsigned long log_max_cache_pinned_size; /* The memory limit for entries still needed by followers */
     unsigned long log_max_file_size;  /* The maximum desired Raft log file size in bytes */
+    long long log_max_file_size_percentage; /* Raise log_max_file_size to this percentage of the snapshot size, 0 to disable */
+    unsigned long log_segment_size;   /* Start a new Raft log segment once the current one exceeds this size */
     bool log_fsync;                   /* Call fsync() for the raft log file */
+    long long log_fsync_delay;        /* Max microseconds to delay fsync() to coalesce appends, 0 to disable */
+    long long log_fsync_pending_bytes; /* Request fsync() early once this many bytes are pending */
+    bool log_fsync_follower_async;    /* Followers fsync() in fsyncThread and acknowledge entries with RAFT.AEACK */
+    long long write_batch_max_requests; /* Max client writes coalesced into a single entry, 0 to disable */
+    unsigned long log_compression_threshold; /* Compress entries of at least this many bytes, 0 to disable */
 
     /* Cluster mode */
     bool sharding;                  /* Are we running in a sharding configuration? */
@@ -371,6 +459,17 @@ typedef struct RedisRaftConfig {
 
 } RedisRaftConfig;
 
+/* Follower state for acknowledging appended entries to the leader once they
+ * are fsync'd, see handleAppendEntries().
+ */
+typedef struct AppendEntriesAck {
+    raft_node_id_t leader_id; /* Leader to acknowledge to */
+    raft_term_t term;         /* Term of the leader */
+    raft_msg_id_t msg_id;     /* Latest appendreq message accepted from the leader */
+    raft_index_t match_idx;   /* Last index known to match the leader's log */
+    raft_index_t acked_idx;   /* Last index acknowledged to the leader */
+} AppendEntriesAck;
+
 /* Global Raft context */
 typedef struct RedisRaftCtx {
     void *raft;                    /* Raft library context */
@@ -379,6 +478,16 @@ typedef struct RedisRaftCtx {
     RedisRaftState state;          /* Raft module state */
     ThreadPool thread_pool;        /* Thread pool for slow operations */
     FsyncThread fsyncThread;       /* Thread to call fsync on raft log file */
+    raft_index_t fsync_requested_idx; /* Last index handed to fsyncThread */
+    uint64_t fsync_requested_bytes;   /* Log bytes_written when fsync_requested_idx was handed */
+    uint64_t fsync_pending_since;     /* Monotonic time (us) new entries started waiting for fsync */
+    bool fsync_timer_set;             /* Group commit timer is pending */
+    bool fsync_deferred;              /* Log sync is left to fsyncThread, see handleAppendEntries() */
+    AppendEntriesAck ae_ack;          /* Entries to acknowledge to the leader once fsync'd */
+    uint64_t fsync_stale_id;          /* fsync() requests up to this id may not cover the current log */
+    uint64_t lease_epoch;             /* Monotonic time (us), requests sent earlier do not extend the leader lease */
+    uint64_t vote_epoch;              /* Monotonic time (us) the node started, votes are refused for an election timeout afterwards */
+    raft_term_t lease_blocked_term;   /* Term in which leader lease is disabled, e.g. after a leader transfer */
     Log log;                       /* Raft persistent log */
     Metadata meta;                 /* Raft metadata for voted_for and term */
     struct EntryCache *logcache;   /* Log entry cache to keep entries in memory for faster access */
@@ -390,6 +499,7 @@ typedef struct RedisRaftCtx {
                                                     belong to the same snapshot */
     char incoming_snapshot_file[256];    /* File name for incoming snapshots. When received fully,
                                                     it will be renamed to the original rdb file */
+    SnapshotWriter snapshot_writer;      /* Writes incoming snapshot chunks in the background */
     bool snapshot_in_progress;           /* Indicates we're creating a snapshot in the background */
     raft_index_t curr_snapshot_last_idx; /* Last included idx of the snapshot operation currently in progress */
     raft_term_t curr_snapshot_last_term; /* Last included term of the snapshot operation currently in progress */
@@ -398,6 +508,7 @@ typedef struct RedisRaftCtx {
     int snapshot_child_fd;               /* Pipe connected to snapshot child process */
     SnapshotFile outgoing_snapshot_file; /* Snapshot file memory table to send to followers */
     RaftSnapshotInfo snapshot_info;      /* Current snapshot info */
+    Arena apply_arena;                   /* Deserialized commands of the entry being applied */
 
     struct RaftReq *debug_req;          /* Current RAFT.DEBUG request context, if processing one */
     struct RaftReq *transfer_req;       /* RaftReq if a leader transfer is in progress */
@@ -405,7 +516,9 @@ typedef struct RedisRaftCtx {
     struct ShardingInfo *sharding_info; /* Information about sharding, when cluster mode is enabled */
     RedisModuleDict *client_state;      /* A dict that tracks different client states */
     struct CommandSpecTable *commands_spec_table;
-    RedisModuleDict *subcommand_spec_tables; /* a dict that maps aggregate commands to its subcommand table */
+    RedisModuleString *filter_cmd;    /* Last command intercepted by the command filter (retained) */
+    RedisModuleString *filter_subcmd; /* Its subcommand if it has subcommands, or NULL */
+    int filter_flags;                 /* Its flags, see CommandSpecTableGetFlags() */
 
     /* General stats */
     unsigned long client_attached_entries;       /* Number of log entries attached to user connections */
@@ -417,17 +530,30 @@ typedef struct RedisRaftCtx {
     unsigned long snapshots_created;             /* Number of snapshots created */
     unsigned long appendreq_received;            /* Number of received appendreq messages */
     unsigned long appendreq_with_entry_received; /* Number of received appendreq messages with at least one entry in them */
+    unsigned long appendreq_deferred;            /* Number of appendreq messages acknowledged once fsync() completed */
     unsigned long snapshotreq_received;          /* Number of received snapshotreq messages */
     unsigned long exec_throttled;                /* Number of command executions throttled due to slow execution */
+    unsigned long long lease_reads;              /* Number of reads served under the leader lease */
+    unsigned long long follower_reads;           /* Number of reads served by this node as a follower */
+    unsigned long long write_batches;            /* Number of batch entries appended by this node */
+    unsigned long long write_batch_requests;     /* Number of client writes included in batch entries */
+    unsigned long long compressed_entries;       /* Number of log entries created compressed */
+    unsigned long long compression_saved_bytes;  /* Bytes saved by compressing log entries */
+    unsigned long long cmd_checks_cached;        /* Number of commands checked without a dry run */
+    unsigned long long cmd_checks_dry_run;       /* Number of commands checked with a dry run */
+    LatencyStats latency;                        /* Write latency histograms, see RAFT.LATENCY */
 
     int entered_eval;                     /* handling a lua script */
     RedisModuleDict *locked_keys;         /* keys that have been locked for migration */
     RedisModuleDict *acl_dict;            /* maps acl strings to RedisModuleUser * objects */
+    RedisModuleDict *cmd_check_arity;     /* command name -> arity, see CommandCheckCached() */
     RedisModuleDict *client_session_dict; /* maps session IDs to Session Objects */
 
     /* we use a dict and an intrusive list to reproduce java's LinkedHashMap, fast lookup with order maintenance */
     struct sc_list blocked_command_list;   /* list of blocked commands in order of them blocking */
     RedisModuleDict *blocked_command_dict; /* raft entry id -> blocked command mapping, for fast lookup */
+    struct sc_list follower_read_list;     /* Follower reads waiting for their read index to be applied */
+    struct RaftReq *write_batch;           /* Client writes to append as a single entry, see RaftFlushWriteBatch() */
 } RedisRaftCtx;
 
 extern RedisRaftCtx redis_raft;
@@ -457,19 +583,73 @@ typedef struct PendingResponse {
     bool proxy;
     int id;
     long long request_time;
-    struct sc_list entries;
+    uint64_t sent_time; /* Monotonic time (us) the request was sent */
+    size_t bytes;       /* Size of the request payload */
 } PendingResponse;
 
+/* Initial capacity of the pending responses ring buffer of a node */
+#define NODE_PENDING_RESPONSES_INITIAL 16
+
+/* Ring buffer of the responses pending on a connection, in request order */
+typedef struct PendingResponseQueue {
+    PendingResponse *buf;
+    unsigned long capacity; /* A power of two */
+    unsigned long head;     /* Position of the oldest pending response */
+    unsigned long count;    /* Number of pending responses */
+} PendingResponseQueue;
+
+/* Number of recent round-trip times kept per node */
+#define NODE_RTT_SAMPLES 128
+
+/* Entries per appendreq histogram buckets: <=1, <=2, <=4 ... <=256, >256 */
+#define NODE_AE_BATCH_BUCKETS 10
+
+/* Version of the RAFT.AEBIN binary message encoding */
+#define RAFT_AE_BINARY_VERSION 1
+
 /* Maintains all state about peer nodes */
 typedef struct Node {
     raft_node_id_t id;                /* Raft unique node ID */
     RedisRaftCtx *rr;                 /* RedisRaftCtx handle */
     Connection *conn;                 /* Connection to node */
+    Connection *priority_conn;        /* Connection for votes, keepalives and TimeoutNow, see raftSendKeepalives() */
     NodeAddr addr;                    /* Node's address */
+    int refcount;                     /* Connections referencing the node */
+    bool ae_text_only;                /* Node does not support RAFT.AEBIN, use RAFT.AE */
+    bool ae_ack;                      /* Node supports RAFT.AEACK */
+    raft_index_t next_idx;            /* First index of the last entries sent to node, pins them in the log cache */
+    unsigned long cache_hits;         /* Entries sent to node from the log cache */
+    unsigned long cache_misses;       /* Entries sent to node from the log file */
+    uint64_t lease_ack_time;          /* Send time of the last request node acknowledged in current term */
     long pending_raft_response_num;   /* Number of pending Raft responses */
     long pending_proxy_response_num;  /* Number of pending proxy responses */
-    struct sc_list pending_responses; /* List of PendingResponse objects */
+    size_t pending_raft_bytes;        /* Payload size of pending Raft requests */
+    PendingResponseQueue pending;     /* Responses pending on conn */
+    PendingResponseQueue priority_pending; /* Responses pending on priority_conn */
+    uint64_t keepalive_time;          /* Send time of the last keepalive (us) */
     struct sc_list entries;           /* Next Node item in the list */
+
+    /* Replication stats, see RAFT.NODESTATS */
+    raft_index_t match_idx;                  /* Last index node acknowledged to have in its log */
+    uint64_t rtt[NODE_RTT_SAMPLES];          /* Recent Raft request round-trip times (us) */
+    unsigned long rtt_count;                 /* Number of round-trip times recorded */
+    unsigned long ae_sent;                   /* appendreq messages sent with at least one entry */
+    unsigned long ae_entries_sent;           /* Entries sent in appendreq messages */
+    unsigned long ae_batch_hist[NODE_AE_BATCH_BUCKETS]; /* Entries per appendreq distribution */
+    raft_size_t snapshot_size;               /* Size of the last snapshot sent to node */
+    raft_size_t snapshot_offset;             /* Bytes of the snapshot node acknowledged */
+    unsigned long snapshots_sent;            /* Number of snapshots delivered to node */
+
+    /* appendreq flow control, see NodeUpdateFlowControl() */
+    long ae_window;                  /* Max in-flight Raft messages */
+    long long ae_batch_size;         /* Max appendreq message size in bytes */
+    unsigned long ae_window_acks;    /* Replies received since ae_window was last increased */
+    bool ae_window_limited;          /* Backpressure applied since ae_window was last increased */
+    bool ae_batch_limited;           /* A message was cut at ae_batch_size since it was last increased */
+    bool ae_slow_start;              /* Grow exponentially until queueing is detected */
+    uint64_t ae_min_rtt;             /* Base round-trip time of appendreq messages (us) */
+    uint64_t ae_min_rtt_time;        /* Time ae_min_rtt was measured */
+    uint64_t ae_backoff_time;        /* Time of the last decrease */
 } Node;
 
 /* General purpose status code.  Convention is this:
@@ -498,6 +678,7 @@ enum RaftReqType {
     RR_DELETE_UNLOCK_KEYS,
     RR_END_SESSION,
     RR_CLIENT_UNBLOCK,
+    RR_WRITE_BATCH,
     RR_RAFTREQ_MAX
 };
 
@@ -519,10 +700,19 @@ typedef struct {
     int size;                 /* Size of allocated array */
     int len;                  /* Number of elements in array */
     unsigned long cmd_flags;  /* the calculated cmd_flags for all commands in this array */
+    bool cmd_flags_valid;     /* cmd_flags is already calculated for this array (not serialized) */
     RaftRedisCommand **commands;
     RedisModuleString *acl;
+    bool arena;               /* commands and argv arrays are allocated from an Arena */
 } RaftRedisCommandArray;
 
+/* A command array of a RAFT_LOGTYPE_BATCH entry */
+typedef struct {
+    raft_session_t session; /* client id of the request */
+    const char *data;       /* Serialized RaftRedisCommandArray, points into the entry */
+    size_t data_len;
+} RaftRedisCommandBatchItem;
+
 /* Max length of a ShardGroupNode string, including newline and null terminator */
 #define SHARDGROUPNODE_MAXLEN (RAFT_SHARDGROUP_NODEID_LEN + 1 + NODEADDR_MAXLEN + 2)
 
@@ -590,6 +780,7 @@ typedef struct ShardGroup {
 #define RAFT_LOGTYPE_IMPORT_KEYS         (RAFT_LOGTYPE_NUM + 6)
 #define RAFT_LOGTYPE_END_SESSION         (RAFT_LOGTYPE_NUM + 7)
 #define RAFT_LOGTYPE_TIMEOUT_BLOCKED     (RAFT_LOGTYPE_NUM + 8)
+#define RAFT_LOGTYPE_BATCH               (RAFT_LOGTYPE_NUM + 9)
 
 #define MAX_AUTH_STRING_ARG_LENGTH 255
 
@@ -629,6 +820,7 @@ typedef struct RaftReq {
     RedisModuleTimerID timeout_timer;
     raft_index_t raft_idx;
     raft_session_t client_id;
+    uint64_t start_time; /* Monotonic time (us) the request was received */
 
     union {
         struct {
@@ -637,6 +829,12 @@ typedef struct RaftReq {
             RaftRedisCommandArray cmds;
         } redis;
 
+        struct {
+            struct RaftReq **reqs; /* RR_REDISCOMMAND requests, in entry order */
+            int len;
+            int size;
+        } batch;
+
         ImportKeys import_keys;
 
         struct {
@@ -815,13 +1013,27 @@ void NodeAddrListFree(NodeAddrListElement *head);
 /* node.c */
 Node *NodeCreate(RedisRaftCtx *rr, int id, const NodeAddr *addr);
 void HandleNodeStates(RedisRaftCtx *rr);
-void NodeAddPendingResponse(Node *node, bool proxy);
-void NodeDismissPendingResponse(Node *node);
+void NodeAddPendingResponse(Node *node, bool proxy, size_t bytes);
+uint64_t NodeDismissPendingResponse(Node *node);
+void NodeAddPriorityResponse(Node *node);
+uint64_t NodeDismissPriorityResponse(Node *node);
+void NodeTerminate(Node *node);
+void NodeRecordAppendEntries(Node *node, long n_entries);
+uint64_t NodeRttPercentile(Node *node, double percentile);
+long NodeAppendWindow(Node *node);
+long long NodeAppendBatchSize(Node *node);
+void NodeUpdateFlowControl(Node *node, uint64_t sent_time);
+bool NodesSupportBatchEntries(RedisRaftCtx *rr);
 
 /* serialization.c */
 raft_entry_t *RaftRedisCommandArraySerialize(const RaftRedisCommandArray *source);
+raft_entry_t *RaftRedisCommandBatchSerialize(RaftRedisCommandArray **arrays, int count);
+RaftRedisCommandBatchItem *RaftRedisCommandBatchDeserialize(const void *buf, size_t buf_size, size_t *count);
 size_t RaftRedisCommandDeserialize(RaftRedisCommand *target, const void *buf, size_t buf_size);
+raft_entry_t *RaftRedisCompressEntry(raft_entry_t *ety, size_t threshold);
+const char *RaftRedisDecompressPayload(const char *buf, size_t *size, Arena *arena);
 RRStatus RaftRedisCommandArrayDeserialize(RaftRedisCommandArray *target, const void *buf, size_t buf_size);
+RRStatus RaftRedisCommandArrayDeserializeArena(RaftRedisCommandArray *target, const void *buf, size_t buf_size, Arena *arena);
 void RaftRedisCommandArrayFree(RaftRedisCommandArray *array);
 void RaftRedisCommandFree(RaftRedisCommand *r);
 RaftRedisCommand *RaftRedisCommandArrayExtend(RaftRedisCommandArray *target);
@@ -832,6 +1044,9 @@ raft_entry_t *RaftRedisLockKeysSerialize(RedisModuleString **argv, size_t argc);
 RedisModuleString **RaftRedisLockKeysDeserialize(const void *buf, size_t buf_size, size_t *num_keys);
 raft_entry_t *RaftRedisSerializeTimeout(raft_index_t idx, bool error);
 RRStatus RaftRedisDeserializeTimeout(const void *buf, size_t buf_size, raft_index_t *idx, bool *error);
+char *AppendEntriesSerializeBinary(raft_appendentries_req_t *msg, size_t *len);
+char *AppendEntriesFormatBinaryCommand(raft_appendentries_req_t *msg, raft_node_id_t target_id, raft_node_id_t source_id, size_t *len);
+RRStatus AppendEntriesDeserializeBinary(raft_appendentries_req_t *msg, const char *buf, size_t len, RedisModuleString *src);
 
 /* redisraft.c */
 RRStatus RedisRaftCtxInit(RedisRaftCtx *rr, RedisModuleCtx *ctx);
@@ -847,6 +1062,7 @@ void addUsedNodeId(RedisRaftCtx *rr, raft_node_id_t node_id);
 raft_node_id_t makeRandomNodeId(RedisRaftCtx *rr);
 void entryAttachRaftReq(RedisRaftCtx *rr, raft_entry_t *entry, RaftReq *req);
 RaftReq *entryDetachRaftReq(RedisRaftCtx *rr, raft_entry_t *entry);
+raft_entry_t *entryNewFromString(RedisModuleString *str, const char *data, unsigned int len);
 void shutdownAfterRemoval(RedisRaftCtx *rr);
 bool hasNodeIdBeenUsed(RedisRaftCtx *rr, raft_node_id_t node_id);
 void callRaftPeriodic(RedisModuleCtx *ctx, void *arg);
@@ -856,8 +1072,33 @@ void handleFsyncCompleted(void *arg);
 void clearClientSessions(RedisRaftCtx *rr);
 void blockedTimedOut(RedisModuleCtx *ctx, void *data);
 void handleUnblock(RedisModuleCtx *ctx, RedisModuleCallReply *reply, void *private_data);
+bool RaftHasLeaderLease(RedisRaftCtx *rr);
+void RaftAddToWriteBatch(RedisRaftCtx *rr, RaftReq *req);
+void RaftFlushWriteBatch(RedisRaftCtx *rr);
+void RaftRequestLogFsync(RedisRaftCtx *rr, raft_index_t idx);
+raft_entry_t *RaftCompressEntry(RedisRaftCtx *rr, raft_entry_t *entry);
+void RaftRecordAppendLatency(RedisRaftCtx *rr, raft_index_t idx, raft_entry_id_t id, RaftReq **reqs, int count);
+
+/* compress.c */
+size_t CompressData(const void *in_data, size_t in_len, void *out_data, size_t out_len);
+size_t DecompressData(const void *in_data, size_t in_len, void *out_data, size_t out_len);
+size_t DecompressMaxSize(size_t in_len);
+
+/* latency.c */
+void LatencyHistogramRecord(LatencyHistogram *h, uint64_t value);
+uint64_t LatencyHistogramPercentile(LatencyHistogram *h, double percentile);
+void LatencyRecord(LatencyStats *s, LatencyStage stage, uint64_t start);
+void LatencyEntryAppended(LatencyStats *s, raft_index_t idx, raft_entry_id_t id, uint64_t time);
+void LatencyEntriesSent(LatencyStats *s, raft_entry_t **entries, raft_index_t first_idx, long n_entries);
+void LatencyEntryCommitted(LatencyStats *s, raft_index_t idx, raft_entry_id_t id);
+void LatencyReset(LatencyStats *s);
+void LatencyReply(RedisModuleCtx *ctx, LatencyStats *s);
 
 /* util.c */
+void *ArenaAlloc(Arena *a, size_t size);
+void *ArenaCalloc(Arena *a, size_t nmemb, size_t size);
+void ArenaReset(Arena *a);
+void ArenaFree(Arena *a);
 int RedisModuleStringToInt(RedisModuleString *str, int *value);
 char *catsnprintf(char *strbuf, size_t *strbuf_len, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
 int safesnprintf(void *buf, size_t size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
@@ -909,6 +1150,8 @@ void SnapshotInit(RedisRaftCtx *rr);
 
 /* proxy.c */
 RRStatus ProxyCommand(RedisRaftCtx *rr, RedisModuleCtx *ctx, RaftRedisCommandArray *cmds, Node *leader);
+RRStatus FollowerReadCommand(RedisRaftCtx *rr, RedisModuleCtx *ctx, RaftRedisCommandArray *cmds, Node *leader);
+void HandleFollowerReads(RedisRaftCtx *rr);
 
 /* connection.c */
 Connection *ConnCreate(RedisRaftCtx *rr, void *privdata, ConnectionCallbackFunc idle_cb, ConnectionFreeFunc free_cb, char *username, char *password);
@@ -960,19 +1203,26 @@ void MigrateKeys(RedisRaftCtx *rr, RaftReq *req);
 
 /* commands.c */
 typedef struct CommandSpecTable {
-    RedisModuleDict *table;
+    RedisModuleDict *table;          /* Command name -> CommandSpec */
+    CommandSpec **slots;             /* Perfect hash of table, used for lookups */
+    const CommandSpec **subcommands; /* Subcommand specs of each slot, or NULL */
+    uint32_t *seeds;                 /* Hash seed of each bucket */
+    uint32_t slots_mask;             /* Number of slots - 1 */
+    uint32_t buckets_mask;           /* Number of buckets - 1 */
 } CommandSpecTable;
 
 void CommandSpecTableInit(RedisModuleCtx *ctx, struct CommandSpecTable **cmd_spec_table);
 void CommandSpecTableClear(struct CommandSpecTable *cmd_spec_table);
-void SubCommandsSpecTableInit(RedisModuleCtx *ctx, RedisModuleDict **subcommandspec_dict);
-void FreeSubCommandSpecTables(RedisRaftCtx *rr, RedisModuleDict *tables);
 uint64_t CommandSpecTableSize(struct CommandSpecTable *cmd_spec_table);
 CommandSpec *CommandSpecTableGetC(struct CommandSpecTable *cmd_spec_table, void *key, size_t keylen, int *nokey);
-int CommandSpecTableGetFlags(CommandSpecTable *cmd_spec_table, RedisModuleDict *sub_command_tables, const RedisModuleString *cmd, const RedisModuleString *subcmd);
+int CommandSpecTableGetFlags(CommandSpecTable *cmd_spec_table, const RedisModuleString *cmd, const RedisModuleString *subcmd);
 RRStatus CommandSpecTableSetC(struct CommandSpecTable *cmd_spec_table, void *key, size_t keylen, CommandSpec *cs);
 void CommandSpecTableRebuild(RedisModuleCtx *ctx, struct CommandSpecTable *cmd_spec_table, const char *ignored_commands);
-unsigned int CommandSpecTableGetAggregateFlags(CommandSpecTable *cmd_spec_table, RedisModuleDict *sub_command_tables, RaftRedisCommandArray *array, unsigned int default_flags);
+void CommandSpecTableBuildIndex(CommandSpecTable *t, CommandSpec **specs, size_t count);
+unsigned int CommandSpecTableGetAggregateFlags(CommandSpecTable *cmd_spec_table, RaftRedisCommandArray *array, unsigned int default_flags);
+bool CommandCheckCached(RedisRaftCtx *rr, RedisModuleCtx *ctx, RaftRedisCommand *cmd, bool check_oom);
+void CommandCheckCacheReset(RedisRaftCtx *rr);
+void CommandCheckCacheFree(RedisRaftCtx *rr);
 
 /* sort.c */
 void handleSort(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
@@ -987,6 +1237,10 @@ int encodeInteger(char prefix, char *ptr, size_t sz, unsigned long val);
 size_t calcSerializeStringSize(RedisModuleString *str);
 int decodeString(const char *p, size_t sz, RedisModuleString **str);
 int encodeString(char *p, size_t sz, RedisModuleString *str);
+void encodeUInt32LE(char *p, uint32_t val);
+void encodeUInt64LE(char *p, uint64_t val);
+uint32_t decodeUInt32LE(const char *p);
+uint64_t decodeUInt64LE(const char *p);
 
 /* clientstate.c */
 ClientState *ClientStateGetById(RedisRaftCtx *rr, unsigned long long client_id);
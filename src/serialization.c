@@ -17,6 +17,8 @@
 
 RaftRedisCommand *RaftRedisCommandArrayExtend(RaftRedisCommandArray *target)
 {
+    RedisModule_Assert(!target->arena);
+
     if (target->size == target->len) {
         target->size++;
         target->commands = RedisModule_Realloc(target->commands, target->size * sizeof(RaftRedisCommand *));
@@ -34,6 +36,8 @@ void RaftRedisCommandArrayMove(RaftRedisCommandArray *target, RaftRedisCommandAr
 {
     int i;
 
+    RedisModule_Assert(!target->arena && !source->arena);
+
     if (target->len + source->len > target->size) {
         target->size = target->len + source->len;
         target->commands = RedisModule_Realloc(target->commands, target->size * sizeof(RaftRedisCommand *));
@@ -55,10 +59,10 @@ void RaftRedisCommandArrayMove(RaftRedisCommandArray *target, RaftRedisCommandAr
     target->asking |= source->asking;
     target->client_id = source->client_id;
     target->cmd_flags |= source->cmd_flags;
+    target->cmd_flags_valid = false;
 }
 
-/* Free a RaftRedisCommand */
-void RaftRedisCommandFree(RaftRedisCommand *r)
+static void freeCommand(RaftRedisCommand *r, bool arena)
 {
     int i;
 
@@ -66,11 +70,19 @@ void RaftRedisCommandFree(RaftRedisCommand *r)
         for (i = 0; i < r->argc; i++) {
             RedisModule_FreeString(NULL, r->argv[i]);
         }
-        RedisModule_Free(r->argv);
+        if (!arena) {
+            RedisModule_Free(r->argv);
+        }
     }
     r->argc = 0;
 }
 
+/* Free a RaftRedisCommand */
+void RaftRedisCommandFree(RaftRedisCommand *r)
+{
+    freeCommand(r, false);
+}
+
 void RaftRedisCommandArrayFree(RaftRedisCommandArray *array)
 {
     int i;
@@ -84,11 +96,15 @@ void RaftRedisCommandArrayFree(RaftRedisCommandArray *array)
             if (!array->commands[i]) {
                 continue;
             }
-            RaftRedisCommandFree(array->commands[i]);
-            RedisModule_Free(array->commands[i]);
+            freeCommand(array->commands[i], array->arena);
+            if (!array->arena) {
+                RedisModule_Free(array->commands[i]);
+            }
             array->commands[i] = NULL;
         }
-        RedisModule_Free(array->commands);
+        if (!array->arena) {
+            RedisModule_Free(array->commands);
+        }
         array->commands = NULL;
     }
     array->size = array->len = 0;
@@ -96,6 +112,8 @@ void RaftRedisCommandArrayFree(RaftRedisCommandArray *array)
         RedisModule_FreeString(NULL, array->acl);
     }
     array->asking = false;
+    array->arena = false;
+    array->cmd_flags_valid = false;
 }
 
 static size_t calcSerializedSize(RaftRedisCommand *cmd)
@@ -112,26 +130,26 @@ static size_t calcSerializedSize(RaftRedisCommand *cmd)
     return sz;
 }
 
-/* Serialize a number of RaftRedisCommand into a Raft entry */
-raft_entry_t *RaftRedisCommandArraySerialize(const RaftRedisCommandArray *source)
+static size_t calcArraySerializedSize(const RaftRedisCommandArray *source)
 {
-    size_t len;
-    int n, i, j;
-    char *p;
-
     size_t sz = calcIntSerializedLen(source->asking);
     sz += calcIntSerializedLen(source->cmd_flags);
     sz += calcIntSerializedLen(source->len);
 
-    /* Compute sizes */
-    for (i = 0; i < source->len; i++) {
+    for (int i = 0; i < source->len; i++) {
         sz += calcSerializedSize(source->commands[i]);
     }
     sz += calcSerializeStringSize(source->acl);
 
-    /* Prepare entry */
-    raft_entry_t *ety = raft_entry_new(sz);
-    p = ety->data;
+    return sz;
+}
+
+/* Encode a number of RaftRedisCommand into p, which must have room for
+ * calcArraySerializedSize() bytes. */
+static void encodeArray(const RaftRedisCommandArray *source, char *p, size_t sz)
+{
+    size_t len;
+    int n, i, j;
 
     /* Encode Asking */
     n = encodeInteger('*', p, sz, source->asking);
@@ -181,11 +199,205 @@ raft_entry_t *RaftRedisCommandArraySerialize(const RaftRedisCommandArray *source
             sz -= (len + 1);
         }
     }
+}
+
+/* Payloads of RAFT_LOGTYPE_NORMAL and RAFT_LOGTYPE_BATCH entries may be
+ * compressed, see RaftRedisCompressEntry(). A compressed payload is:
+ *
+ * Z<uncompressed len>\n<codec><compressed data>
+ *
+ * Uncompressed payloads always start with '*', so the format is detected by
+ * the first byte, and payloads are decompressed only when they are applied.
+ * The codec byte identifies the compression algorithm, so others can be added
+ * later; payloads with an unknown codec are rejected.
+ */
+#define COMPRESSED_PREFIX    'Z'
+#define COMPRESSED_CODEC_LZF 1 /* CompressData() output */
+
+/* Compress the payload of the entry if it is at least threshold bytes long
+ * and compression saves at least 1/8 of it. Returns a new entry and releases
+ * ety in this case, or returns ety otherwise. Entry fields other than the
+ * payload should be set afterwards.
+ */
+raft_entry_t *RaftRedisCompressEntry(raft_entry_t *ety, size_t threshold)
+{
+    if (!threshold || ety->data_len < threshold) {
+        return ety;
+    }
+
+    size_t hdr_len = calcIntSerializedLen(ety->data_len) + 1;
+    size_t max_len = ety->data_len - ety->data_len / 8;
+    if (max_len <= hdr_len) {
+        return ety;
+    }
+
+    char *buf = RedisModule_Alloc(max_len - hdr_len);
+    size_t len = CompressData(ety->data, ety->data_len, buf, max_len - hdr_len);
+    if (!len) {
+        RedisModule_Free(buf);
+        return ety;
+    }
+
+    raft_entry_t *compressed = raft_entry_new(hdr_len + len);
+    int n = encodeInteger(COMPRESSED_PREFIX, compressed->data, compressed->data_len, ety->data_len);
+    RedisModule_Assert(n == (int) hdr_len - 1);
+    compressed->data[n] = COMPRESSED_CODEC_LZF;
+    memcpy(compressed->data + hdr_len, buf, len);
+
+    RedisModule_Free(buf);
+    raft_entry_release(ety);
+
+    return compressed;
+}
+
+/* If the payload is compressed, decompress it into the arena and return it,
+ * updating *size. Otherwise, return buf. Returns NULL if the payload is
+ * corrupt or uses an unknown codec. The header comes from the peer, so the
+ * uncompressed length is checked before allocating anything.
+ */
+const char *RaftRedisDecompressPayload(const char *buf, size_t *size, Arena *arena)
+{
+    size_t len;
+    int n;
+
+    if (*size == 0 || buf[0] != COMPRESSED_PREFIX) {
+        return buf;
+    }
+
+    if ((n = decodeInteger(buf, *size, COMPRESSED_PREFIX, &len)) < 0 || !len ||
+        (size_t) n >= *size || buf[n] != COMPRESSED_CODEC_LZF) {
+        return NULL;
+    }
+
+    const char *data = buf + n + 1;
+    size_t data_len = *size - n - 1;
+    if (len > DecompressMaxSize(data_len)) {
+        return NULL;
+    }
+
+    char *out = ArenaAlloc(arena, len);
+    if (DecompressData(data, data_len, out, len) != len) {
+        return NULL;
+    }
+
+    *size = len;
+    return out;
+}
+
+/* Serialize a number of RaftRedisCommand into a Raft entry */
+raft_entry_t *RaftRedisCommandArraySerialize(const RaftRedisCommandArray *source)
+{
+    size_t sz = calcArraySerializedSize(source);
+
+    raft_entry_t *ety = raft_entry_new(sz);
+    encodeArray(source, ety->data, sz);
 
     return ety;
 }
 
-size_t RaftRedisCommandDeserialize(RaftRedisCommand *target, const void *buf, size_t buf_size)
+/* Serialize the command arrays of multiple client requests into a single Raft
+ * entry. The entry starts with the number of arrays, followed by the session
+ * and the serialized form of each array:
+ *
+ * *<count>\n
+ * *<session>\n$<len>\n<RaftRedisCommandArraySerialize() format>\n
+ * ...
+ */
+raft_entry_t *RaftRedisCommandBatchSerialize(RaftRedisCommandArray **arrays, int count)
+{
+    size_t sz = calcIntSerializedLen(count);
+    int n;
+
+    for (int i = 0; i < count; i++) {
+        size_t len = calcArraySerializedSize(arrays[i]);
+
+        sz += calcIntSerializedLen(arrays[i]->client_id);
+        sz += calcIntSerializedLen(len) + len + 1;
+    }
+
+    raft_entry_t *ety = raft_entry_new(sz);
+    char *p = ety->data;
+
+    n = encodeInteger('*', p, sz, count);
+    RedisModule_Assert(n != -1);
+    p += n;
+    sz -= n;
+
+    for (int i = 0; i < count; i++) {
+        size_t len = calcArraySerializedSize(arrays[i]);
+
+        n = encodeInteger('*', p, sz, arrays[i]->client_id);
+        RedisModule_Assert(n != -1);
+        p += n;
+        sz -= n;
+
+        n = encodeInteger('$', p, sz, len);
+        RedisModule_Assert(n != -1);
+        p += n;
+        sz -= n;
+
+        RedisModule_Assert(sz > len);
+        encodeArray(arrays[i], p, len);
+        p += len;
+        *p = '\n';
+        p++;
+        sz -= (len + 1);
+    }
+
+    return ety;
+}
+
+/* Decode a batch entry created by RaftRedisCommandBatchSerialize(). Returned
+ * items point into buf, and should be freed with RedisModule_Free(). Returns
+ * NULL on error.
+ */
+RaftRedisCommandBatchItem *RaftRedisCommandBatchDeserialize(const void *buf, size_t buf_size, size_t *count)
+{
+    const char *p = buf;
+    size_t num, val;
+    int n;
+
+    if ((n = decodeInteger(p, buf_size, '*', &num)) < 0 || !num) {
+        return NULL;
+    }
+    p += n;
+    buf_size -= n;
+
+    RaftRedisCommandBatchItem *items = RedisModule_Calloc(num, sizeof(*items));
+
+    for (size_t i = 0; i < num; i++) {
+        if ((n = decodeInteger(p, buf_size, '*', &val)) < 0) {
+            goto error;
+        }
+        p += n;
+        buf_size -= n;
+        items[i].session = val;
+
+        if ((n = decodeInteger(p, buf_size, '$', &val)) < 0) {
+            goto error;
+        }
+        p += n;
+        buf_size -= n;
+        if (buf_size <= val) {
+            goto error;
+        }
+
+        items[i].data = p;
+        items[i].data_len = val;
+        p += val + 1;
+        buf_size -= (val + 1);
+    }
+
+    *count = num;
+    return items;
+
+error:
+    RedisModule_Free(items);
+    return NULL;
+}
+
+/* Decode a command. If arena is not NULL, argv is allocated from it. */
+static size_t deserializeCommand(RaftRedisCommand *target, const void *buf, size_t buf_size, Arena *arena)
 {
     const char *p = buf;
     int i, n;
@@ -198,7 +410,11 @@ size_t RaftRedisCommandDeserialize(RaftRedisCommand *target, const void *buf, si
     p += n;
     buf_size -= n;
     target->argc = len;
-    target->argv = RedisModule_Calloc(len, sizeof(RedisModuleString *));
+    if (arena) {
+        target->argv = ArenaCalloc(arena, len, sizeof(RedisModuleString *));
+    } else {
+        target->argv = RedisModule_Calloc(len, sizeof(RedisModuleString *));
+    }
 
     /* Read args */
     for (i = 0; i < target->argc; i++) {
@@ -219,11 +435,16 @@ size_t RaftRedisCommandDeserialize(RaftRedisCommand *target, const void *buf, si
     return p - (char *) buf;
 
 error:
-    RaftRedisCommandFree(target);
+    freeCommand(target, arena != NULL);
     return 0;
 }
 
-RRStatus RaftRedisCommandArrayDeserialize(RaftRedisCommandArray *target, const void *buf, size_t buf_size)
+size_t RaftRedisCommandDeserialize(RaftRedisCommand *target, const void *buf, size_t buf_size)
+{
+    return deserializeCommand(target, buf, buf_size, NULL);
+}
+
+static RRStatus deserializeArray(RaftRedisCommandArray *target, const void *buf, size_t buf_size, Arena *arena)
 {
     const char *p = buf;
     size_t commands_num;
@@ -233,6 +454,21 @@ RRStatus RaftRedisCommandArrayDeserialize(RaftRedisCommandArray *target, const v
         RaftRedisCommandArrayFree(target);
     }
 
+    /* Compressed payloads are decompressed into the arena or, if there is no
+     * arena, a temporary one. Arguments are copied, so it is not needed
+     * after deserialization. */
+    if (buf_size && p[0] == COMPRESSED_PREFIX) {
+        Arena tmp = {0};
+        RRStatus ret = RR_ERROR;
+
+        if ((p = RaftRedisDecompressPayload(p, &buf_size, arena ? arena : &tmp)) != NULL) {
+            ret = deserializeArray(target, p, buf_size, arena);
+        }
+        ArenaFree(&tmp);
+
+        return ret;
+    }
+
     /* Read asking */
     size_t asking;
     if ((n = decodeInteger(p, buf_size, '*', &asking)) < 0) {
@@ -277,10 +513,19 @@ RRStatus RaftRedisCommandArrayDeserialize(RaftRedisCommandArray *target, const v
 
     /* Allocate array */
     target->len = target->size = commands_num;
-    target->commands = RedisModule_Calloc(commands_num, sizeof(RaftRedisCommand *));
+    target->arena = arena != NULL;
+    if (arena) {
+        target->commands = ArenaCalloc(arena, commands_num, sizeof(RaftRedisCommand *));
+    } else {
+        target->commands = RedisModule_Calloc(commands_num, sizeof(RaftRedisCommand *));
+    }
     for (size_t i = 0; i < commands_num; i++) {
-        target->commands[i] = RedisModule_Calloc(1, sizeof(RaftRedisCommand));
-        size_t len = RaftRedisCommandDeserialize(target->commands[i], p, buf_size);
+        if (arena) {
+            target->commands[i] = ArenaCalloc(arena, 1, sizeof(RaftRedisCommand));
+        } else {
+            target->commands[i] = RedisModule_Calloc(1, sizeof(RaftRedisCommand));
+        }
+        size_t len = deserializeCommand(target->commands[i], p, buf_size, arena);
         if (!len) {
             /* Error */
             RaftRedisCommandArrayFree(target);
@@ -294,6 +539,21 @@ RRStatus RaftRedisCommandArrayDeserialize(RaftRedisCommandArray *target, const v
     return RR_OK;
 }
 
+RRStatus RaftRedisCommandArrayDeserialize(RaftRedisCommandArray *target, const void *buf, size_t buf_size)
+{
+    return deserializeArray(target, buf, buf_size, NULL);
+}
+
+/* Same as RaftRedisCommandArrayDeserialize(), but the commands and argv
+ * arrays are allocated from the arena. Arguments are still separate strings,
+ * and RaftRedisCommandArrayFree() must be called before the arena is reset.
+ * The array cannot be extended or moved.
+ */
+RRStatus RaftRedisCommandArrayDeserializeArena(RaftRedisCommandArray *target, const void *buf, size_t buf_size, Arena *arena)
+{
+    return deserializeArray(target, buf, buf_size, arena);
+}
+
 RRStatus RaftRedisDeserializeImport(ImportKeys *target, const void *buf, size_t buf_size)
 {
     const char *p = buf;
@@ -521,4 +781,190 @@ RRStatus RaftRedisDeserializeTimeout(const void *buf, size_t buf_size, raft_inde
     RedisModule_Assert(buf_size == 1); /* should only have the final '\0' at the end of the data */
 
     return RR_OK;
-}
\ No newline at end of file
+}
+
+/* Binary AppendEntries encoding, used by RAFT.AEBIN.
+ *
+ * The message is a single buffer made of a fixed-size message header, a block
+ * of fixed-size entry headers and the concatenated entry payloads. All integer
+ * fields are little-endian:
+ *
+ * Message header:
+ *   version (u32) | leader_id (u32) | term (u64) | prev_log_idx (u64) |
+ *   prev_log_term (u64) | leader_commit (u64) | msg_id (u64) | n_entries (u32)
+ *
+ * Entry header (n_entries times):
+ *   term (u64) | session (u64) | id (u32) | type (u32) | data_len (u32)
+ *
+ * Payloads (n_entries times):
+ *   data (data_len bytes)
+ */
+#define AE_BIN_MSG_HDR_SIZE   (4 + 4 + 8 * 5 + 4)
+#define AE_BIN_ENTRY_HDR_SIZE (8 + 8 + 4 + 4 + 4)
+
+static size_t appendEntriesBinarySize(raft_appendentries_req_t *msg)
+{
+    size_t sz = AE_BIN_MSG_HDR_SIZE + (size_t) msg->n_entries * AE_BIN_ENTRY_HDR_SIZE;
+
+    for (long i = 0; i < msg->n_entries; i++) {
+        sz += msg->entries[i]->data_len;
+    }
+
+    return sz;
+}
+
+/* Encode msg into p, which must hold appendEntriesBinarySize() bytes. Returns
+ * a pointer past the encoded message.
+ */
+static char *appendEntriesBinaryEncode(raft_appendentries_req_t *msg, char *p)
+{
+    encodeUInt32LE(p, RAFT_AE_BINARY_VERSION);
+    encodeUInt32LE(p + 4, (uint32_t) msg->leader_id);
+    encodeUInt64LE(p + 8, (uint64_t) msg->term);
+    encodeUInt64LE(p + 16, (uint64_t) msg->prev_log_idx);
+    encodeUInt64LE(p + 24, (uint64_t) msg->prev_log_term);
+    encodeUInt64LE(p + 32, (uint64_t) msg->leader_commit);
+    encodeUInt64LE(p + 40, (uint64_t) msg->msg_id);
+    encodeUInt32LE(p + 48, (uint32_t) msg->n_entries);
+    p += AE_BIN_MSG_HDR_SIZE;
+
+    for (long i = 0; i < msg->n_entries; i++) {
+        raft_entry_t *e = msg->entries[i];
+
+        encodeUInt64LE(p, (uint64_t) e->term);
+        encodeUInt64LE(p + 8, (uint64_t) e->session);
+        encodeUInt32LE(p + 16, (uint32_t) e->id);
+        encodeUInt32LE(p + 20, (uint32_t) e->type);
+        encodeUInt32LE(p + 24, (uint32_t) e->data_len);
+        p += AE_BIN_ENTRY_HDR_SIZE;
+    }
+
+    for (long i = 0; i < msg->n_entries; i++) {
+        memcpy(p, msg->entries[i]->data, msg->entries[i]->data_len);
+        p += msg->entries[i]->data_len;
+    }
+
+    return p;
+}
+
+char *AppendEntriesSerializeBinary(raft_appendentries_req_t *msg, size_t *len)
+{
+    size_t sz = appendEntriesBinarySize(msg);
+    char *buf = RedisModule_Alloc(sz);
+
+    appendEntriesBinaryEncode(msg, buf);
+
+    *len = sz;
+    return buf;
+}
+
+/* Format a complete RESP command:
+ *
+ * RAFT.AEBIN [target_node_id] [src_node_id] [message]
+ *
+ * The message is encoded in place, right after its bulk string header, so the
+ * result can be passed to redisAsyncFormattedCommand() without further copies.
+ */
+char *AppendEntriesFormatBinaryCommand(raft_appendentries_req_t *msg, raft_node_id_t target_id,
+                                       raft_node_id_t source_id, size_t *len)
+{
+    char target_str[12];
+    char source_str[12];
+    int target_len = snprintf(target_str, sizeof(target_str), "%d", target_id);
+    int source_len = snprintf(source_str, sizeof(source_str), "%d", source_id);
+    size_t msg_len = appendEntriesBinarySize(msg);
+
+    /* Large enough for the fixed part of the command and all bulk headers */
+    char hdr[128];
+    int hdr_len = snprintf(hdr, sizeof(hdr),
+                           "*4\r\n$10\r\nRAFT.AEBIN\r\n$%d\r\n%s\r\n$%d\r\n%s\r\n$%zu\r\n",
+                           target_len, target_str, source_len, source_str, msg_len);
+
+    size_t sz = hdr_len + msg_len + 2;
+    char *buf = RedisModule_Alloc(sz);
+
+    memcpy(buf, hdr, hdr_len);
+    char *p = appendEntriesBinaryEncode(msg, buf + hdr_len);
+    memcpy(p, "\r\n", 2);
+
+    *len = sz;
+    return buf;
+}
+
+/* Decode a binary AppendEntries message into msg. Entries are allocated and
+ * must be released by the caller. On error, nothing is left allocated.
+ *
+ * If src is not NULL, it is the string buf points into. Entry payloads then
+ * reference it instead of being copied, and the log cache accounts for the
+ * size of the whole message.
+ */
+RRStatus AppendEntriesDeserializeBinary(raft_appendentries_req_t *msg, const char *buf, size_t len,
+                                        RedisModuleString *src)
+{
+    if (len < AE_BIN_MSG_HDR_SIZE ||
+        decodeUInt32LE(buf) != RAFT_AE_BINARY_VERSION) {
+        return RR_ERROR;
+    }
+
+    uint32_t n_entries = decodeUInt32LE(buf + 48);
+    size_t hdr_size = AE_BIN_MSG_HDR_SIZE + (size_t) n_entries * AE_BIN_ENTRY_HDR_SIZE;
+    if (n_entries > len / AE_BIN_ENTRY_HDR_SIZE || hdr_size > len) {
+        return RR_ERROR;
+    }
+
+    /* Validate payload sizes before allocating anything */
+    const char *hdr = buf + AE_BIN_MSG_HDR_SIZE;
+    size_t payload_size = 0;
+
+    for (uint32_t i = 0; i < n_entries; i++) {
+        payload_size += decodeUInt32LE(hdr + i * AE_BIN_ENTRY_HDR_SIZE + 24);
+    }
+    if (payload_size != len - hdr_size) {
+        return RR_ERROR;
+    }
+
+    *msg = (raft_appendentries_req_t){
+        .leader_id = (raft_node_id_t) decodeUInt32LE(buf + 4),
+        .term = (raft_term_t) decodeUInt64LE(buf + 8),
+        .prev_log_idx = (raft_index_t) decodeUInt64LE(buf + 16),
+        .prev_log_term = (raft_term_t) decodeUInt64LE(buf + 24),
+        .leader_commit = (raft_index_t) decodeUInt64LE(buf + 32),
+        .msg_id = (raft_msg_id_t) decodeUInt64LE(buf + 40),
+        .n_entries = (raft_index_t) n_entries,
+    };
+
+    if (n_entries == 0) {
+        return RR_OK;
+    }
+
+    msg->entries = RedisModule_Calloc(n_entries, sizeof(raft_entry_t *));
+
+    const char *data = buf + hdr_size;
+    for (uint32_t i = 0; i < n_entries; i++) {
+        uint32_t data_len = decodeUInt32LE(hdr + 24);
+
+        raft_entry_t *e;
+        if (src) {
+            /* Entries share src, so the whole message is charged once, to the
+             * last entry: the entry cache evicts from the head, so that is the
+             * entry that keeps src alive the longest. */
+            e = entryNewFromString(src, data, data_len);
+            e->data_shared = 1;
+            e->shared_size = (i == n_entries - 1) ? (unsigned int) len : 0;
+        } else {
+            e = raft_entry_new(data_len);
+            memcpy(e->data, data, data_len);
+        }
+
+        e->term = (raft_term_t) decodeUInt64LE(hdr);
+        e->session = decodeUInt64LE(hdr + 8);
+        e->id = (raft_entry_id_t) decodeUInt32LE(hdr + 16);
+        e->type = (int) decodeUInt32LE(hdr + 20);
+
+        msg->entries[i] = e;
+        hdr += AE_BIN_ENTRY_HDR_SIZE;
+        data += data_len;
+    }
+
+    return RR_OK;
+}
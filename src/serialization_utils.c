@@ -160,3 +160,38 @@ int encodeString(char *p, size_t sz, RedisModuleString *str)
 
     return (int) (n + len + 1);
 }
+
+/* Fixed-width little-endian encoding helpers, used by binary wire and on-disk
+ * formats. These are byte-order independent and do not require aligned
+ * pointers.
+ */
+void encodeUInt32LE(char *p, uint32_t val)
+{
+    unsigned char *u = (unsigned char *) p;
+
+    u[0] = (unsigned char) (val);
+    u[1] = (unsigned char) (val >> 8);
+    u[2] = (unsigned char) (val >> 16);
+    u[3] = (unsigned char) (val >> 24);
+}
+
+void encodeUInt64LE(char *p, uint64_t val)
+{
+    encodeUInt32LE(p, (uint32_t) val);
+    encodeUInt32LE(p + 4, (uint32_t) (val >> 32));
+}
+
+uint32_t decodeUInt32LE(const char *p)
+{
+    const unsigned char *u = (const unsigned char *) p;
+
+    return (uint32_t) u[0] |
+           ((uint32_t) u[1] << 8) |
+           ((uint32_t) u[2] << 16) |
+           ((uint32_t) u[3] << 24);
+}
+
+uint64_t decodeUInt64LE(const char *p)
+{
+    return (uint64_t) decodeUInt32LE(p) | ((uint64_t) decodeUInt32LE(p + 4) << 32);
+}
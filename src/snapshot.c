@@ -48,6 +48,13 @@ void createOutgoingSnapshotMmap(RedisRaftCtx *ctx)
         PANIC("mmap failed: %s \n", strerror(errno));
     }
 
+    /* Chunks are sent in order, so let the kernel read ahead aggressively
+     * rather than faulting in the file page by page on the main thread. */
+    if (madvise(p, st.st_size, MADV_SEQUENTIAL) != 0) {
+        LOG_VERBOSE("madvise() failure for the file: %s, error: %s",
+                    ctx->config.rdb_filename, strerror(errno));
+    }
+
     if (close(fd) != 0) {
         LOG_WARNING("close() failure for the file: %s, error: %s",
                     ctx->config.rdb_filename, strerror(errno));
@@ -102,38 +109,22 @@ int raftStoreSnapshotChunk(raft_server_t *raft, void *user_data,
               rr->incoming_snapshot_idx, snapshot_index);
     }
 
-    int flags = O_WRONLY | O_CREAT;
-    if (offset == 0) {
-        flags |= O_TRUNC;
-    }
-
-    int fd = open(rr->incoming_snapshot_file, flags, S_IWUSR | S_IRUSR);
-    if (fd == -1) {
-        LOG_WARNING("open() file: %s, error: %s \n", rr->incoming_snapshot_file,
-                    strerror(errno));
-        return -1;
-    }
-
-    off_t ret_offset = lseek(fd, (off_t) offset, SEEK_SET);
-    if (ret_offset != (off_t) offset) {
-        LOG_WARNING("lseek() file: %s, error: %s \n",
-                    rr->incoming_snapshot_file, strerror(errno));
-        close(fd);
-        return -1;
+    /* The file is kept open until the last chunk is received. It may have been
+     * closed if loading the snapshot failed, continue writing on top of it. */
+    if (offset == 0 || !snapshotWriterIsOpen(&rr->snapshot_writer)) {
+        int ret = snapshotWriterOpen(&rr->snapshot_writer,
+                                     rr->incoming_snapshot_file, offset == 0);
+        if (ret != RR_OK) {
+            return -1;
+        }
     }
 
-    ssize_t len = write(fd, chunk->data, chunk->len);
-    if (len != (ssize_t) chunk->len) {
-        LOG_WARNING("write(), written: %zd, chunk len: %llu, err: %s \n", len,
-                    chunk->len, strerror(errno));
-        close(fd);
+    if (snapshotWriterAdd(&rr->snapshot_writer, offset, chunk->data,
+                          chunk->len) != RR_OK) {
+        snapshotWriterDiscard(&rr->snapshot_writer);
         return -1;
     }
 
-    if (close(fd) != 0) {
-        LOG_WARNING("close() failure: %s, file: %s", strerror(errno),
-                    rr->incoming_snapshot_file);
-    }
     return 0;
 }
 
@@ -141,6 +132,8 @@ int raftClearSnapshot(raft_server_t *raft, void *user_data)
 {
     RedisRaftCtx *rr = user_data;
 
+    snapshotWriterDiscard(&rr->snapshot_writer);
+
     int ret = unlink(rr->incoming_snapshot_file);
     if (ret != 0 && errno != ENOENT) {
         LOG_WARNING("Unlink file: %s, error: %s \n", rr->incoming_snapshot_file,
@@ -480,6 +473,10 @@ int raftLoadSnapshot(raft_server_t *raft, void *user_data, raft_term_t term,
         return -1;
     }
 
+    if (snapshotWriterFinish(&rr->snapshot_writer) != RR_OK) {
+        return -1;
+    }
+
     struct stat st;
     if (stat(rr->incoming_snapshot_file, &st) != 0) {
         LOG_WARNING("Failed to get file size: %s", rr->config.rdb_filename);
@@ -488,10 +485,6 @@ int raftLoadSnapshot(raft_server_t *raft, void *user_data, raft_term_t term,
 
     LOG_NOTICE("Received snapshot file, size: %lld", (long long) st.st_size);
 
-    if (fsyncFileAt(rr->incoming_snapshot_file) != RR_OK) {
-        return -1;
-    }
-
     int rc = syncRename(rr->incoming_snapshot_file, rr->config.rdb_filename);
     if (rc != RR_OK) {
         return -1;
@@ -801,6 +794,13 @@ static void handleSnapshotResponse(redisAsyncContext *c, void *r, void *privdata
         return;
     }
 
+    if (response.success) {
+        node->snapshot_offset = response.offset;
+        if (response.last_chunk) {
+            node->snapshots_sent++;
+        }
+    }
+
     int ret;
     if ((ret = raft_recv_snapshot_response(rr->raft, raft_node, &response)) != 0) {
         LOG_DEBUG("raft_recv_snapshot_response failed, error %d", ret);
@@ -812,6 +812,7 @@ int raftSendSnapshot(raft_server_t *raft,
                      raft_node_t *raft_node,
                      raft_snapshot_req_t *msg)
 {
+    RedisRaftCtx *rr = user_data;
     Node *node = raft_node_get_udata(raft_node);
 
     char target_node_id[32];
@@ -857,7 +858,11 @@ int raftSendSnapshot(raft_server_t *raft,
         return -1;
     }
 
-    NodeAddPendingResponse(node, false);
+    if (msg->chunk.offset == 0) {
+        node->snapshot_size = rr->outgoing_snapshot_file.len;
+        node->snapshot_offset = 0;
+    }
+    NodeAddPendingResponse(node, false, msg->chunk.len);
 
     return 0;
 }
@@ -0,0 +1,351 @@
+/*
+ * Copyright Redis Ltd. 2022 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+#include "redisraft.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Writes incoming snapshot chunks to disk on a background thread.
+ *
+ * The file stays open for the whole transfer. Chunks are copied into a queue
+ * and written with pwrite() by the writer thread, so the main thread only
+ * blocks if the queue is full. Disk space is preallocated ahead of the writes
+ * in growing extents, as the total snapshot size is not known in advance.
+ * Written data is handed to the kernel for writeback while the transfer is in
+ * progress, so the single fsync() after the last chunk has little left to do
+ * and loading the snapshot can start sooner.
+ */
+
+#define SNAPSHOT_WRITER_MIN_PREALLOC (8 * 1024 * 1024)
+#define SNAPSHOT_WRITER_MAX_PREALLOC (1024 * 1024 * 1024)
+#define SNAPSHOT_WRITER_FLUSH_BYTES  (8 * 1024 * 1024)
+
+typedef struct SnapshotWriterChunk {
+    struct SnapshotWriterChunk *next;
+    raft_size_t offset;
+    raft_size_t len;
+    char data[];
+} SnapshotWriterChunk;
+
+static void freeChunks(SnapshotWriter *w)
+{
+    SnapshotWriterChunk *c = w->head;
+
+    while (c) {
+        SnapshotWriterChunk *next = c->next;
+        RedisModule_Free(c);
+        c = next;
+    }
+
+    w->head = NULL;
+    w->tail = NULL;
+    w->queued = 0;
+}
+
+/* Reserves disk space for writes up to `end`. Failures are ignored, this is
+ * only an optimization to avoid fragmentation and block allocation on each
+ * write. */
+static void preallocate(SnapshotWriter *w, int fd, raft_size_t end)
+{
+#if defined(__linux__)
+    if (end <= w->allocated) {
+        return;
+    }
+
+    raft_size_t step = MAX(w->allocated, SNAPSHOT_WRITER_MIN_PREALLOC);
+    step = MIN(step, SNAPSHOT_WRITER_MAX_PREALLOC);
+
+    raft_size_t target = MAX(end, w->allocated + step);
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t) w->allocated,
+                  (off_t) (target - w->allocated)) != 0) {
+        return;
+    }
+
+    w->allocated = target;
+#else
+    (void) w;
+    (void) fd;
+    (void) end;
+#endif
+}
+
+/* Starts writeback of the data written since the last call, without waiting
+ * for it to complete. */
+static void startWriteback(SnapshotWriter *w, int fd, raft_size_t end)
+{
+#if defined(__linux__)
+    if (end < w->flushed + SNAPSHOT_WRITER_FLUSH_BYTES) {
+        return;
+    }
+
+    if (end > w->flushed) {
+        sync_file_range(fd, (off_t) w->flushed, (off_t) (end - w->flushed),
+                        SYNC_FILE_RANGE_WRITE);
+    }
+    w->flushed = end;
+#else
+    (void) w;
+    (void) fd;
+    (void) end;
+#endif
+}
+
+static int writeChunk(SnapshotWriter *w, int fd, SnapshotWriterChunk *c)
+{
+    preallocate(w, fd, c->offset + c->len);
+
+    raft_size_t written = 0;
+    while (written < c->len) {
+        ssize_t n = pwrite(fd, c->data + written, c->len - written,
+                           (off_t) (c->offset + written));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        written += n;
+    }
+
+    startWriteback(w, fd, c->offset + c->len);
+
+    return 0;
+}
+
+static void *snapshotWriterLoop(void *arg)
+{
+    SnapshotWriter *w = arg;
+
+    pthread_mutex_lock(&w->mtx);
+
+    while (1) {
+        while (!w->head) {
+            pthread_cond_wait(&w->cond, &w->mtx);
+        }
+
+        SnapshotWriterChunk *c = w->head;
+        w->head = c->next;
+        if (!w->head) {
+            w->tail = NULL;
+        }
+        w->queued--;
+        w->busy = true;
+
+        int fd = w->fd;
+        bool failed = w->err != 0;
+
+        pthread_mutex_unlock(&w->mtx);
+
+        /* Skip the remaining chunks after a failure, the transfer will be
+         * reported as failed when the next chunk is added. */
+        int err = failed ? 0 : writeChunk(w, fd, c);
+        RedisModule_Free(c);
+
+        pthread_mutex_lock(&w->mtx);
+
+        if (err != 0 && w->err == 0) {
+            w->err = err;
+        }
+        w->busy = false;
+        pthread_cond_broadcast(&w->done_cond);
+    }
+
+    return NULL;
+}
+
+/* Must be called with the mutex held. Waits until all queued chunks are
+ * written. */
+static void waitUntilIdle(SnapshotWriter *w)
+{
+    while (w->queued > 0 || w->busy) {
+        pthread_cond_wait(&w->done_cond, &w->mtx);
+    }
+}
+
+/* Initializes and starts the writer thread. At most `max_queued` chunks are
+ * kept in memory, snapshotWriterAdd() blocks until there is room for more. */
+void snapshotWriterStart(SnapshotWriter *w, int max_queued)
+{
+    int rc;
+    pthread_attr_t attr;
+
+    *w = (SnapshotWriter){
+        .mtx = (pthread_mutex_t) PTHREAD_MUTEX_INITIALIZER,
+        .fd = -1,
+        .max_queued = max_queued,
+    };
+
+    rc = pthread_cond_init(&w->cond, NULL);
+    if (rc != 0) {
+        PANIC("pthread_cond_init(): %s \n", strerror(rc));
+    }
+
+    rc = pthread_cond_init(&w->done_cond, NULL);
+    if (rc != 0) {
+        PANIC("pthread_cond_init(): %s \n", strerror(rc));
+    }
+
+    rc = pthread_attr_init(&attr);
+    if (rc != 0) {
+        PANIC("pthread_attr_init(): %s \n", strerror(rc));
+    }
+
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    rc = pthread_create(&w->id, &attr, snapshotWriterLoop, w);
+    if (rc != 0) {
+        PANIC("pthread_create(): %s \n", strerror(rc));
+    }
+
+    pthread_attr_destroy(&attr);
+}
+
+/* Opens the file to write chunks into. If `truncate` is set, an existing file
+ * is truncated, otherwise chunks are written on top of it. Any file opened
+ * previously is closed without fsync(). */
+int snapshotWriterOpen(SnapshotWriter *w, const char *path, bool truncate)
+{
+    snapshotWriterDiscard(w);
+
+    int flags = O_WRONLY | O_CREAT;
+    if (truncate) {
+        flags |= O_TRUNC;
+    }
+
+    int fd = open(path, flags, S_IWUSR | S_IRUSR);
+    if (fd == -1) {
+        LOG_WARNING("open() file: %s, error: %s \n", path, strerror(errno));
+        return RR_ERROR;
+    }
+
+    /* Chunks may be written on top of a partially received file */
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        LOG_WARNING("fstat() file: %s, error: %s \n", path, strerror(errno));
+        close(fd);
+        return RR_ERROR;
+    }
+
+    pthread_mutex_lock(&w->mtx);
+    w->fd = fd;
+    w->err = 0;
+    w->allocated = 0;
+    w->flushed = 0;
+    w->end = st.st_size;
+    pthread_mutex_unlock(&w->mtx);
+
+    return RR_OK;
+}
+
+bool snapshotWriterIsOpen(SnapshotWriter *w)
+{
+    return w->fd != -1;
+}
+
+/* Queues a copy of the chunk to be written at `offset`. Returns RR_ERROR if a
+ * previous write failed. */
+int snapshotWriterAdd(SnapshotWriter *w, raft_size_t offset, const void *data,
+                      raft_size_t len)
+{
+    RedisModule_Assert(w->fd != -1);
+
+    SnapshotWriterChunk *c = RedisModule_Alloc(sizeof(*c) + len);
+    c->next = NULL;
+    c->offset = offset;
+    c->len = len;
+    memcpy(c->data, data, len);
+
+    pthread_mutex_lock(&w->mtx);
+
+    while (w->queued >= w->max_queued && w->err == 0) {
+        pthread_cond_wait(&w->done_cond, &w->mtx);
+    }
+
+    if (w->err != 0) {
+        LOG_WARNING("write() failure for the snapshot file, error: %s \n",
+                    strerror(w->err));
+        pthread_mutex_unlock(&w->mtx);
+        RedisModule_Free(c);
+        return RR_ERROR;
+    }
+
+    if (w->tail) {
+        w->tail->next = c;
+    } else {
+        w->head = c;
+    }
+    w->tail = c;
+    w->queued++;
+    w->end = MAX(w->end, offset + len);
+
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->mtx);
+
+    return RR_OK;
+}
+
+/* Waits until all queued chunks are written, then releases the preallocated
+ * space beyond the written data, calls fsync() and closes the file. */
+int snapshotWriterFinish(SnapshotWriter *w)
+{
+    int ret = RR_OK;
+
+    if (w->fd == -1) {
+        return RR_OK;
+    }
+
+    pthread_mutex_lock(&w->mtx);
+    waitUntilIdle(w);
+    int err = w->err;
+    pthread_mutex_unlock(&w->mtx);
+
+    if (err != 0) {
+        LOG_WARNING("write() failure for the snapshot file, error: %s \n",
+                    strerror(err));
+        ret = RR_ERROR;
+    } else if (w->allocated > w->end &&
+               ftruncate(w->fd, (off_t) w->end) != 0) {
+        LOG_WARNING("ftruncate() failure for the snapshot file, error: %s \n",
+                    strerror(errno));
+        ret = RR_ERROR;
+    } else if (fsyncFile(w->fd) != RR_OK) {
+        LOG_WARNING("fsyncFile() failure for the snapshot file, error: %s \n",
+                    strerror(errno));
+        ret = RR_ERROR;
+    }
+
+    if (close(w->fd) != 0) {
+        LOG_WARNING("close() failure for the snapshot file, error: %s \n",
+                    strerror(errno));
+    }
+    w->fd = -1;
+
+    return ret;
+}
+
+/* Drops the queued chunks and closes the file, if open. */
+void snapshotWriterDiscard(SnapshotWriter *w)
+{
+    if (w->fd == -1) {
+        return;
+    }
+
+    pthread_mutex_lock(&w->mtx);
+    freeChunks(w);
+    waitUntilIdle(w);
+    pthread_mutex_unlock(&w->mtx);
+
+    if (close(w->fd) != 0) {
+        LOG_WARNING("close() failure for the snapshot file, error: %s \n",
+                    strerror(errno));
+    }
+    w->fd = -1;
+}
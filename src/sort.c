@@ -115,7 +115,7 @@ early_exit:
 /* Calls Redis commands whose results can be sorted without semantically breaking them */
 void handleSort(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
 {
-    int flags = CommandSpecTableGetFlags(redis_raft.commands_spec_table, redis_raft.subcommand_spec_tables, argv[0], NULL);
+    int flags = CommandSpecTableGetFlags(redis_raft.commands_spec_table, argv[0], NULL);
     if (flags == -1 || !(flags & CMD_SPEC_SORT_REPLY)) {
         RedisModule_ReplyWithError(ctx, "ERR not a sortable command");
         return;
@@ -522,3 +522,78 @@ int syncRename(const char *oldname, const char *newname)
     fsyncDir(oldname);
     return RR_OK;
 }
+
+/* Arena allocator for short-lived objects that are all released at once.
+ *
+ * Allocations are served from a single buffer. If it is full, allocations
+ * fall back to separate chunks, and the buffer is grown on the next reset so
+ * it fits the peak usage, up to ARENA_MAX_RETAINED bytes.
+ */
+#define ARENA_ALIGN          16
+#define ARENA_MAX_RETAINED   (1024 * 1024)
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    char data[] __attribute__((aligned(ARENA_ALIGN)));
+} ArenaChunk;
+
+void *ArenaAlloc(Arena *a, size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+    a->peak += size;
+
+    if (a->buf && a->size - a->used >= size) {
+        void *p = a->buf + a->used;
+        a->used += size;
+        return p;
+    }
+
+    ArenaChunk *chunk = RedisModule_Alloc(sizeof(*chunk) + size);
+    chunk->next = a->chunks;
+    a->chunks = chunk;
+
+    return chunk->data;
+}
+
+void *ArenaCalloc(Arena *a, size_t nmemb, size_t size)
+{
+    void *p = ArenaAlloc(a, nmemb * size);
+    memset(p, 0, nmemb * size);
+    return p;
+}
+
+/* Release all allocations. */
+void ArenaReset(Arena *a)
+{
+    while (a->chunks) {
+        ArenaChunk *next = a->chunks->next;
+        RedisModule_Free(a->chunks);
+        a->chunks = next;
+    }
+
+    if (a->peak > a->size && a->size < ARENA_MAX_RETAINED) {
+        size_t size = a->size ? a->size : 4096;
+        while (size < a->peak && size < ARENA_MAX_RETAINED) {
+            size *= 2;
+        }
+
+        RedisModule_Free(a->buf);
+        a->buf = RedisModule_Alloc(size);
+        a->size = size;
+    }
+
+    a->used = 0;
+    a->peak = 0;
+}
+
+void ArenaFree(Arena *a)
+{
+    while (a->chunks) {
+        ArenaChunk *next = a->chunks->next;
+        RedisModule_Free(a->chunks);
+        a->chunks = next;
+    }
+
+    RedisModule_Free(a->buf);
+    *a = (Arena){0};
+}
@@ -190,9 +190,64 @@ class LogEntry(RawEntry):
             self.data(decode=True))
 
 
+class BinaryLogEntry(LogEntry):
+    # Version 2 entry header: term, session, id, type, length, crc
+    HEADER = struct.Struct('<qQiiII')
+
+    @classmethod
+    def from_file(cls, _file):
+        offset = _file.tell()
+        hdr = _file.read(cls.HEADER.size)
+        if not hdr:
+            raise EOFError('End of file reading entry header')
+        if len(hdr) != cls.HEADER.size:
+            raise RuntimeError('Partial entry header')
+
+        term, session, _id, _type, length, crc = cls.HEADER.unpack(hdr)
+        data = _file.read(length)
+        if len(data) != length:
+            raise RuntimeError('Partial entry data')
+
+        args = [b'ENTRY', term, _id, session, _type, data, crc]
+        locations = [offset, offset, offset + 16, offset + 8, offset + 20,
+                     offset + cls.HEADER.size, offset + 28]
+        return cls(args, locations)
+
+    def data_location(self):
+        return int(self.locations[5])
+
+    def crc(self):
+        return int(self.args[6])
+
+    def crc_location(self):
+        return int(self.locations[6])
+
+
+def read_manifest(filename):
+    """
+    Returns the segment file names listed in the manifest file of the log,
+    or just the log file if there is no manifest.
+    """
+    try:
+        with open(filename + '.manifest', 'rb') as f:
+            lines = f.read().split(b'\r\n')
+    except FileNotFoundError:
+        return [filename]
+
+    values = [line for line in lines if line and line[:1] not in (b'*', b'$')]
+    assert values[0] == b'MANIFEST'
+
+    segments = []
+    for seq in values[5:]:
+        seq = int(seq)
+        segments.append(filename if seq == 0 else '{}.{}'.format(filename, seq))
+    return segments
+
+
 class RaftLog(object):
     def __init__(self, filename):
-        self.logfile = open(filename, 'rb')
+        self.segments = read_manifest(filename)
+        self.logfile = open(self.segments[0], 'rb')
         self.entries = []
         self.indexes = []
 
@@ -201,15 +256,26 @@ class RaftLog(object):
         self.indexes = []
         self.logfile.seek(0, os.SEEK_SET)
 
-    def read(self):
+    def read_segment(self, logfile):
+        entry_class = RawEntry
         while True:
-            offset = self.logfile.tell()
+            offset = logfile.tell()
             try:
-                entry = RawEntry.from_file(self.logfile)
+                entry = entry_class.from_file(logfile)
             except EOFError:
                 break
             self.entries.append(entry)
             self.indexes.append(offset)
+
+            # Entries of version 2 pages use binary encoding
+            if isinstance(entry, LogHeader) and entry.version() >= 2:
+                entry_class = BinaryLogEntry
+
+    def read(self):
+        self.read_segment(self.logfile)
+        for segment in self.segments[1:]:
+            with open(segment, 'rb') as f:
+                self.read_segment(f)
         self.dump()
 
     def header(self) -> LogHeader:
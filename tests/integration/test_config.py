@@ -34,17 +34,31 @@ def test_config_sanity(cluster):
     verify('raft.snapshot-req-max-count', 999)
     verify('raft.snapshot-req-max-size', 999)
     verify('raft.log-max-cache-size', 999)
+    verify('raft.log-max-cache-pinned-size', 999)
     verify('raft.log-max-file-size', 999)
+    verify('raft.log-max-file-size-percentage', 999)
+    verify('raft.log-segment-size', 999)
+    verify('raft.log-fsync-delay', 999)
+    verify('raft.log-fsync-pending-bytes', 999)
+    verify('raft.write-batch-max-requests', 999)
+    verify('raft.log-compression-threshold', 999)
     verify('raft.scan-size', 999)
+    verify('raft.lease-clock-drift', 20)
     verify('raft.log-delay-apply', 999)
     verify('raft.snapshot-delay', 999)
 
     verify('raft.log-fsync', 'yes')
     verify('raft.log-fsync', 'no')
+    verify('raft.log-fsync-follower-async', 'yes')
+    verify('raft.log-fsync-follower-async', 'no')
     verify('raft.follower-proxy', 'yes')
     verify('raft.follower-proxy', 'no')
     verify('raft.quorum-reads', 'yes')
     verify('raft.quorum-reads', 'no')
+    verify('raft.lease-reads', 'yes')
+    verify('raft.lease-reads', 'no')
+    verify('raft.follower-reads', 'yes')
+    verify('raft.follower-reads', 'no')
     verify('raft.sharding', 'yes')
     verify('raft.sharding', 'no')
     verify('raft.tls-enabled', 'no')
@@ -160,13 +174,24 @@ def test_config_args(cluster):
                  'snapshot-req-max-count':     8111,
                  'snapshot-req-max-size':      8112,
                  'log-max-cache-size':         8011,
+                 'log-max-cache-pinned-size':  8019,
                  'log-max-file-size':          8012,
+                 'log-max-file-size-percentage': 8022,
+                 'log-segment-size':           8018,
+                 'log-fsync-delay':            8016,
+                 'log-fsync-pending-bytes':    8017,
+                 'write-batch-max-requests':   8020,
+                 'log-compression-threshold':  8021,
+                 'lease-clock-drift':          17,
                  'scan-size':                  8013,
                  'log-delay-apply':            8014,
                  'snapshot-delay':             8015,
                  'log-fsync':                  'no',
+                 'log-fsync-follower-async':   'no',
                  'follower-proxy':             'yes',
                  'quorum-reads':               'no',
+                 'lease-reads':                'yes',
+                 'follower-reads':             'yes',
                  'sharding':                   'yes',
                  'external-sharding':          'yes',
                  'tls-enabled':                'no',
@@ -229,14 +254,25 @@ def test_invalid_configs(cluster):
     verify_failure('raft.snapshot-req-max-size', 0)
     verify_failure('raft.snapshot-req-max-size', -1)
     verify_failure('raft.log-max-cache-size', -1)
+    verify_failure('raft.log-max-cache-pinned-size', -1)
     verify_failure('raft.log-max-file-size', -1)
+    verify_failure('raft.log-max-file-size-percentage', -1)
+    verify_failure('raft.log-segment-size', -1)
+    verify_failure('raft.log-fsync-delay', -1)
+    verify_failure('raft.log-fsync-pending-bytes', 0)
+    verify_failure('raft.write-batch-max-requests', -1)
+    verify_failure('raft.log-compression-threshold', -1)
     verify_failure('raft.scan-size', -1)
+    verify_failure('raft.lease-clock-drift', 100)
     verify_failure('raft.log-delay-apply', -1)
     verify_failure('raft.snapshot-delay', -1)
 
     verify_failure('raft.log-fsync', 'someinvalidvalue')
+    verify_failure('raft.log-fsync-follower-async', 'someinvalidvalue')
     verify_failure('raft.follower-proxy', 'someinvalidvalue')
     verify_failure('raft.quorum-reads', 'someinvalidvalue')
+    verify_failure('raft.lease-reads', 'someinvalidvalue')
+    verify_failure('raft.follower-reads', 'someinvalidvalue')
     verify_failure('raft.sharding', 'someinvalidvalue')
     verify_failure('raft.tls-enabled', 'someinvalidvalue')
     verify_failure('raft.log-disable-apply', 'someinvalidvalue')
@@ -5,10 +5,12 @@ or the Server Side Public License v1 (SSPLv1).
 """
 
 import os.path
+import threading
 import time
 from random import seed, randint
 from re import match
 
+import redis
 from pytest import raises
 from redis import ResponseError
 from .raftlog import RaftLog, LogHeader, LogEntry
@@ -180,6 +182,36 @@ def test_raft_log_max_file_size(cluster):
     assert r1.info()['raft_log_entries'] < r1.info()['raft_current_index']
 
 
+def test_raft_log_max_file_size_percentage(cluster):
+    """
+    Compaction is delayed until the log file grows beyond a percentage of the
+    last snapshot size.
+    """
+
+    r1 = cluster.add_node()
+    assert r1.config_set('raft.log-max-file-size-percentage', 100)
+    for i in range(100):
+        assert r1.client.set(f'key{i}', 'x' * 1000)
+
+    # There is no snapshot yet, so log-max-file-size applies
+    assert r1.config_set('raft.log-max-file-size', '1kb')
+    r1.wait_for_info_param('raft_snapshots_created', 1)
+    r1.wait_for_info_param('raft_snapshot_in_progress', 'no')
+
+    # Writes smaller than the snapshot do not trigger compaction
+    for _ in range(10):
+        assert r1.client.set('testkey', 'x' * 500)
+
+    time.sleep(1)
+    assert r1.info()['raft_snapshots_created'] == 1
+
+    # Once the log file is larger than the snapshot, compaction resumes
+    for _ in range(200):
+        assert r1.client.set('testkey', 'x' * 1000)
+
+    r1.wait_for_info_param('raft_snapshots_created', 2)
+
+
 def test_raft_log_max_cache_size(cluster):
     """
     Raft log cache configuration in effect.
@@ -204,6 +236,30 @@ def test_raft_log_max_cache_size(cluster):
     assert info['raft_cache_entries'] < 6
 
 
+def test_raft_log_cache_follower_stats(cluster):
+    """
+    Entries sent to followers are served from the log cache and counted
+    per follower.
+    """
+
+    cluster.create(3)
+    n1 = cluster.node(1)
+
+    for _ in range(10):
+        assert n1.client.set('testkey', 'testvalue')
+    cluster.wait_for_unanimity()
+
+    info = n1.info()
+    followers = [v for k, v in info.items()
+                 if k.startswith('raft_node') and isinstance(v, dict)]
+    assert len(followers) == 2
+    for follower in followers:
+        assert follower['cache_hits'] > 0
+        assert follower['cache_misses'] == 0
+    assert info['raft_cache_hits'] > 0
+    assert info['raft_cache_pinned_evictions'] == 0
+
+
 def test_reply_to_cache_invalidated_entry(cluster):
     """
     Reply a RAFT redis command that have its entry already removed
@@ -351,6 +407,77 @@ def corrupt_byte_location(filename, location):
     file.close()
 
 
+def test_log_load_index_file(cluster):
+    """
+    Verify entries are loaded when the index file is reused, corrupt or
+    missing. Enough entries are written so that verification is split
+    across threads.
+    """
+    cluster.create(1)
+    n1 = cluster.node(1)
+
+    pipe = n1.client.pipeline(transaction=False)
+    for i in range(5000):
+        pipe.incr('x')
+    pipe.execute()
+
+    entries = n1.info()['raft_log_entries']
+    assert entries > 5000
+
+    # Valid index file
+    n1.restart()
+    n1.wait_for_election()
+    assert n1.info()['raft_log_entries'] == entries + 1
+    assert cluster.execute('get', 'x') == b'5000'
+
+    # Corrupt index file
+    entries = n1.info()['raft_log_entries']
+    n1.kill()
+    corrupt_byte_location(n1.raftlogidx,
+                          os.path.getsize(n1.raftlogidx) // 2)
+    n1.start()
+    n1.wait_for_election()
+    assert n1.info()['raft_log_entries'] == entries + 1
+    assert cluster.execute('get', 'x') == b'5000'
+
+    # Missing index file
+    entries = n1.info()['raft_log_entries']
+    n1.kill()
+    os.unlink(n1.raftlogidx)
+    n1.start()
+    n1.wait_for_election()
+    assert n1.info()['raft_log_entries'] == entries + 1
+    assert cluster.execute('get', 'x') == b'5000'
+
+
+def test_log_segments(cluster):
+    """
+    Verify the log is split into segments, survives a restart and compaction
+    deletes the segments included in the snapshot.
+    """
+    cluster.create(1, raft_args={'log-segment-size': 1000})
+    n1 = cluster.node(1)
+
+    for i in range(100):
+        n1.execute('set', 'x', 'a' * 50)
+    n1.execute('incr', 'y')
+
+    assert n1.info()['raft_segments'] > 1
+
+    n1.restart()
+    n1.wait_for_election()
+    assert n1.info()['raft_segments'] > 1
+    assert n1.execute('get', 'y') == b'1'
+
+    assert n1.execute('raft.debug', 'compact') == b'OK'
+    assert n1.info()['raft_segments'] == 1
+    assert not os.path.exists(n1.raftlog)
+
+    n1.restart()
+    n1.wait_for_election()
+    assert n1.execute('get', 'y') == b'1'
+
+
 def test_log_corrupt_header_dbid(cluster):
     cluster.create(1)
 
@@ -625,3 +752,166 @@ def test_startup_with_more_advanced_snapshot(cluster):
     cluster.execute('incr', 'x')
     assert cluster.execute('get', 'x') == b'4'
     assert n3.info()['raft_current_index'] == 12
+
+
+def test_log_fsync_group_commit(cluster):
+    """
+    With log-fsync-delay, writes of concurrent clients are coalesced into
+    fewer fsync() calls.
+    """
+
+    r1 = cluster.add_node(raft_args={'log-fsync': 'yes',
+                                     'log-fsync-delay': 50000})
+
+    def worker():
+        client = redis.Redis(host='localhost', port=r1.port)
+        for _ in range(10):
+            client.incr('x')
+        client.close()
+
+    threads = [threading.Thread(target=worker) for _ in range(10)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    assert r1.execute('get', 'x') == b'100'
+
+    info = r1.info()
+    assert info['raft_fsync_count'] < 100
+    assert info['raft_fsync_max_batch_entries'] > 1
+
+
+def test_log_write_batching(cluster):
+    """
+    With write-batch-max-requests, writes of concurrent clients are appended
+    as batch entries, and every client gets its own reply.
+    """
+
+    cluster.create(3, raft_args={'write-batch-max-requests': 100})
+
+    def worker(i):
+        client = redis.Redis(host='localhost', port=cluster.leader_node().port)
+        for j in range(10):
+            assert client.incr('x') > 0
+            assert client.set('key-{}-{}'.format(i, j), j)
+        client.close()
+
+    threads = [threading.Thread(target=worker, args=(i,)) for i in range(10)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    assert cluster.execute('get', 'x') == b'100'
+    assert cluster.execute('get', 'key-9-9') == b'9'
+
+    info = cluster.leader_node().info()
+    assert info['raft_write_batches'] > 0
+    assert info['raft_write_batch_requests'] > info['raft_write_batches']
+
+    cluster.wait_for_unanimity()
+    n3 = cluster.node(3)
+    n3.restart()
+    n3.wait_for_node_voting()
+    n3.wait_for_log_applied()
+    assert n3.raft_debug_exec('get', 'x') == b'100'
+    assert n3.raft_debug_exec('get', 'key-9-9') == b'9'
+
+
+def test_log_write_batching_unknown_node(cluster):
+    """
+    Writes are not batched while a node may not support batch entries, e.g.
+    it is not connected.
+    """
+
+    cluster.create(3, raft_args={'write-batch-max-requests': 100})
+    cluster.node(3).kill()
+
+    batches = cluster.leader_node().info()['raft_write_batches']
+    for i in range(10):
+        assert cluster.execute('set', 'key', i)
+    assert cluster.leader_node().info()['raft_write_batches'] == batches
+
+
+def test_log_compression(cluster):
+    """
+    Entries above log-compression-threshold are compressed in the log and
+    replicated compressed, and are applied and reloaded as usual.
+    """
+
+    cluster.create(3, raft_args={'log-compression-threshold': 1000,
+                                 'write-batch-max-requests': 10})
+
+    value = '{"field": "value", "count": 1234}' * 1000
+    for i in range(10):
+        assert cluster.execute('set', 'key-{}'.format(i), value)
+    assert cluster.execute('set', 'small', 'x')
+
+    info = cluster.leader_node().info()
+    assert info['raft_compressed_entries'] >= 10
+    assert info['raft_compression_saved_bytes'] > 10 * len(value) / 2
+
+    cluster.wait_for_unanimity()
+    assert cluster.node(2).raft_debug_exec('get', 'key-9') == value.encode()
+
+    n3 = cluster.node(3)
+    n3.restart()
+    n3.wait_for_node_voting()
+    n3.wait_for_log_applied()
+    assert n3.raft_debug_exec('get', 'key-9') == value.encode()
+    assert n3.raft_debug_exec('get', 'small') == b'x'
+
+
+def test_log_fsync_follower_async(cluster):
+    """
+    Followers acknowledge entries once they are fsync'd by the fsync thread,
+    and the entries survive a restart.
+    """
+
+    cluster.create(3, raft_args={'log-fsync': 'yes'})
+    n2 = cluster.node(2)
+    n3 = cluster.node(3)
+    n3.config_set('raft.log-fsync-follower-async', 'no')
+
+    for _ in range(100):
+        cluster.execute('incr', 'x')
+
+    cluster.wait_for_unanimity()
+    assert n2.info()['raft_appendreq_deferred'] > 0
+    assert n3.info()['raft_appendreq_deferred'] == 0
+    assert n2.info()['raft_fsync_count'] > 0
+
+    n2.restart()
+    n2.wait_for_node_voting()
+    assert n2.raft_debug_exec('get', 'x') == b'100'
+
+
+def test_log_fsync_follower_async_pipelined(cluster):
+    """
+    Followers keep handling appendreq messages while an fsync() is in flight,
+    so a single fsync() acknowledges several messages.
+    """
+
+    cluster.create(3, raft_args={'log-fsync': 'yes',
+                                 'write-batch-max-requests': 0})
+    n2 = cluster.node(2)
+
+    def worker():
+        client = redis.Redis(host='localhost', port=cluster.node(1).port)
+        for _ in range(20):
+            client.incr('x')
+        client.close()
+
+    threads = [threading.Thread(target=worker) for _ in range(10)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    cluster.wait_for_unanimity()
+    assert n2.raft_debug_exec('get', 'x') == b'200'
+
+    info = n2.info()
+    assert info['raft_appendreq_deferred'] > 0
+    assert info['raft_fsync_count'] < info['raft_appendreq_with_entry_received']
@@ -192,6 +192,53 @@ def test_readonly_commands(cluster):
     assert cluster.node(1).client.get('key') == b'value'
 
 
+def test_lease_reads(cluster):
+    """
+    Test reads served by the leader while it holds a lease, and falling back
+    to quorum reads once the lease expires.
+    """
+    cluster.create(3, raft_args={'lease-reads': 'yes',
+                                 'election-timeout': 2000})
+    assert cluster.leader == 1
+
+    assert cluster.node(1).client.set('key', 'value')
+    assert cluster.node(1).client.get('key') == b'value'
+    assert cluster.node(1).info()['raft_lease_reads'] > 0
+
+    # Tear down cluster, once the lease expires reads should hang
+    cluster.node(2).terminate()
+    cluster.node(3).terminate()
+    time.sleep(2)
+
+    conn = cluster.node(1).client.connection_pool.get_connection(
+        'RAFT', socket_timeout=1)
+    conn.send_command('GET', 'key')
+    assert not conn.can_read(timeout=1)
+
+
+def test_follower_reads(cluster):
+    """
+    Followers serve read-only commands locally using a read index from the
+    leader, other commands are still redirected.
+    """
+    cluster.create(3, raft_args={'follower-reads': 'yes'})
+    assert cluster.leader == 1
+
+    assert cluster.node(1).client.set('key', 'value')
+    assert cluster.node(2).client.get('key') == b'value'
+    assert cluster.node(3).client.get('key') == b'value'
+    assert cluster.node(2).info()['raft_follower_reads'] == 1
+
+    with raises(ResponseError, match='MOVED'):
+        cluster.node(2).client.set('key', 'value2')
+
+    # Without a quorum, the leader can't provide a read index
+    cluster.node(1).terminate()
+    cluster.node(3).terminate()
+    with raises(ResponseError):
+        cluster.node(2).client.get('key')
+
+
 def test_nonquorum_reads(cluster):
     """
     Test non-quorum reads, requests are not processed until an entry from the
@@ -642,6 +689,34 @@ def test_acl(cluster):
         return 1234;""", '0')
 
 
+def test_cached_command_checks(cluster):
+    """
+    Commands are validated without a dry run when possible, ACL changes are
+    still honored.
+    """
+    cluster.create(1)
+    node = cluster.node(1)
+
+    node.execute('set', 'key', 1)
+    node.execute('set', 'key', 2)
+    assert node.info()['raft_cmd_checks_cached'] >= 2
+
+    # Errors are still reported by the dry run
+    with raises(ResponseError, match="wrong number of arguments"):
+        node.execute('set', 'key')
+    with raises(ResponseError, match="unknown command"):
+        node.execute('nosuchcommand', 'key')
+
+    node.execute('acl', 'setuser', 'default', 'resetkeys', '~key*')
+    node.execute('set', 'key', 3)
+    with raises(ResponseError, match="No permissions to access a key"):
+        node.execute('set', 'abc', 1)
+
+    node.execute('acl', 'setuser', 'default', 'allkeys')
+    node.execute('set', 'abc', 1)
+    assert node.execute('get', 'abc') == b'1'
+
+
 def test_ro_permutations(cluster):
     cluster.create(3)
 
@@ -902,3 +977,154 @@ def test_session_same_id_clients_persisting(cluster):
     with raises(ConnectionError, match="Connection (closed|reset)"):
         conn1.execute("get", "X")
     conn2.execute("get", "X")
+
+
+def test_latency(cluster):
+    """
+    RAFT.LATENCY reports the stages of writes, and can be reset.
+    """
+
+    cluster.create(3)
+    for i in range(10):
+        assert cluster.execute('SET', f'key{i}', 'value') == b'OK'
+
+    leader = cluster.leader_node()
+    stats = leader.execute('RAFT.LATENCY')
+    stats = {stats[i]: stats[i + 1] for i in range(0, len(stats), 2)}
+
+    for stage in [b'append', b'replicate', b'commit', b'apply', b'total']:
+        fields = stats[stage]
+        fields = {fields[i]: fields[i + 1] for i in range(0, len(fields), 2)}
+        assert fields[b'count'] >= 10
+        assert fields[b'p50'] <= fields[b'max']
+
+    assert leader.execute('RAFT.LATENCY', 'RESET') == b'OK'
+    stats = leader.execute('RAFT.LATENCY')
+    assert stats[1][1] == 0
+
+    with raises(ResponseError, match='unknown RAFT.LATENCY subcommand'):
+        leader.execute('RAFT.LATENCY', 'FOO')
+
+
+def test_nodestats(cluster):
+    """
+    RAFT.NODESTATS reports replication statistics of the other nodes.
+    """
+
+    cluster.create(3)
+    for i in range(10):
+        assert cluster.execute('SET', f'key{i}', 'value') == b'OK'
+    cluster.wait_for_unanimity()
+
+    leader = cluster.leader_node()
+    stats = leader.execute('RAFT.NODESTATS')
+    assert len(stats) == 2
+
+    for node in stats:
+        node = {node[i]: node[i + 1] for i in range(0, len(node), 2)}
+        assert node[b'lag_entries'] == 0
+        assert node[b'lag_bytes'] == 0
+        assert node[b'ae_entries'] >= 10
+        assert node[b'rtt_p50'] <= node[b'rtt_max']
+
+        hist = node[b'ae_batch_entries']
+        assert sum(hist[i + 1] for i in range(0, len(hist), 2)) == \
+               node[b'ae_msgs']
+
+    info = leader.info()
+    assert info['raft_node1']['inflight_msgs'] >= 0
+    assert 'rtt_p99_microseconds' in info['raft_node1']
+
+
+def test_appendentries_flow_control(cluster):
+    """
+    The appendreq window and batch size adapt within the configured caps.
+    """
+
+    cluster.create(1)
+    for i in range(1000):
+        cluster.execute('set', 'x', 'a' * 1000)
+
+    n2 = cluster.add_node()
+    cluster.wait_for_unanimity()
+
+    def nodestats():
+        stats = cluster.leader_node().execute('RAFT.NODESTATS')
+        return {stats[0][i]: stats[0][i + 1]
+                for i in range(0, len(stats[0]), 2)}
+
+    stats = nodestats()
+    assert 1 <= stats[b'ae_window'] <= 2
+    assert stats[b'ae_batch_size'] <= 2 * 1024 * 1024
+    assert n2.info()['raft_appendreq_with_entry_received'] > 0
+
+    cluster.config_set('raft.append-req-max-count', 1)
+    cluster.config_set('raft.append-req-max-size', '1kb')
+
+    stats = nodestats()
+    assert stats[b'ae_window'] == 1
+    assert stats[b'ae_batch_size'] == 1024
+
+
+def test_priority_connection(cluster):
+    """
+    Votes are sent over the priority connection, and keepalives keep the
+    leader stable while a node receives large appendreq messages.
+    """
+
+    cluster.create(3)
+
+    @retry(delay=1, tries=10)
+    def assert_priority_connected():
+        for node in cluster.nodes.values():
+            info = node.info()
+            assert info['raft_node0']['priority_state'] == 'connected'
+            assert info['raft_node1']['priority_state'] == 'connected'
+
+    assert_priority_connected()
+
+    # Large entries keep appendreq messages in flight
+    cluster.config_set('raft.append-req-max-size', '64mb')
+    term = cluster.leader_node().info()['raft_current_term']
+    for i in range(10):
+        cluster.execute('set', f'key{i}', 'x' * 4 * 1024 * 1024)
+    cluster.wait_for_unanimity()
+    assert cluster.leader_node().info()['raft_current_term'] == term
+
+    # A new leader is elected over the priority connections
+    leader = cluster.leader_node()
+    leader.kill()
+    follower = cluster.follower_node()
+    follower.wait_for_leader_change(leader.id)
+
+
+def test_appendentries_text_fallback(cluster):
+    """
+    Nodes that reject RAFT.AEBIN, e.g. older versions during a rolling
+    upgrade or if it is not permitted, keep replicating over the text-based
+    RAFT.AE.
+    """
+
+    cluster.create(3)
+    assert cluster.leader == 1
+
+    # An unknown encoding version is rejected with the error the leader
+    # falls back on
+    with raises(ResponseError, match='unsupported RAFT.AEBIN'):
+        cluster.node(2).execute('RAFT.AEBIN', 2, 1, b'\xff' * 64)
+
+    cluster.execute('set', 'key', 'value1')
+    cluster.wait_for_unanimity()
+
+    for node_id in (2, 3):
+        cluster.node(node_id).execute('acl', 'setuser', 'default',
+                                      '-raft.aebin')
+
+    for i in range(10):
+        cluster.execute('set', 'key', f'value{i}')
+    cluster.wait_for_unanimity()
+
+    for node_id in (2, 3):
+        node = cluster.node(node_id)
+        node.wait_for_log_applied()
+        assert node.raft_debug_exec('get', 'key') == b'value9'
@@ -7,6 +7,7 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "cmocka.h"
@@ -18,6 +19,9 @@
 
 struct RedisModuleString;
 
+/* Returned by RedisModule_MonotonicMicroseconds(), tests may advance it */
+extern uint64_t mock_monotonic_time;
+
 static inline const char *mock_StringPtrLen(const struct RedisModuleString *s, size_t *len)
 {
     *len = strlen((char *) s);
@@ -44,6 +48,7 @@ static inline char *mock_Strdup(const char *s)
 #define RedisModule_StringPtrLen(__s, __len)        mock_StringPtrLen(__s, __len)
 #define RedisModule_CreateString(__ctx, __s, __len) mock_CreateString(__s, __len)
 #define RedisModule_FreeString(__ctx, __s)          test_free(__s)
-#define RedisModule_MonotonicMicroseconds()         0
+#define RedisModule_MonotonicMicroseconds()         mock_monotonic_time
+#define RedisModule_Milliseconds()                  0
 #define RedisModule_Strdup(__s)                     mock_Strdup(__s)
 #define RedisModule_Log(...)
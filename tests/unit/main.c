@@ -12,8 +12,10 @@
 
 #include "cmocka.h"
 
+extern struct CMUnitTest commands_tests[];
 extern struct CMUnitTest file_tests[];
 extern struct CMUnitTest log_tests[];
+extern struct CMUnitTest node_tests[];
 extern struct CMUnitTest util_tests[];
 extern struct CMUnitTest serialization_tests[];
 
@@ -31,6 +33,8 @@ int tests_count(struct CMUnitTest *tests)
 
 extern FILE *redis_raft_logfile;
 
+uint64_t mock_monotonic_time = 0;
+
 static void *__raft_malloc_stub(size_t size)
 {
     return test_malloc(size);
@@ -57,9 +61,13 @@ int main(int argc, char *argv[])
                             __raft_realloc_stub, __raft_free_stub);
 
     return _cmocka_run_group_tests(
+               "commands", commands_tests, tests_count(commands_tests), NULL, NULL) ||
+           _cmocka_run_group_tests(
                "file", file_tests, tests_count(file_tests), NULL, NULL) ||
            _cmocka_run_group_tests(
                "log", log_tests, tests_count(log_tests), NULL, NULL) ||
+           _cmocka_run_group_tests(
+               "node", node_tests, tests_count(node_tests), NULL, NULL) ||
            _cmocka_run_group_tests(
                "util", util_tests, tests_count(util_tests), NULL, NULL) ||
            _cmocka_run_group_tests(
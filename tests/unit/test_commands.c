@@ -0,0 +1,148 @@
+/*
+ * Copyright Redis Ltd. 2020 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+#include "../src/redisraft.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "cmocka.h"
+
+#define NUM_GENERATED 300
+
+/* The mocked RedisModule_StringPtrLen() takes a C string */
+#define STR(s) ((RedisModuleString *) (s))
+
+static char generated_names[NUM_GENERATED][16];
+
+static CommandSpec base_specs[] = {
+    {"get",        CMD_SPEC_READONLY                            },
+    {"eval_ro",    CMD_SPEC_SCRIPTS                             },
+    {"raft.entry", CMD_SPEC_DONT_INTERCEPT                      },
+    {"client",     CMD_SPEC_SUBCOMMAND | CMD_SPEC_DONT_INTERCEPT},
+};
+
+#define NUM_BASE (sizeof(base_specs) / sizeof(base_specs[0]))
+
+/* Base specs, a number of generated ones to fill the table and, optionally,
+ * extra specs appended last.
+ */
+static size_t buildIndex(CommandSpecTable *t, CommandSpec *gen, CommandSpec *extra, size_t num_extra)
+{
+    CommandSpec *specs[NUM_BASE + NUM_GENERATED + 4];
+    size_t n = 0;
+
+    for (size_t i = 0; i < NUM_BASE; i++) {
+        specs[n++] = &base_specs[i];
+    }
+    for (size_t i = 0; i < NUM_GENERATED; i++) {
+        snprintf(generated_names[i], sizeof(generated_names[i]), "cmd%d", (int) i);
+        gen[i] = (CommandSpec){generated_names[i], CMD_SPEC_WRITE};
+        specs[n++] = &gen[i];
+    }
+    for (size_t i = 0; i < num_extra; i++) {
+        specs[n++] = &extra[i];
+    }
+
+    CommandSpecTableBuildIndex(t, specs, n);
+    return n;
+}
+
+static void test_command_spec_lookup(void **state)
+{
+    CommandSpecTable t = {0};
+    CommandSpec gen[NUM_GENERATED];
+
+    buildIndex(&t, gen, NULL, 0);
+
+    /* Every spec is found, whatever the case of the name */
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("get"), NULL), CMD_SPEC_READONLY);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("GeT"), NULL), CMD_SPEC_READONLY);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("EVAL_RO"), NULL), CMD_SPEC_SCRIPTS);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("Raft.Entry"), NULL), CMD_SPEC_DONT_INTERCEPT);
+    for (int i = 0; i < NUM_GENERATED; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "CMD%d", i);
+        assert_int_equal(CommandSpecTableGetFlags(&t, STR(name), NULL), CMD_SPEC_WRITE);
+    }
+
+    /* Absent names. The hash maps non-letters with the case bit, so the first
+     * two hash to the slots of raft.entry and eval_ro and are only told apart
+     * by the compare. */
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("raft\x0e" "entry"), NULL), -1);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("eval\x7fro"), NULL), -1);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("ge"), NULL), -1);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("gets"), NULL), -1);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR(""), NULL), -1);
+    for (int i = NUM_GENERATED; i < 4 * NUM_GENERATED; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "cmd%d", i);
+        assert_int_equal(CommandSpecTableGetFlags(&t, STR(name), NULL), -1);
+    }
+
+    CommandSpecTableClear(&t);
+}
+
+static void test_command_spec_rebuild(void **state)
+{
+    CommandSpecTable t = {0};
+    CommandSpec gen[NUM_GENERATED];
+    CommandSpec module_specs[] = {
+        {"mymodule.get", CMD_SPEC_READONLY},
+        {"mymodule.set", CMD_SPEC_WRITE   },
+    };
+
+    buildIndex(&t, gen, NULL, 0);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("mymodule.get"), NULL), -1);
+
+    /* A module is loaded, the index is rebuilt with its commands */
+    buildIndex(&t, gen, module_specs, 2);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("MyModule.Get"), NULL), CMD_SPEC_READONLY);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("mymodule.set"), NULL), CMD_SPEC_WRITE);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("get"), NULL), CMD_SPEC_READONLY);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("client"), NULL),
+                     CMD_SPEC_SUBCOMMAND | CMD_SPEC_DONT_INTERCEPT);
+    for (int i = 0; i < NUM_GENERATED; i++) {
+        assert_int_equal(CommandSpecTableGetFlags(&t, STR(generated_names[i]), NULL), CMD_SPEC_WRITE);
+    }
+
+    /* And without them once it is unloaded */
+    buildIndex(&t, gen, NULL, 0);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("mymodule.get"), NULL), -1);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("get"), NULL), CMD_SPEC_READONLY);
+
+    CommandSpecTableClear(&t);
+}
+
+static void test_command_spec_subcommands(void **state)
+{
+    CommandSpecTable t = {0};
+    CommandSpec gen[NUM_GENERATED];
+
+    buildIndex(&t, gen, NULL, 0);
+
+    /* Listed subcommand, from the subcommand table of the slot */
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("client"), STR("unblock")), 0);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("CLIENT"), STR("UnBlock")), 0);
+
+    /* Other subcommands get the flags of the command */
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("Client"), STR("list")), CMD_SPEC_DONT_INTERCEPT);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("client"), STR("unblocks")), CMD_SPEC_DONT_INTERCEPT);
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("client"), NULL),
+                     CMD_SPEC_SUBCOMMAND | CMD_SPEC_DONT_INTERCEPT);
+
+    /* Commands without subcommand specs ignore the subcommand */
+    assert_int_equal(CommandSpecTableGetFlags(&t, STR("get"), STR("unblock")), CMD_SPEC_READONLY);
+
+    CommandSpecTableClear(&t);
+}
+
+const struct CMUnitTest commands_tests[] = {
+    cmocka_unit_test(test_command_spec_lookup),
+    cmocka_unit_test(test_command_spec_rebuild),
+    cmocka_unit_test(test_command_spec_subcommands),
+    {.test_func = NULL},
+};
@@ -12,6 +12,7 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -22,6 +23,29 @@
 #define LOGNAME "test.log.db"
 #define DBID    "01234567890123456789012345678901"
 
+static void unlink_segments(void)
+{
+    char buf[PATH_MAX];
+
+    for (int i = 1; i < 5; i++) {
+        snprintf(buf, sizeof(buf), "%s.%d", LOGNAME, i);
+        unlink(buf);
+        snprintf(buf, sizeof(buf), "%s.%d.idx", LOGNAME, i);
+        unlink(buf);
+    }
+
+    unlink(LOGNAME);
+    unlink(LOGNAME ".idx");
+    unlink(LOGNAME ".manifest");
+}
+
+static int cleanup_log(void **state)
+{
+    (void) state;
+    unlink_segments();
+    return 0;
+}
+
 static int setup_create_log(void **state)
 {
     *state = malloc(sizeof(Log));
@@ -39,6 +63,7 @@ static int teardown_log(void **state)
     free(log);
     unlink(LOGNAME);
     unlink(LOGNAME ".idx");
+    unlink(LOGNAME ".manifest");
     return 0;
 }
 
@@ -121,7 +146,7 @@ static void test_log_load_entries(void **state)
     append_entry(log, 3, NULL);
     append_entry(log, 30, NULL);
 
-    assert_int_equal(LogLoadEntries(log), RR_OK);
+    assert_int_equal(LogLoadEntries(log, NULL), RR_OK);
     assert_int_equal(LogCount(log), 2);
 
     ety = LogGet(log, 1);
@@ -150,7 +175,7 @@ static void test_log_index_rebuild(void **state)
     Log log2;
     LogInit(&log2);
     LogOpen(&log2, LOGNAME);
-    LogLoadEntries(&log2);
+    LogLoadEntries(&log2, NULL);
 
     /* Invalid out of bound reads */
     assert_null(LogGet(log, 99));
@@ -169,6 +194,180 @@ static void test_log_index_rebuild(void **state)
     LogTerm(&log2);
 }
 
+static size_t read_file(const char *filename, char *buf, size_t cap)
+{
+    FILE *fp = fopen(filename, "r");
+    assert_non_null(fp);
+
+    size_t n = fread(buf, 1, cap, fp);
+    fclose(fp);
+
+    return n;
+}
+
+static void load_and_verify_entries(int count)
+{
+    Log log;
+
+    LogInit(&log);
+    assert_int_equal(LogOpen(&log, LOGNAME), RR_OK);
+    assert_int_equal(LogLoadEntries(&log, NULL), RR_OK);
+    assert_int_equal(LogCount(&log), count);
+
+    for (int i = 1; i <= count; i++) {
+        raft_entry_t *e = LogGet(&log, i);
+        assert_non_null(e);
+        assert_int_equal(e->id, i);
+        raft_entry_release(e);
+    }
+
+    LogTerm(&log);
+}
+
+/* Verify a valid index file is reused, and an invalid one is repaired. */
+static void test_log_index_reuse(void **state)
+{
+    Log *log = (Log *) *state;
+    char orig[4096], buf[4096];
+    int fd;
+
+    for (int i = 1; i <= 10; i++) {
+        append_entry(log, i, NULL);
+    }
+    LogSync(log, false);
+
+    size_t len = read_file(LOGNAME ".idx", orig, sizeof(orig));
+    assert_true(len > 0);
+
+    /* Valid index file is kept as it is */
+    load_and_verify_entries(10);
+    assert_int_equal(read_file(LOGNAME ".idx", buf, sizeof(buf)), len);
+    assert_memory_equal(buf, orig, len);
+
+    /* Corrupt a record in the middle */
+    fd = open(LOGNAME ".idx", O_RDWR);
+    assert_true(fd > 0);
+    assert_int_equal(pwrite(fd, "^", 1, (off_t) len / 2), 1);
+    close(fd);
+
+    load_and_verify_entries(10);
+    assert_int_equal(read_file(LOGNAME ".idx", buf, sizeof(buf)), len);
+    assert_memory_equal(buf, orig, len);
+
+    /* Missing records at the end */
+    assert_int_equal(truncate(LOGNAME ".idx", (off_t) len - 20), 0);
+
+    load_and_verify_entries(10);
+    assert_int_equal(read_file(LOGNAME ".idx", buf, sizeof(buf)), len);
+    assert_memory_equal(buf, orig, len);
+
+    /* Corrupt index header */
+    fd = open(LOGNAME ".idx", O_RDWR);
+    assert_true(fd > 0);
+    assert_int_equal(pwrite(fd, "^", 1, 0), 1);
+    close(fd);
+
+    load_and_verify_entries(10);
+    assert_int_equal(read_file(LOGNAME ".idx", buf, sizeof(buf)), len);
+    assert_memory_equal(buf, orig, len);
+}
+
+/* Verify a stale index file, which is not fsync'ed and may not match the log
+ * file after a crash, does not cause entries to be truncated. */
+static void test_log_index_stale(void **state)
+{
+    Log *log = (Log *) *state;
+    char orig[4096], buf[4096];
+
+    for (int i = 1; i <= 10; i++) {
+        append_entry(log, i, NULL);
+    }
+    LogSync(log, false);
+
+    size_t len = read_file(LOGNAME ".idx", orig, sizeof(orig));
+    assert_true(len > 0);
+
+    /* Replace the tail with entries of different sizes, so the offsets and
+     * crcs in the old index records no longer match. */
+    assert_int_equal(LogDelete(log, 6), RR_OK);
+    for (int i = 6; i <= 10; i++) {
+        append_entry(log, i, "a longer value than before");
+    }
+    LogSync(log, false);
+
+    size_t new_len = read_file(LOGNAME ".idx", buf, sizeof(buf));
+    assert_int_equal(new_len, len);
+
+    /* Restore the stale, but self-consistent, index file */
+    int fd = open(LOGNAME ".idx", O_WRONLY | O_TRUNC);
+    assert_true(fd > 0);
+    assert_int_equal(write(fd, orig, len), (ssize_t) len);
+    close(fd);
+
+    load_and_verify_entries(10);
+
+    /* The index file is rebuilt */
+    assert_int_equal(read_file(LOGNAME ".idx", orig, sizeof(orig)), new_len);
+    assert_memory_equal(orig, buf, new_len);
+}
+
+/* Verify entries of sealed segments are read through a mapping, which they
+ * hold after the log is closed, while the last segment is read with pread(). */
+static void test_log_mapped_entries(void **state)
+{
+    raft_entry_t *e1, *e2, *e3;
+    Log log;
+
+    LogInit(&log);
+    assert_int_equal(LogCreate(&log, LOGNAME, DBID, 1, 1, 0), RR_OK);
+
+    append_entry(&log, 1, NULL);
+    append_entry(&log, 2, NULL);
+    assert_int_equal(LogAddSegment(&log), RR_OK);
+    append_entry(&log, 3, NULL);
+
+    /* Entries of the last segment are copied */
+    e3 = LogGet(&log, 3);
+    assert_non_null(e3);
+    assert_int_equal(e3->id, 3);
+    assert_ptr_equal(e3->data, (char *) (e3 + 1));
+    raft_entry_release(e3);
+
+    /* Entries of sealed segments reference the mapping */
+    e1 = LogGet(&log, 1);
+    assert_non_null(e1);
+    assert_int_equal(e1->id, 1);
+    assert_ptr_not_equal(e1->data, (char *) (e1 + 1));
+    assert_memory_equal(e1->data, "value1", 6);
+    raft_entry_release(e1);
+
+    /* Truncating the sealed segment makes it the last one */
+    assert_int_equal(LogDelete(&log, 2), RR_OK);
+    assert_int_equal(LogSegmentCount(&log), 1);
+    append_entry(&log, 4, NULL);
+
+    e2 = LogGet(&log, 2);
+    assert_non_null(e2);
+    assert_int_equal(e2->id, 4);
+    assert_ptr_equal(e2->data, (char *) (e2 + 1));
+    raft_entry_release(e2);
+
+    /* Once sealed again, the grown segment is remapped */
+    assert_int_equal(LogAddSegment(&log), RR_OK);
+    e1 = LogGet(&log, 1);
+    e2 = LogGet(&log, 2);
+    assert_non_null(e1);
+    assert_non_null(e2);
+    assert_int_equal(e2->id, 4);
+
+    /* Entries hold the mapping after the log is closed */
+    LogTerm(&log);
+    assert_memory_equal(e1->data, "value1", 6);
+    assert_memory_equal(e2->data, "value4", 6);
+    raft_entry_release(e1);
+    raft_entry_release(e2);
+}
+
 static void test_log_write_after_read(void **state)
 {
     Log *log = (Log *) *state;
@@ -461,6 +660,75 @@ static void test_entry_cache_delete_tail(void **state)
     EntryCacheFree(cache);
 }
 
+static void test_entry_cache_compact_pinned(void **state)
+{
+    EntryCache *cache = EntryCacheNew(4);
+    const size_t entry_size = sizeof(raft_entry_t) + 100;
+    raft_entry_t *ety;
+    int i;
+
+    for (i = 1; i <= 10; i++) {
+        ety = raft_entry_new(100);
+        ety->id = i;
+        EntryCacheAppend(cache, ety, i);
+        raft_entry_release(ety);
+    }
+    assert_int_equal(cache->entries_memsize, 10 * entry_size);
+
+    /* Entries before pin index are evicted down to max_memory */
+    assert_int_equal(EntryCacheCompact(cache, 2 * entry_size, 5, 8 * entry_size), 4);
+    assert_int_equal(cache->start_idx, 5);
+    assert_int_equal(cache->len, 6);
+    assert_int_equal(cache->pinned_evictions, 0);
+
+    /* Pinned entries are evicted only beyond max_pinned_memory */
+    assert_int_equal(EntryCacheCompact(cache, 2 * entry_size, 5, 4 * entry_size), 2);
+    assert_int_equal(cache->start_idx, 7);
+    assert_int_equal(cache->pinned_evictions, 2);
+
+    /* No pin index, evict down to max_memory */
+    assert_int_equal(EntryCacheCompact(cache, 2 * entry_size, 0, 4 * entry_size), 2);
+    assert_int_equal(cache->start_idx, 9);
+    assert_int_equal(cache->pinned_evictions, 2);
+
+    /* Hits and misses */
+    assert_null(EntryCacheGet(cache, 8));
+    ety = EntryCacheGet(cache, 9);
+    assert_non_null(ety);
+    raft_entry_release(ety);
+    assert_int_equal(cache->hits, 1);
+    assert_int_equal(cache->misses, 1);
+
+    EntryCacheFree(cache);
+}
+
+static void test_entry_cache_shared_memsize(void **state)
+{
+    EntryCache *cache = EntryCacheNew(4);
+    raft_entry_t *ety;
+    int i;
+
+    /* Three entries sharing a 1000 byte buffer, charged to the last one */
+    for (i = 1; i <= 3; i++) {
+        ety = raft_entry_new(100);
+        ety->id = i;
+        ety->data_shared = 1;
+        ety->shared_size = i == 3 ? 1000 : 0;
+        EntryCacheAppend(cache, ety, i);
+        raft_entry_release(ety);
+    }
+    assert_int_equal(cache->entries_memsize, 3 * sizeof(raft_entry_t) + 1000);
+
+    /* Buffer stays charged until its last entry is evicted */
+    assert_int_equal(EntryCacheDeleteHead(cache, 3), 2);
+    assert_int_equal(cache->entries_memsize, sizeof(raft_entry_t) + 1000);
+
+    assert_int_equal(EntryCacheCompact(cache, 0, 0, 0), 1);
+    assert_int_equal(cache->entries_memsize, 0);
+
+    EntryCacheFree(cache);
+}
+
 static void test_entry_cache_fuzzer(void **state)
 {
     EntryCache *cache = EntryCacheNew(4);
@@ -621,7 +889,7 @@ static void test_corruption_entry(void **state)
 
     LogInit(&log);
     LogOpen(&log, LOGNAME);
-    LogLoadEntries(&log);
+    LogLoadEntries(&log, NULL);
     append_entry(&log, 6000, "test6000");
     LogTerm(&log);
 
@@ -649,7 +917,7 @@ static void test_corruption_entry(void **state)
 
         LogInit(&log);
         LogOpen(&log, LOGNAME);
-        LogLoadEntries(&log);
+        LogLoadEntries(&log, NULL);
 
         assert_int_equal(LogCount(&log), 1);
         /* Verify entry with id 7000 does not exist. */
@@ -700,7 +968,7 @@ static void test_log_compaction(void **state)
 
     LogInit(&log);
     LogOpen(&log, LOGNAME);
-    LogLoadEntries(&log);
+    LogLoadEntries(&log, NULL);
 
     raft_entry_t *e;
 
@@ -757,19 +1025,19 @@ static void test_log_delete_second_page(void **state)
 
     /* Delete from index 4 and verify second page is not deleted. */
     LogDelete(&log, 4);
-    assert_non_null(log.pages[1]);
+    assert_int_equal(LogSegmentCount(&log), 2);
 
     append_entry(&log, ++idx, NULL);
     append_entry(&log, ++idx, NULL);
 
     /* Delete from index 3 and verify second page is deleted. */
     LogDelete(&log, 3);
-    assert_null(log.pages[1]);
+    assert_int_equal(LogSegmentCount(&log), 1);
     LogTerm(&log);
 
     LogInit(&log);
     LogOpen(&log, LOGNAME);
-    LogLoadEntries(&log);
+    LogLoadEntries(&log, NULL);
 
     e = LogGet(&log, 3);
     assert_null(e);
@@ -808,7 +1076,7 @@ static void test_log_start_with_two_pages(void **state)
     /* Try to read files. */
     LogInit(&log);
     LogOpen(&log, LOGNAME);
-    LogLoadEntries(&log);
+    LogLoadEntries(&log, NULL);
 
     raft_entry_t *e;
 
@@ -827,6 +1095,285 @@ static void test_log_start_with_two_pages(void **state)
     LogTerm(&log);
 }
 
+static void verify_entries(Log *log, raft_index_t from, raft_index_t to)
+{
+    for (raft_index_t i = from; i <= to; i++) {
+        raft_entry_t *e = LogGet(log, i);
+        assert_non_null(e);
+        assert_int_equal(e->id, i);
+        raft_entry_release(e);
+    }
+}
+
+/* Verify entries are read from and deleted across multiple segments, and
+ * compaction deletes whole segments. */
+static void test_log_segments(void **state)
+{
+    (void) state;
+    int idx = 0;
+    Log log;
+
+    unlink_segments();
+
+    LogInit(&log);
+    LogCreate(&log, LOGNAME, DBID, 1, 1, 0);
+
+    /* Empty segment is not sealed */
+    assert_int_equal(LogAddSegment(&log), RR_OK);
+    assert_int_equal(LogSegmentCount(&log), 1);
+
+    for (int i = 0; i < 3; i++) {
+        append_entry(&log, ++idx, NULL);
+        append_entry(&log, ++idx, NULL);
+        append_entry(&log, ++idx, NULL);
+        assert_int_equal(LogAddSegment(&log), RR_OK);
+    }
+
+    /* Sealed segments are fsync'd along with the current one */
+    assert_int_equal(log.num_sealed_fds, 3);
+    assert_int_equal(LogSync(&log, true), RR_OK);
+    assert_int_equal(LogTakeSealedFd(&log), -1);
+
+    /* Segments: [1-3], [4-6], [7-9], [] */
+    assert_int_equal(LogSegmentCount(&log), 4);
+    assert_int_equal(LogCount(&log), 9);
+    verify_entries(&log, 1, 9);
+
+    /* Truncation deletes the following segments */
+    assert_int_equal(LogDelete(&log, 5), RR_OK);
+    assert_int_equal(LogSegmentCount(&log), 2);
+    assert_int_equal(LogCurrentIdx(&log), 4);
+    assert_null(LogGet(&log, 5));
+
+    append_entry(&log, 5, NULL);
+    append_entry(&log, 6, NULL);
+    LogTerm(&log);
+
+    /* Segments are loaded from the manifest */
+    LogInit(&log);
+    assert_int_equal(LogOpen(&log, LOGNAME), RR_OK);
+    assert_int_equal(LogLoadEntries(&log, NULL), RR_OK);
+    assert_int_equal(LogSegmentCount(&log), 2);
+    assert_int_equal(LogCount(&log), 6);
+    verify_entries(&log, 1, 6);
+
+    /* Compaction starts a new segment and deletes the previous ones */
+    assert_int_equal(LogCompactionBegin(&log), RR_OK);
+    assert_int_equal(LogCompactionIdx(&log), 6);
+    assert_int_equal(LogSegmentCount(&log), 3);
+
+    append_entry(&log, 7, NULL);
+    LogCompactionEnd(&log);
+
+    assert_false(LogCompactionStarted(&log));
+    assert_int_equal(LogSegmentCount(&log), 1);
+    assert_int_equal(LogFirstIdx(&log), 7);
+    assert_int_equal(access(LOGNAME, F_OK), -1);
+    verify_entries(&log, 7, 7);
+    LogTerm(&log);
+
+    LogInit(&log);
+    assert_int_equal(LogOpen(&log, LOGNAME), RR_OK);
+    assert_int_equal(LogLoadEntries(&log, NULL), RR_OK);
+    assert_int_equal(LogFirstIdx(&log), 7);
+    assert_int_equal(LogCurrentIdx(&log), 7);
+    LogTerm(&log);
+
+    unlink_segments();
+}
+
+static void test_log_bytes_after(void **state)
+{
+    (void) state;
+    Log log;
+
+    unlink_segments();
+
+    LogInit(&log);
+    LogCreate(&log, LOGNAME, DBID, 1, 1, 0);
+
+    /* Segments: [1-3], [4-6] */
+    for (int i = 1; i <= 6; i++) {
+        append_entry(&log, i, NULL);
+        if (i == 3) {
+            assert_int_equal(LogAddSegment(&log), RR_OK);
+        }
+    }
+
+    size_t entry_size = LogBytesAfter(&log, 5);
+    assert_true(entry_size > 0);
+    assert_int_equal(LogBytesAfter(&log, 6), 0);
+    assert_int_equal(LogBytesAfter(&log, 4), 2 * entry_size);
+    assert_true(LogBytesAfter(&log, 3) >= 3 * entry_size);
+    assert_int_equal(LogBytesAfter(&log, 2), LogBytesAfter(&log, 3) + entry_size);
+    assert_int_equal(LogBytesAfter(&log, 0), LogFileSize(&log));
+
+    LogTerm(&log);
+    unlink_segments();
+}
+
+/* Verify a log without a manifest file, created by an older version, is
+ * loaded along with the second page of an unfinished compaction. */
+static void test_log_segments_no_manifest(void **state)
+{
+    (void) state;
+    int idx = 0;
+    Log log;
+
+    unlink_segments();
+
+    LogInit(&log);
+    LogCreate(&log, LOGNAME, DBID, 1, 1, 0);
+    append_entry(&log, ++idx, NULL);
+    append_entry(&log, ++idx, NULL);
+    LogCompactionBegin(&log);
+    append_entry(&log, ++idx, NULL);
+    LogTerm(&log);
+
+    unlink(LOGNAME ".manifest");
+
+    LogInit(&log);
+    assert_int_equal(LogOpen(&log, LOGNAME), RR_OK);
+    assert_int_equal(LogLoadEntries(&log, NULL), RR_OK);
+    assert_int_equal(LogSegmentCount(&log), 2);
+    assert_true(LogCompactionStarted(&log));
+    assert_int_equal(LogCompactionIdx(&log), 2);
+    verify_entries(&log, 1, 3);
+
+    /* New segments do not overwrite the second page */
+    assert_int_equal(LogAddSegment(&log), RR_OK);
+    append_entry(&log, ++idx, NULL);
+    assert_int_equal(access(LOGNAME ".2", F_OK), 0);
+    verify_entries(&log, 1, 4);
+    LogTerm(&log);
+
+    unlink_segments();
+}
+
+static void test_log_fsync_stats(void **state)
+{
+    Log *log = (Log *) *state;
+
+    for (int i = 1; i <= 10; i++) {
+        append_entry(log, i, NULL);
+    }
+    assert_true(log->bytes_written > 0);
+
+    LogFsyncCompleted(log, 1, 100);
+    LogFsyncCompleted(log, 4, 300);
+    LogFsyncCompleted(log, 4, 50);
+    LogSync(log, true);
+
+    assert_int_equal(log->fsync_index, 10);
+    assert_int_equal(log->fsync_count, 4);
+    assert_int_equal(log->fsync_entries, 10);
+    assert_int_equal(log->fsync_batch_max, 6);
+    assert_int_equal(log->fsync_max, 300);
+
+    assert_int_equal(log->fsync_batch_hist[0], 2); /* 1 and 0 entries */
+    assert_int_equal(log->fsync_batch_hist[2], 1); /* 3 entries */
+    assert_int_equal(log->fsync_batch_hist[3], 1); /* 6 entries */
+}
+
+/* Write a version 1 (RESP) log page with the specified entries. */
+static void write_legacy_log(const char *filename, int n_entries)
+{
+    char buf[1024];
+    char *pos = buf;
+    char *end = buf + sizeof(buf);
+
+    pos += multibulkWriteLen(pos, end - pos, '*', 7);
+    pos += multibulkWriteStr(pos, end - pos, "RAFTLOG");
+    pos += multibulkWriteLong(pos, end - pos, 1);
+    pos += multibulkWriteStr(pos, end - pos, DBID);
+    pos += multibulkWriteLong(pos, end - pos, 1);
+    pos += multibulkWriteLong(pos, end - pos, 1);
+    pos += multibulkWriteLong(pos, end - pos, 0);
+
+    long crc = sc_crc32(0, (uint8_t *) buf, pos - buf);
+    pos += multibulkWriteLong(pos, end - pos, crc);
+
+    FILE *fp = fopen(filename, "w");
+    assert_non_null(fp);
+    assert_int_equal(fwrite(buf, 1, pos - buf, fp), pos - buf);
+
+    for (int i = 1; i <= n_entries; i++) {
+        char data[32];
+        int len = snprintf(data, sizeof(data), "legacy%d", i);
+
+        pos = buf;
+        pos += multibulkWriteLen(pos, end - pos, '*', 7);
+        pos += multibulkWriteStr(pos, end - pos, "ENTRY");
+        pos += multibulkWriteLong(pos, end - pos, 1);
+        pos += multibulkWriteLong(pos, end - pos, i);
+        pos += multibulkWriteUInt64(pos, end - pos, 0);
+        pos += multibulkWriteInt(pos, end - pos, RAFT_LOGTYPE_NORMAL);
+        pos += multibulkWriteLen(pos, end - pos, '$', len);
+        pos += sprintf(pos, "%s\r\n", data);
+
+        crc = sc_crc32(crc, (uint8_t *) buf, pos - buf);
+        pos += multibulkWriteLong(pos, end - pos, crc);
+        assert_int_equal(fwrite(buf, 1, pos - buf, fp), pos - buf);
+    }
+
+    fclose(fp);
+}
+
+/* Verify version 1 log pages are still loaded and appended to. */
+static void test_log_legacy_format(void **state)
+{
+    raft_entry_t *e;
+    Log log;
+
+    unlink(LOGNAME ".1");
+    unlink(LOGNAME ".manifest");
+    write_legacy_log(LOGNAME, 3);
+
+    LogInit(&log);
+    assert_int_equal(LogOpen(&log, LOGNAME), RR_OK);
+    assert_int_equal(LogLoadEntries(&log, NULL), RR_OK);
+    assert_int_equal(LogCount(&log), 3);
+
+    e = LogGet(&log, 2);
+    assert_non_null(e);
+    assert_int_equal(e->id, 2);
+    assert_memory_equal(e->data, "legacy2", 7);
+    raft_entry_release(e);
+
+    append_entry(&log, 4, NULL);
+    LogTerm(&log);
+
+    /* Reopen, appended entry must pass crc validation */
+    LogInit(&log);
+    assert_int_equal(LogOpen(&log, LOGNAME), RR_OK);
+    assert_int_equal(LogLoadEntries(&log, NULL), RR_OK);
+    assert_int_equal(LogCount(&log), 4);
+
+    e = LogGet(&log, 4);
+    assert_non_null(e);
+    assert_int_equal(e->id, 4);
+    raft_entry_release(e);
+
+    /* Entry 3 must be readable after deleting entry 4 */
+    assert_int_equal(LogDelete(&log, 4), RR_OK);
+    append_entry(&log, 5, NULL);
+    LogTerm(&log);
+
+    LogInit(&log);
+    assert_int_equal(LogOpen(&log, LOGNAME), RR_OK);
+    assert_int_equal(LogLoadEntries(&log, NULL), RR_OK);
+    assert_int_equal(LogCount(&log), 4);
+
+    e = LogGet(&log, 4);
+    assert_non_null(e);
+    assert_int_equal(e->id, 5);
+    raft_entry_release(e);
+    LogTerm(&log);
+
+    unlink(LOGNAME);
+    unlink(LOGNAME ".idx");
+}
+
 const struct CMUnitTest log_tests[] = {
     cmocka_unit_test_setup_teardown(
         test_log_load_entries, setup_create_log, teardown_log),
@@ -838,10 +1385,16 @@ const struct CMUnitTest log_tests[] = {
         test_log_write_after_read, setup_create_log, teardown_log),
     cmocka_unit_test_setup_teardown(
         test_log_index_rebuild, setup_create_log, teardown_log),
+    cmocka_unit_test_setup_teardown(
+        test_log_index_reuse, setup_create_log, teardown_log),
+    cmocka_unit_test_setup_teardown(
+        test_log_index_stale, setup_create_log, teardown_log),
     cmocka_unit_test_setup_teardown(
         test_log_delete, setup_create_log, teardown_log),
     cmocka_unit_test_setup_teardown(
         test_log_fuzzer, setup_create_log, teardown_log),
+    cmocka_unit_test_setup_teardown(
+        test_log_fsync_stats, setup_create_log, teardown_log),
     cmocka_unit_test_setup_teardown(
         test_entry_cache_sanity, NULL, NULL),
     cmocka_unit_test_setup_teardown(
@@ -850,6 +1403,10 @@ const struct CMUnitTest log_tests[] = {
         test_entry_cache_delete_head, NULL, NULL),
     cmocka_unit_test_setup_teardown(
         test_entry_cache_delete_tail, NULL, NULL),
+    cmocka_unit_test_setup_teardown(
+        test_entry_cache_compact_pinned, NULL, NULL),
+    cmocka_unit_test_setup_teardown(
+        test_entry_cache_shared_memsize, NULL, NULL),
     cmocka_unit_test_setup_teardown(
         test_entry_cache_fuzzer, NULL, NULL),
     cmocka_unit_test_setup_teardown(
@@ -857,14 +1414,24 @@ const struct CMUnitTest log_tests[] = {
     cmocka_unit_test_setup_teardown(
         test_crc32c, NULL, NULL),
     cmocka_unit_test_setup_teardown(
-        test_corruption_header, NULL, NULL),
+        test_corruption_header, cleanup_log, cleanup_log),
+    cmocka_unit_test_setup_teardown(
+        test_corruption_entry, cleanup_log, cleanup_log),
+    cmocka_unit_test_setup_teardown(
+        test_log_compaction, cleanup_log, cleanup_log),
+    cmocka_unit_test_setup_teardown(
+        test_log_delete_second_page, cleanup_log, cleanup_log),
+    cmocka_unit_test_setup_teardown(
+        test_log_start_with_two_pages, cleanup_log, cleanup_log),
+    cmocka_unit_test_setup_teardown(
+        test_log_segments, cleanup_log, cleanup_log),
     cmocka_unit_test_setup_teardown(
-        test_corruption_entry, NULL, NULL),
+        test_log_bytes_after, cleanup_log, cleanup_log),
     cmocka_unit_test_setup_teardown(
-        test_log_compaction, NULL, NULL),
+        test_log_segments_no_manifest, cleanup_log, cleanup_log),
     cmocka_unit_test_setup_teardown(
-        test_log_delete_second_page, NULL, NULL),
+        test_log_legacy_format, cleanup_log, cleanup_log),
     cmocka_unit_test_setup_teardown(
-        test_log_start_with_two_pages, NULL, NULL),
+        test_log_mapped_entries, cleanup_log, cleanup_log),
     {.test_func = NULL},
 };
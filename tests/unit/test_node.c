@@ -0,0 +1,63 @@
+/*
+ * Copyright Redis Ltd. 2020 - present
+ * Licensed under your choice of the Redis Source Available License 2.0 (RSALv2) or
+ * the Server Side Public License v1 (SSPLv1).
+ */
+
+#include "../src/redisraft.h"
+
+#include <stddef.h>
+
+#include "cmocka.h"
+
+static void test_pending_responses_wrap_around(void **state)
+{
+    Node node = {0};
+    int pushed = 0, popped = 0;
+
+    node.pending.capacity = NODE_PENDING_RESPONSES_INITIAL;
+    node.pending.buf = RedisModule_Alloc(node.pending.capacity * sizeof(PendingResponse));
+
+    /* Move the head forward, so pushes wrap around the end of the buffer */
+    for (; pushed < 10; pushed++) {
+        mock_monotonic_time = 1000 + pushed;
+        NodeAddPendingResponse(&node, false, 100 + pushed);
+    }
+    for (; popped < 6; popped++) {
+        assert_int_equal(NodeDismissPendingResponse(&node), 1000 + popped);
+    }
+    assert_int_equal(node.pending.head, 6);
+
+    /* Fill the buffer, then grow it while it is wrapped around */
+    for (; pushed < 6 + NODE_PENDING_RESPONSES_INITIAL; pushed++) {
+        mock_monotonic_time = 1000 + pushed;
+        NodeAddPendingResponse(&node, false, 100 + pushed);
+    }
+    assert_int_equal(node.pending.count, node.pending.capacity);
+    assert_int_equal(node.pending.capacity, NODE_PENDING_RESPONSES_INITIAL);
+
+    mock_monotonic_time = 1000 + pushed;
+    NodeAddPendingResponse(&node, false, 100 + pushed);
+    pushed++;
+    assert_int_equal(node.pending.capacity, 2 * NODE_PENDING_RESPONSES_INITIAL);
+    assert_int_equal(node.pending.head, 0);
+    assert_int_equal(node.pending_raft_response_num, pushed - popped);
+
+    /* Responses are dismissed in request order, with their own data */
+    for (; popped < pushed; popped++) {
+        PendingResponse *resp = &node.pending.buf[node.pending.head];
+        assert_int_equal(resp->bytes, 100 + popped);
+        assert_int_equal(NodeDismissPendingResponse(&node), 1000 + popped);
+    }
+    assert_int_equal(node.pending.count, 0);
+    assert_int_equal(node.pending_raft_response_num, 0);
+    assert_int_equal(node.pending_raft_bytes, 0);
+
+    mock_monotonic_time = 0;
+    RedisModule_Free(node.pending.buf);
+}
+
+const struct CMUnitTest node_tests[] = {
+    cmocka_unit_test(test_pending_responses_wrap_around),
+    {.test_func = NULL},
+};
@@ -47,6 +47,48 @@ static void test_serialize_redis_command(void **state)
     RaftRedisCommandArrayFree(&cmd_array);
 }
 
+static void test_serialize_redis_command_batch(void **state)
+{
+    const char *cmd1_argv[] = {"SET", "key", "value"};
+    const char *cmd2_argv[] = {"INCR", "x"};
+
+    RaftRedisCommandArray cmd_array1 = {.client_id = 7};
+    RaftRedisCommandArray cmd_array2 = {.client_id = 12};
+    setupRedisCommand(RaftRedisCommandArrayExtend(&cmd_array1), cmd1_argv, 3);
+    setupRedisCommand(RaftRedisCommandArrayExtend(&cmd_array2), cmd2_argv, 2);
+
+    RaftRedisCommandArray *arrays[] = {&cmd_array1, &cmd_array2};
+    const char *expected = "*2\n"
+                           "*7\n$39\n*0\n*0\n$0\n\n*1\n*3\n$3\nSET\n$3\nkey\n$5\nvalue\n\n"
+                           "*12\n$29\n*0\n*0\n$0\n\n*1\n*2\n$4\nINCR\n$1\nx\n\n";
+
+    raft_entry_t *e = RaftRedisCommandBatchSerialize(arrays, 2);
+    assert_non_null(e);
+    assert_int_equal(e->data_len, strlen(expected));
+    assert_memory_equal(e->data, expected, strlen(expected));
+
+    size_t count;
+    RaftRedisCommandBatchItem *items = RaftRedisCommandBatchDeserialize(e->data, e->data_len, &count);
+    assert_non_null(items);
+    assert_int_equal(count, 2);
+    assert_int_equal(items[0].session, 7);
+    assert_int_equal(items[1].session, 12);
+
+    RaftRedisCommandArray target = {0};
+    assert_int_equal(RaftRedisCommandArrayDeserialize(&target, items[1].data, items[1].data_len), RR_OK);
+    assert_int_equal(target.len, 1);
+    assert_int_equal(target.commands[0]->argc, 2);
+    RaftRedisCommandArrayFree(&target);
+    RedisModule_Free(items);
+
+    /* truncated */
+    assert_null(RaftRedisCommandBatchDeserialize(e->data, e->data_len - 10, &count));
+    raft_entry_release(e);
+
+    RaftRedisCommandArrayFree(&cmd_array1);
+    RaftRedisCommandArrayFree(&cmd_array2);
+}
+
 static void test_deserialize_redis_command(void **state)
 {
     const char *serialized = "*3\n$3\nSET\n$3\nkey\n$5\nvalue\n";
@@ -87,6 +129,118 @@ static void test_deserialize_redis_command_array_with_acl(void **state)
     RaftRedisCommandArrayFree(&cmd_array);
 }
 
+static void test_deserialize_redis_command_array_arena(void **state)
+{
+    const char *serialized = "*0\n*0\n$0\n\n*3\n*3\n$3\nSET\n$3\nkey\n$5\nvalue\n*2\n$3\nGET\n$5\nmykey\n*1\n$4\nPING\n";
+    int serialized_len = strlen(serialized);
+    Arena arena = {0};
+
+    for (int i = 0; i < 3; i++) {
+        RaftRedisCommandArray cmd_array = {0};
+        assert_int_equal(RaftRedisCommandArrayDeserializeArena(&cmd_array, serialized, serialized_len, &arena), RR_OK);
+        assert_int_equal(cmd_array.len, 3);
+        assert_true(cmd_array.arena);
+        assert_int_equal(cmd_array.commands[0]->argc, 3);
+        size_t len;
+        assert_string_equal(RedisModule_StringPtrLen(cmd_array.commands[0]->argv[2], &len), "value");
+        assert_string_equal(RedisModule_StringPtrLen(cmd_array.commands[2]->argv[0], &len), "PING");
+
+        RaftRedisCommandArrayFree(&cmd_array);
+        ArenaReset(&arena);
+    }
+
+    /* Allocations are served from the buffer after the first reset */
+    assert_non_null(arena.buf);
+    assert_null(arena.chunks);
+
+    ArenaFree(&arena);
+}
+
+static void test_compress_data(void **state)
+{
+    size_t len = 100000;
+    char *in = test_malloc(len);
+    char *out = test_malloc(len);
+    char *dec = test_malloc(len);
+
+    /* Repetitive JSON-like data compresses well */
+    for (size_t i = 0; i < len; i++) {
+        in[i] = "{\"field\":\"value\",\"id\":"[i % 24] + (char) (i % 1000 == 0);
+    }
+    size_t clen = CompressData(in, len, out, len);
+    assert_true(clen > 0 && clen < len / 4);
+    assert_int_equal(DecompressData(out, clen, dec, len), len);
+    assert_memory_equal(in, dec, len);
+
+    /* Random data does not fit into a smaller buffer */
+    srand(1);
+    for (size_t i = 0; i < len; i++) {
+        in[i] = (char) rand();
+    }
+    assert_int_equal(CompressData(in, len, out, len - len / 8), 0);
+    test_free(out);
+    out = test_malloc(len + len / 16);
+    clen = CompressData(in, len, out, len + len / 16);
+    assert_true(clen > 0);
+    assert_int_equal(DecompressData(out, clen, dec, len), len);
+    assert_memory_equal(in, dec, len);
+
+    /* Corrupt input is rejected */
+    assert_int_equal(DecompressData("\x20\x00", 2, dec, len), 0);
+    assert_int_equal(DecompressData("\x05" "ab", 3, dec, len), 0);
+
+    test_free(in);
+    test_free(out);
+    test_free(dec);
+}
+
+static void test_compress_entry(void **state)
+{
+    char value[2048];
+    const char *cmd_argv[] = {"SET", "key", value};
+
+    memset(value, 'x', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+
+    RaftRedisCommandArray cmd_array = {0};
+    setupRedisCommand(RaftRedisCommandArrayExtend(&cmd_array), cmd_argv, 3);
+
+    /* Below threshold */
+    raft_entry_t *e = RaftRedisCommandArraySerialize(&cmd_array);
+    size_t len = e->data_len;
+    assert_ptr_equal(RaftRedisCompressEntry(e, len + 1), e);
+    assert_ptr_equal(RaftRedisCompressEntry(e, 0), e);
+
+    raft_entry_t *c = RaftRedisCompressEntry(e, 1024);
+    assert_ptr_not_equal(c, e);
+    assert_true(c->data_len < len / 8);
+    assert_int_equal(c->data[0], 'Z');
+
+    RaftRedisCommandArray target = {0};
+    assert_int_equal(RaftRedisCommandArrayDeserialize(&target, c->data, c->data_len), RR_OK);
+    assert_int_equal(target.len, 1);
+    assert_int_equal(target.commands[0]->argc, 3);
+    assert_string_equal(RedisModule_StringPtrLen(target.commands[0]->argv[2], &len), value);
+    RaftRedisCommandArrayFree(&target);
+
+    /* Truncated payload */
+    assert_int_equal(RaftRedisCommandArrayDeserialize(&target, c->data, c->data_len - 1), RR_ERROR);
+
+    /* Uncompressed length that the payload can't possibly expand into */
+    char bogus[] = "Z1000000000000\n\x01\x00x";
+    assert_int_equal(RaftRedisCommandArrayDeserialize(&target, bogus, sizeof(bogus) - 1), RR_ERROR);
+
+    /* Unknown or missing codec */
+    char *p = memchr(c->data, '\n', c->data_len) + 1;
+    assert_int_equal(*p, 1);
+    *p = 2;
+    assert_int_equal(RaftRedisCommandArrayDeserialize(&target, c->data, c->data_len), RR_ERROR);
+    assert_int_equal(RaftRedisCommandArrayDeserialize(&target, c->data, p - c->data), RR_ERROR);
+
+    raft_entry_release(c);
+    RaftRedisCommandArrayFree(&cmd_array);
+}
+
 static void test_deserialize_corrupted_data(void **state)
 {
     size_t ret;
@@ -249,13 +403,100 @@ static void test_deserialize_shardgroup(void **state)
     assert_ptr_equal(ShardGroupDeserialize(s5, strlen(s5)), NULL);
 }
 
+static void test_serialize_appendentries_binary(void **state)
+{
+    raft_entry_t *entries[2];
+
+    entries[0] = raft_entry_new(5);
+    entries[0]->term = 3;
+    entries[0]->id = 100;
+    entries[0]->session = 0x1122334455667788ULL;
+    entries[0]->type = RAFT_LOGTYPE_NORMAL;
+    memcpy(entries[0]->data, "hello", 5);
+
+    entries[1] = raft_entry_new(0);
+    entries[1]->term = 4;
+    entries[1]->id = -1;
+    entries[1]->type = RAFT_LOGTYPE_NO_OP;
+
+    raft_appendentries_req_t msg = {
+        .leader_id = 1,
+        .term = 4,
+        .prev_log_idx = 10,
+        .prev_log_term = 3,
+        .leader_commit = 9,
+        .msg_id = 77,
+        .n_entries = 2,
+        .entries = entries,
+    };
+
+    size_t len;
+    char *buf = AppendEntriesSerializeBinary(&msg, &len);
+    assert_non_null(buf);
+
+    raft_appendentries_req_t out;
+    assert_int_equal(AppendEntriesDeserializeBinary(&out, buf, len, NULL), RR_OK);
+    assert_int_equal(out.leader_id, 1);
+    assert_int_equal(out.term, 4);
+    assert_int_equal(out.prev_log_idx, 10);
+    assert_int_equal(out.prev_log_term, 3);
+    assert_int_equal(out.leader_commit, 9);
+    assert_int_equal(out.msg_id, 77);
+    assert_int_equal(out.n_entries, 2);
+
+    assert_int_equal(out.entries[0]->term, 3);
+    assert_int_equal(out.entries[0]->id, 100);
+    assert_int_equal(out.entries[0]->session, 0x1122334455667788ULL);
+    assert_int_equal(out.entries[0]->type, RAFT_LOGTYPE_NORMAL);
+    assert_int_equal(out.entries[0]->data_len, 5);
+    assert_memory_equal(out.entries[0]->data, "hello", 5);
+
+    assert_int_equal(out.entries[1]->term, 4);
+    assert_int_equal(out.entries[1]->id, -1);
+    assert_int_equal(out.entries[1]->type, RAFT_LOGTYPE_NO_OP);
+    assert_int_equal(out.entries[1]->data_len, 0);
+
+    /* Truncated and oversized messages */
+    raft_appendentries_req_t bad;
+    assert_int_equal(AppendEntriesDeserializeBinary(&bad, buf, len - 1, NULL), RR_ERROR);
+    assert_int_equal(AppendEntriesDeserializeBinary(&bad, buf, 10, NULL), RR_ERROR);
+
+    /* Formatted command embeds the same message as the last bulk string */
+    size_t cmd_len;
+    char *cmd = AppendEntriesFormatBinaryCommand(&msg, 2, 1, &cmd_len);
+    char hdr[64];
+    int hdr_len = snprintf(hdr, sizeof(hdr),
+                           "*4\r\n$10\r\nRAFT.AEBIN\r\n$1\r\n2\r\n$1\r\n1\r\n$%zu\r\n", len);
+    assert_int_equal(cmd_len, hdr_len + len + 2);
+    assert_memory_equal(cmd, hdr, hdr_len);
+    assert_memory_equal(cmd + hdr_len, buf, len);
+    assert_memory_equal(cmd + hdr_len + len, "\r\n", 2);
+    RedisModule_Free(cmd);
+
+    /* Unknown version */
+    buf[0] = 2;
+    assert_int_equal(AppendEntriesDeserializeBinary(&bad, buf, len, NULL), RR_ERROR);
+
+    for (int i = 0; i < 2; i++) {
+        raft_entry_release(out.entries[i]);
+        raft_entry_release(entries[i]);
+    }
+    RedisModule_Free(out.entries);
+    RedisModule_Free(buf);
+}
+
 const struct CMUnitTest serialization_tests[] = {
     cmocka_unit_test(test_serialize_redis_command),
+    cmocka_unit_test(test_serialize_redis_command_batch),
     cmocka_unit_test(test_deserialize_redis_command),
     cmocka_unit_test(test_deserialize_redis_command_array),
     cmocka_unit_test(test_deserialize_redis_command_array_with_acl),
+    cmocka_unit_test(test_deserialize_redis_command_array_arena),
+    cmocka_unit_test(test_compress_data),
+    cmocka_unit_test(test_compress_entry),
     cmocka_unit_test(test_deserialize_corrupted_data),
     cmocka_unit_test(test_serialize_shardgroup),
     cmocka_unit_test(test_deserialize_shardgroup),
+    cmocka_unit_test(test_serialize_appendentries_binary),
     {.test_func = NULL},
 };
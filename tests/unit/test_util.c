@@ -62,8 +62,66 @@ static void test_parse_slots(void **state)
     }
 }
 
+static void test_arena(void **state)
+{
+    Arena arena = {0};
+
+    /* Empty arena falls back to chunks */
+    char *p1 = ArenaAlloc(&arena, 10);
+    char *p2 = ArenaAlloc(&arena, 100);
+    assert_non_null(p1);
+    assert_non_null(p2);
+    assert_non_null(arena.chunks);
+    assert_int_equal((uintptr_t) p2 % 16, 0);
+    memset(p1, 'a', 10);
+    memset(p2, 'b', 100);
+
+    /* Buffer fits the peak usage after reset */
+    ArenaReset(&arena);
+    assert_null(arena.chunks);
+    assert_true(arena.size >= 128);
+
+    int *ints = ArenaCalloc(&arena, 16, sizeof(int));
+    for (int i = 0; i < 16; i++) {
+        assert_int_equal(ints[i], 0);
+    }
+    assert_ptr_equal(ints, arena.buf);
+    assert_null(arena.chunks);
+
+    ArenaFree(&arena);
+    assert_null(arena.buf);
+}
+
+static void test_latency_histogram(void **state)
+{
+    LatencyHistogram h = {0};
+
+    assert_int_equal(LatencyHistogramPercentile(&h, 50), 0);
+
+    /* Small values are recorded exactly */
+    for (uint64_t i = 1; i <= 5; i++) {
+        LatencyHistogramRecord(&h, i);
+    }
+    assert_int_equal(LatencyHistogramPercentile(&h, 50), 2);
+    assert_int_equal(LatencyHistogramPercentile(&h, 100), 5);
+
+    /* Large values are within 12.5% and never above the max */
+    for (uint64_t i = 0; i < 1000; i++) {
+        LatencyHistogramRecord(&h, 1000000);
+    }
+    LatencyHistogramRecord(&h, 5000000);
+
+    uint64_t p99 = LatencyHistogramPercentile(&h, 99);
+    assert_true(p99 >= 1000000 && p99 <= 1125000);
+    assert_int_equal(LatencyHistogramPercentile(&h, 100), 5000000);
+    assert_int_equal(h.count, 1006);
+    assert_int_equal(h.max, 5000000);
+}
+
 const struct CMUnitTest util_tests[] = {
     cmocka_unit_test(test_raftreq_str),
     cmocka_unit_test(test_parse_slots),
+    cmocka_unit_test(test_arena),
+    cmocka_unit_test(test_latency_histogram),
     {.test_func = NULL},
 };